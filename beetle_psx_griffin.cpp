@@ -24,6 +24,8 @@
 #include "mednafen/general.cpp"
 #include "mednafen/FileStream.cpp"
 #include "mednafen/MemoryStream.cpp"
+#include "mednafen/MmapStream.cpp"
+#include "mednafen/PreloadStream.cpp"
 #include "mednafen/Stream.cpp"
 #include "mednafen/state.cpp"
 
@@ -31,6 +33,7 @@
 #include "mednafen/cdrom/CDAccess.cpp"
 #include "mednafen/cdrom/CDAccess_Image.cpp"
 #include "mednafen/cdrom/CDAccess_CCD.cpp"
+#include "mednafen/cdrom/CDAccess_DCF.cpp"
 #include "mednafen/cdrom/CDAccess_PBP.cpp"
 #include "mednafen/cdrom/SimpleFIFO.cpp"
 #include "mednafen/cdrom/audioreader.cpp"
@@ -277,6 +277,9 @@ struct _cdfl_codec_data {
 	uint8_t*	buffer;
 };
 
+/* size of the pieces chd_precache_step() reads the file in */
+#define FILE_CACHE_CHUNK			(256 * 1024)
+
 /* internal representation of an open CHD file */
 struct _chd_file
 {
@@ -324,6 +327,9 @@ struct _chd_file
 	void *					async_buffer;	/* buffer pointer for asynchronous operations */
 
 	UINT8 *					file_cache; /* cache of underlying file */
+	UINT8 *					file_cache_valid; /* per FILE_CACHE_CHUNK, NULL if all of file_cache is */
+	UINT64					file_cache_size; /* size of underlying file */
+	UINT32					file_cache_left; /* chunks not cached yet */
 };
 
 
@@ -1500,27 +1506,101 @@ cleanup:
 
 chd_error chd_precache(chd_file *chd)
 {
-	ssize_t size, count;
+	chd_error err = chd_precache_begin(chd);
+	int done = 0;
+
+	while (err == CHDERR_NONE && !done)
+		err = chd_precache_step(chd, 0, &done);
+
+	if (err != CHDERR_NONE && chd->file_cache_valid != NULL)
+	{
+		free(chd->file_cache);
+		free(chd->file_cache_valid);
+		chd->file_cache = NULL;
+		chd->file_cache_valid = NULL;
+	}
+
+	return err;
+}
+
+/*-------------------------------------------------
+    chd_precache_begin - set up the cache for
+    chd_precache_step()
+-------------------------------------------------*/
 
+chd_error chd_precache_begin(chd_file *chd)
+{
+	ssize_t size;
+	UINT32 chunks;
+
+	if (chd->file_cache != NULL)
+		return CHDERR_NONE;
+
+	core_fseek(chd->file, 0, SEEK_END);
+	size = core_ftell(chd->file);
+	if (size <= 0)
+		return CHDERR_INVALID_DATA;
+
+	chunks = (UINT32)((size + FILE_CACHE_CHUNK - 1) / FILE_CACHE_CHUNK);
+	chd->file_cache_valid = (UINT8 *)calloc(chunks, 1);
+	if (chd->file_cache_valid == NULL)
+		return CHDERR_OUT_OF_MEMORY;
+	chd->file_cache = (UINT8 *)malloc(size);
 	if (chd->file_cache == NULL)
 	{
-		core_fseek(chd->file, 0, SEEK_END);
-		size = core_ftell(chd->file);
-		if (size <= 0)
-			return CHDERR_INVALID_DATA;
-		chd->file_cache = malloc(size);
-		if (chd->file_cache == NULL)
-			return CHDERR_OUT_OF_MEMORY;
-		core_fseek(chd->file, 0, SEEK_SET);
-		count = core_fread(chd->file, chd->file_cache, size);
-		if (count != size)
-		{
-			free(chd->file_cache);
-			chd->file_cache = NULL;
-			return CHDERR_READ_ERROR;
-		}
+		free(chd->file_cache_valid);
+		chd->file_cache_valid = NULL;
+		return CHDERR_OUT_OF_MEMORY;
 	}
 
+	chd->file_cache_size = size;
+	chd->file_cache_left = chunks;
+	return CHDERR_NONE;
+}
+
+/*-------------------------------------------------
+    chd_precache_step - read in the chunk not
+    cached yet nearest near_offset, the one after
+    it on a tie
+-------------------------------------------------*/
+
+chd_error chd_precache_step(chd_file *chd, UINT64 near_offset, int *done)
+{
+	UINT32 chunks, head, ahead, behind, chunk;
+	UINT64 offset;
+	size_t size;
+
+	*done = 1;
+	if (chd->file_cache == NULL || chd->file_cache_valid == NULL)
+		return CHDERR_NONE;
+
+	chunks = (UINT32)((chd->file_cache_size + FILE_CACHE_CHUNK - 1) / FILE_CACHE_CHUNK);
+	head = (near_offset < chd->file_cache_size) ? (UINT32)(near_offset / FILE_CACHE_CHUNK) : chunks - 1;
+
+	for (ahead = head; ahead < chunks && chd->file_cache_valid[ahead]; ahead++)
+		;
+	for (behind = head; behind > 0 && chd->file_cache_valid[behind - 1]; behind--)
+		;
+
+	if (ahead < chunks && (behind == 0 || ahead - head <= head - behind))
+		chunk = ahead;
+	else
+		chunk = behind - 1;
+
+	offset = (UINT64)chunk * FILE_CACHE_CHUNK;
+	size = (size_t)MIN(FILE_CACHE_CHUNK, chd->file_cache_size - offset);
+	core_fseek(chd->file, offset, SEEK_SET);
+	if (core_fread(chd->file, chd->file_cache + offset, size) != size)
+		return CHDERR_READ_ERROR;
+
+	chd->file_cache_valid[chunk] = 1;
+	if (--chd->file_cache_left == 0)
+	{
+		free(chd->file_cache_valid);
+		chd->file_cache_valid = NULL;
+	}
+
+	*done = (chd->file_cache_valid == NULL);
 	return CHDERR_NONE;
 }
 
@@ -1602,6 +1682,8 @@ void chd_close(chd_file *chd)
 
 	if (chd->file_cache)
 		free(chd->file_cache);
+	if (chd->file_cache_valid)
+		free(chd->file_cache_valid);
 
 	/* free our memory */
 	free(chd);
@@ -1619,6 +1701,62 @@ core_file *chd_core_file(chd_file *chd)
 }
 
 
+/*-------------------------------------------------
+    chd_hunk_offset - return the offset in the
+    underlying file of a hunk's data
+-------------------------------------------------*/
+
+UINT64 chd_hunk_offset(chd_file *chd, UINT32 hunknum)
+{
+	UINT64 filesize;
+
+	if (hunknum >= chd->header.totalhunks)
+		hunknum = chd->header.totalhunks - 1;
+
+	if (chd->header.version < 5)
+	{
+		map_entry *entry = &chd->map[hunknum];
+
+		switch (entry->flags & MAP_ENTRY_FLAG_TYPE_MASK)
+		{
+			case V34_MAP_ENTRY_TYPE_COMPRESSED:
+			case V34_MAP_ENTRY_TYPE_UNCOMPRESSED:
+				return entry->offset;
+
+			case V34_MAP_ENTRY_TYPE_SELF_HUNK:
+				if (entry->offset < hunknum)
+					return chd_hunk_offset(chd, (UINT32)entry->offset);
+				break;
+		}
+	}
+	else if (chd->header.rawmap != NULL && chd->header.mapentrybytes == 12)
+	{
+		UINT8 *rawmap = &chd->header.rawmap[chd->header.mapentrybytes * hunknum];
+		UINT64 blockoffs = get_bigendian_uint48(&rawmap[4]);
+
+		switch (rawmap[0])
+		{
+			case COMPRESSION_TYPE_0:
+			case COMPRESSION_TYPE_1:
+			case COMPRESSION_TYPE_2:
+			case COMPRESSION_TYPE_3:
+			case COMPRESSION_NONE:
+				return blockoffs;
+
+			case COMPRESSION_SELF:
+				if (blockoffs < hunknum)
+					return chd_hunk_offset(chd, (UINT32)blockoffs);
+				break;
+		}
+	}
+
+	/* hunks are stored in order, more or less */
+	core_fseek(chd->file, 0, SEEK_END);
+	filesize = core_ftell(chd->file);
+	return filesize / chd->header.totalhunks * hunknum;
+}
+
+
 /*-------------------------------------------------
     chd_error_string - return an error string for
     the given CHD error
@@ -2027,10 +2165,33 @@ static chd_error hunk_read_into_cache(chd_file *chd, UINT32 hunknum)
 }
 
 
+/*-------------------------------------------------
+    file_cache_has - return whether a range of
+    the underlying file has been cached
+-------------------------------------------------*/
+
+static int file_cache_has(chd_file *chd, UINT64 offset, size_t size)
+{
+	UINT64 chunk, last;
+
+	if (chd->file_cache == NULL)
+		return 0;
+	if (chd->file_cache_valid == NULL)
+		return 1;
+	if (size == 0 || offset + size > chd->file_cache_size)
+		return 0;
+
+	last = (offset + size - 1) / FILE_CACHE_CHUNK;
+	for (chunk = offset / FILE_CACHE_CHUNK; chunk <= last; chunk++)
+		if (!chd->file_cache_valid[chunk])
+			return 0;
+	return 1;
+}
+
 static UINT8* read_compressed(chd_file *chd, UINT64 offset, size_t size)
 {
 	ssize_t bytes;
-	if (chd->file_cache != NULL)
+	if (file_cache_has(chd, offset, size))
 	{
 		return chd->file_cache + offset;
 	}
@@ -2047,7 +2208,7 @@ static UINT8* read_compressed(chd_file *chd, UINT64 offset, size_t size)
 static chd_error read_uncompressed(chd_file *chd, UINT64 offset, size_t size, UINT8 *dest)
 {
 	ssize_t bytes;
-	if (chd->file_cache != NULL)
+	if (file_cache_has(chd, offset, size))
 	{
 		memcpy(dest, chd->file_cache + offset, size);
 	}
@@ -352,6 +352,17 @@ chd_error chd_open(const char *filename, int mode, chd_file *parent, chd_file **
 /* precache underlying file */
 chd_error chd_precache(chd_file *chd);
 
+/* precache underlying file a piece at a time: chd_precache_begin() sets up
+   the cache, then each chd_precache_step() reads in the piece not cached yet
+   nearest near_offset, until *done; reads of what isn't cached yet go to the
+   file meanwhile */
+chd_error chd_precache_begin(chd_file *chd);
+chd_error chd_precache_step(chd_file *chd, UINT64 near_offset, int *done);
+
+/* return the offset in the underlying file of a hunk's data, or a guess at
+   it if the hunk isn't stored on its own */
+UINT64 chd_hunk_offset(chd_file *chd, UINT32 hunknum);
+
 /* close a CHD file */
 void chd_close(chd_file *chd);
 
@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <algorithm>
 #include "mednafen/git.h"
+#include "mednafen/state.h"
 #include "mednafen/psx/frontio.h"
 #include "input.h"
 
@@ -216,6 +217,7 @@ static void analog_scale(uint32_t *v, float s)
 static void SetInput(int port, const char *type, void *ptr)
 {
    FIO->SetInput(port, type, ptr);
+   invalidate_serialize_size();
 }
 
 static uint16_t get_analog_button( retro_input_state_t input_state_cb,
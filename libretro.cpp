@@ -30,6 +30,8 @@
 
 //Fast Save States exclude string labels from variables in the savestate, and are at least 20% faster.
 extern bool FastSaveStates;
+extern bool IncrementalSaveStates;
+extern bool CompressedSaveStates;
 const int DEFAULT_STATE_SIZE = 16 * 1024 * 1024;
 
 static bool libretro_supports_bitmasks = false;
@@ -51,12 +53,16 @@ static unsigned image_crop = 0;
 static bool crop_overscan = false;
 static bool enable_memcard1 = false;
 static bool enable_variable_serialization_size = false;
+static size_t serialize_size = 0;  // Measured size of the state, 0 when it has to be measured again
+static bool incremental_savestates = false;
+static bool compressed_savestates = false;
 static int frame_width = 0;
 static int frame_height = 0;
 static bool gui_inited = false;
 static bool gui_show = false;
 
 unsigned cd_2x_speedup = 1;
+bool cd_fastload_adaptive = false;
 bool cd_async = false;
 bool cd_warned_slow = false;
 int64 cd_slow_timeout = 8000; // microseconds
@@ -74,6 +80,7 @@ unsigned psx_gpu_overclock_shift = 0;
 static int psx_skipbios;
 
 bool psx_gte_overclock;
+enum cpu_idle_skip_mode psx_cpu_idle_skip;
 static bool is_pal;
 enum dither_mode psx_gpu_dither_mode;
 
@@ -350,6 +357,10 @@ static MultiAccessSizeMem<512 * 1024, uint32, false> *BIOSROM = NULL;
 static MultiAccessSizeMem<65536, uint32, false> *PIOMem = NULL;
 
 MultiAccessSizeMem<2048 * 1024, uint32, false> MainRAM;
+StateDirty MainRAM_Dirty;
+/* Set once the frontend has been handed a pointer to main RAM; its writes
+ * through that don't reach MainRAM_Dirty, so every page counts as changed */
+static bool MainRAM_Exposed = false;
 
 static uint32_t TextMem_Start;
 static std::vector<uint8> TextMem;
@@ -595,6 +606,9 @@ template<typename T, bool IsWrite, bool Access24> static INLINE void MemRW(int32
             timestamp += 3;
       }
 
+      if(IsWrite)
+         StateDirty_Mark(&MainRAM_Dirty, A & 0x1FFFFF);
+
       if(Access24)
       {
          if(IsWrite)
@@ -1099,6 +1113,7 @@ static void PSX_Power(void)
    cd_warned_slow = false;
 
    memset(MainRAM.data32, 0, 2048 * 1024);
+   StateDirty_MarkAll(&MainRAM_Dirty);
 
    for(i = 0; i < 9; i++)
       SysControl.Regs[i] = 0;
@@ -1127,6 +1142,8 @@ template<typename T, bool Access24> static INLINE void MemPoke(pscpu_timestamp_t
 {
    if(A < 0x00800000)
    {
+      StateDirty_Mark(&MainRAM_Dirty, A & 0x1FFFFF);
+
       if(Access24)
          MainRAM.WriteU24(A & 0x1FFFFF, V);
       else
@@ -1622,6 +1639,7 @@ static void InitCommon(std::vector<CDIF *> *_CDInterfaces, const bool EmulateMem
 
    MDFNMP_Init(1024, ((uint64)1 << 29) / 1024);
    MDFNMP_AddRAM(2048 * 1024, 0x00000000, MainRAM.data8);
+   StateDirty_Init(&MainRAM_Dirty, 2048 * 1024);
 #if 0
    MDFNMP_AddRAM(1024, 0x1F800000, ScratchRAM.data8);
 #endif
@@ -2019,7 +2037,7 @@ int StateAction(StateMem *sm, int load, int data_only)
    {
       SFVAR(CD_TrayOpen),
       SFVAR(CD_SelectedDisc),
-      SFARRAY(MainRAM.data8, 1024 * 2048),
+      SFARRAYDIRTYN(MainRAM.data8, 1024 * 2048, "MainRAM.data8", &MainRAM_Dirty),
       SFARRAY32(SysControl.Regs, 9),
       SFVAR(PSX_PRNG.lcgo),
       SFVAR(PSX_PRNG.x),
@@ -2663,12 +2681,21 @@ static bool shared_memorycards_toggle = false;
 
 static bool has_new_geometry = false;
 
+// Has retro_serialize_size() measure the state again, for when something that changes its layout, like a plugged in
+// device, has changed.
+void invalidate_serialize_size(void)
+{
+   serialize_size = 0;
+}
+
 static void check_variables(bool startup)
 {
    struct retro_variable var = {0};
 
    extern void PSXDitherApply(bool);
 
+   invalidate_serialize_size();
+
 #ifndef EMSCRIPTEN
    var.key = BEETLE_OPT(cd_access_method);
 
@@ -2722,6 +2749,20 @@ static void check_variables(bool startup)
    else
       psx_gte_overclock = false;
 
+   var.key = BEETLE_OPT(cpu_idle_skip);
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+   {
+      if (strcmp(var.value, "disabled") == 0)
+         psx_cpu_idle_skip = CPU_IDLE_SKIP_DISABLED;
+      else if (strcmp(var.value, "accurate") == 0)
+         psx_cpu_idle_skip = CPU_IDLE_SKIP_ACCURATE;
+      else if (strcmp(var.value, "fast") == 0)
+         psx_cpu_idle_skip = CPU_IDLE_SKIP_FAST;
+   }
+   else
+      psx_cpu_idle_skip = CPU_IDLE_SKIP_DISABLED;
+
    var.key = BEETLE_OPT(gpu_overclock);
 
    if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
@@ -2871,6 +2912,20 @@ static void check_variables(bool startup)
    else
       psx_gpu_dither_mode = DITHER_NATIVE;
 
+#if HAVE_THREADS
+   var.key = BEETLE_OPT(renderer_software_threads);
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+   {
+      if (strcmp(var.value, "disabled") == 0)
+         GPU_SetRasterThreads(0);
+      else
+         GPU_SetRasterThreads(atoi(var.value));
+   }
+   else
+      GPU_SetRasterThreads(0);
+#endif
+
    // iCB: PGXP settings
    var.key = BEETLE_OPT(pgxp_mode);
 
@@ -3201,22 +3256,59 @@ static void check_variables(bool startup)
 
    var.key = BEETLE_OPT(cd_fastload);
 
+   cd_fastload_adaptive = false;
+
    if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
       {
-         uint8_t val = var.value[0] - '0';
-
-         if (var.value[1] != 'x')
+         if (strcmp(var.value, "adaptive") == 0)
             {
-               val  = (var.value[0] - '0') * 10;
-               val += var.value[1] - '0';
+               // Fastest data reads and seeks, but native speed while
+               // streaming audio or playing movies, see
+               // PS_CDC::ReadSpeedMul()
+               cd_fastload_adaptive = true;
+               cd_2x_speedup = 7;
             }
+         else
+            {
+               uint8_t val = var.value[0] - '0';
 
-         // Value is a multiplier from the native 2x, so we divide by
-         // two
-         cd_2x_speedup = val / 2;
+               if (var.value[1] != 'x')
+                  {
+                     val  = (var.value[0] - '0') * 10;
+                     val += var.value[1] - '0';
+                  }
+
+               // Value is a multiplier from the native 2x, so we divide by
+               // two
+               cd_2x_speedup = val / 2;
+            }
       }
    else
       cd_2x_speedup = 1;
+
+   var.key = BEETLE_OPT(incremental_savestates);
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+   {
+      if (strcmp(var.value, "enabled") == 0)
+         incremental_savestates = true;
+      else if (strcmp(var.value, "disabled") == 0)
+         incremental_savestates = false;
+   }
+   else
+      incremental_savestates = false;
+
+   var.key = BEETLE_OPT(compressed_savestates);
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+   {
+      if (strcmp(var.value, "enabled") == 0)
+         compressed_savestates = true;
+      else if (strcmp(var.value, "disabled") == 0)
+         compressed_savestates = false;
+   }
+   else
+      compressed_savestates = false;
 }
 
 #ifdef NEED_CD
@@ -3524,6 +3616,8 @@ void retro_unload_game(void)
 
    MDFNMP_Kill();
 
+   invalidate_serialize_size();
+
    MDFNGameInfo = NULL;
 
    for(unsigned i = 0; i < CDInterfaces.size(); i++)
@@ -3691,6 +3785,7 @@ void retro_run(void)
    assert(timestamp);
 
    ForceEventUpdates(timestamp);
+   GPU_RasterSync();
 #if 0
    if(GPU_GetScanlineNum() < 100)
       PSX_DBG(PSX_DBG_ERROR, "[BUUUUUUUG] Frame timing end glitch; scanline=%u, st=%u\n", GPU_GetScanlineNum(), timestamp);
@@ -3698,6 +3793,7 @@ void retro_run(void)
 
    //printf("scanline=%u, st=%u\n", GPU_GetScanlineNum(), timestamp);
 
+   PSX_SPU->FlushSamples();
    espec->SoundBufSize = IntermediateBufferPos;
    IntermediateBufferPos = 0;
 
@@ -3915,6 +4011,8 @@ void retro_deinit(void)
    delete surf;
    surf = NULL;
 
+   MDFNSS_Deinit();
+
    log_cb(RETRO_LOG_INFO, "[%s]: Samples / Frame: %.5f\n",
          MEDNAFEN_CORE_NAME, (double)audio_frames / video_frames);
    log_cb(RETRO_LOG_INFO, "[%s]: Estimated FPS: %.5f\n",
@@ -3955,6 +4053,9 @@ void retro_set_environment(retro_environment_t cb)
       { BEETLE_OPT(mdec_yuv), "MDEC YUV Chroma filter; disabled|enabled" },
 #endif
       { BEETLE_OPT(internal_resolution), "Internal GPU resolution; 1x(native)|2x|4x|8x|16x" },
+#if HAVE_THREADS
+      { BEETLE_OPT(renderer_software_threads), "Software renderer threads; disabled|1|2|3|4|6|8" },
+#endif
 #if defined(HAVE_OPENGL) || defined(HAVE_OPENGLES)
       // Only used in GL renderer for now.
       { BEETLE_OPT(depth), "Internal color depth; dithered 16bpp (native)|32bpp" },
@@ -3972,6 +4073,7 @@ void retro_set_environment(retro_environment_t cb)
       { BEETLE_OPT(frame_duping), "Frame duping (speedup); disabled|enabled" },
       { BEETLE_OPT(cpu_freq_scale), "CPU frequency scaling (overclock); 100% (native)|110%|120%|130%|140%|150%|160%|170%|180%|190%|200%|210%|220%|230%|240%|250%|260%|265%|270%|280%|290%|300%|310%|320%|330%|340%|350%|360%|370%|380%|390%|400%|410%|420%|430%|440%|450%|460%|470%|480%|490%|500%|50%|60%|70%|80%|90%" },
       { BEETLE_OPT(gte_overclock), "GTE Overclock; disabled|enabled" },
+      { BEETLE_OPT(cpu_idle_skip), "CPU idle loop skipping; disabled|accurate|fast" },
       { BEETLE_OPT(gpu_overclock), "GPU rasterizer overclock; 1x(native)|2x|4x|8x|16x|32x" },
       { BEETLE_OPT(skip_bios), "Skip BIOS; disabled|enabled" },
       { BEETLE_OPT(dither_mode), "Dithering pattern; 1x(native)|internal resolution|disabled" },
@@ -4000,7 +4102,9 @@ void retro_set_environment(retro_environment_t cb)
       { BEETLE_OPT(use_mednafen_memcard0_method), "Memcard 0 method; libretro|mednafen" },
       { BEETLE_OPT(enable_memcard1), "Enable memory card 1; enabled|disabled" },
       { BEETLE_OPT(shared_memory_cards), "Shared memcards (restart); disabled|enabled" },
-      { BEETLE_OPT(cd_fastload), "Increase CD loading speed; 2x (native)|4x|6x|8x|10x|12x|14x" },
+      { BEETLE_OPT(cd_fastload), "Increase CD loading speed; 2x (native)|4x|6x|8x|10x|12x|14x|adaptive" },
+      { BEETLE_OPT(incremental_savestates), "Incremental savestates (run-ahead); disabled|enabled" },
+      { BEETLE_OPT(compressed_savestates), "Compressed savestates; disabled|enabled" },
       { NULL, NULL },
    };
    cb(RETRO_ENVIRONMENT_SET_VARIABLES, (void*)vars);
@@ -4042,28 +4146,24 @@ void retro_set_video_refresh(retro_video_refresh_t cb)
    rsx_intf_set_video_refresh(cb);
 }
 
-static size_t serialize_size;
-
 size_t retro_serialize_size(void)
 {
    if (enable_variable_serialization_size)
    {
-      StateMem st;
-
-      st.data           = NULL;
-      st.loc            = 0;
-      st.len            = 0;
-      st.malloced       = 0;
-      st.initial_malloc = 0;
-
-      if (!MDFNSS_SaveSM(&st, 0, 0, NULL, NULL, NULL))
-         return 0;
+      // The state only changes size along with the settings and devices, so it's measured once and then kept until
+      // one of those changes(see invalidate_serialize_size()).  Measured without fast savestates, which only make it
+      // smaller, and for compressed savestates as if nothing compressed.
+      if (!serialize_size)
+      {
+         CompressedSaveStates = compressed_savestates;
+         serialize_size = MDFNSS_SaveSize();
+         CompressedSaveStates = false;
+      }
 
-      free(st.data);
-      return serialize_size = st.len;
+      return serialize_size;
    }
 
-   return serialize_size = DEFAULT_STATE_SIZE; // 16MB
+   return DEFAULT_STATE_SIZE; // 16MB
 }
 
 bool UsingFastSavestates()
@@ -4078,59 +4178,45 @@ bool UsingFastSavestates()
 
 bool retro_serialize(void *data, size_t size)
 {
-   if (size == DEFAULT_STATE_SIZE)  //16MB buffer reserved
-   {
-      //actual size is around 3.75MB (3.67MB for fast savestates) rather than 16MB, so 16MB will hold a savestate without worrying about realloc
-
-      //save state in place
-      StateMem st;
-      st.data = (uint8_t*)data;
-      st.len = 0;
-      st.loc = 0;
-      st.malloced = size;
-      st.initial_malloc = 0;
-
-      //fast save states are at least 20% faster
-      FastSaveStates = UsingFastSavestates();
-      bool ret = MDFNSS_SaveSM(&st, 0, 0, NULL, NULL, NULL);
-      FastSaveStates = false;
-      return ret;
-   }
-   else
-   {
-      /* it seems that mednafen can realloc pointers sent to it?
-         since we don't know the disposition of void* data (is it safe to realloc?) we have to manage a new buffer here */
-      static bool logged;
-      StateMem st;
-      bool ret = false;
-      uint8_t *_dat = (uint8_t*)malloc(size);
+   //with a 16MB buffer reserved, the actual size is around 3.75MB (3.67MB for fast savestates) rather than 16MB;
+   //otherwise the frontend sized the buffer from retro_serialize_size().  Either way the state is written in place,
+   //and fails rather than overrunning the buffer if it doesn't fit
+   static bool logged;
+   StateMem st;
 
-      if (!_dat)
-         return false;
+   st.data           = (uint8_t*)data;
+   st.loc            = 0;
+   st.len            = 0;
+   st.malloced       = size;
+   st.initial_malloc = 0;
+   st.fixed          = true;
 
-      st.data = _dat;
-      st.loc = 0;
-      st.len = 0;
-      st.malloced = size;
-      st.initial_malloc = 0;
+   //fast save states are at least 20% faster
+   FastSaveStates = UsingFastSavestates();
+   //only what changed needs writing when the buffer still holds one of our recent states
+   IncrementalSaveStates = incremental_savestates;
+   CompressedSaveStates = compressed_savestates;
+   if (MainRAM_Exposed)
+      StateDirty_MarkAll(&MainRAM_Dirty);
+   bool ret = MDFNSS_SaveSM(&st, 0, 0, NULL, NULL, NULL);
+   FastSaveStates = false;
+   IncrementalSaveStates = false;
+   CompressedSaveStates = false;
 
-      /* there are still some errors with the save states,
-       * the size seems to change on some games for now
-       * just log when this happens */
-      if (!logged && st.len != size)
+   if (!ret && st.len > size)
+   {
+      /* something changed the size of the state without going through
+       * invalidate_serialize_size(); measure it again next time */
+      if (!logged)
       {
          log_cb(RETRO_LOG_WARN, "warning, save state size has changed\n");
          logged = true;
       }
 
-      FastSaveStates = UsingFastSavestates();
-      ret = MDFNSS_SaveSM(&st, 0, 0, NULL, NULL, NULL);
-      FastSaveStates = false;
-
-      memcpy(data, st.data, size);
-      free(st.data);
-      return ret;
+      invalidate_serialize_size();
    }
+
+   return ret;
 }
 
 bool retro_unserialize(const void *data, size_t size)
@@ -4142,11 +4228,16 @@ bool retro_unserialize(const void *data, size_t size)
    st.len            = size;
    st.malloced       = 0;
    st.initial_malloc = 0;
+   st.fixed          = true;
 
    //fast save states are at least 20% faster
    FastSaveStates = UsingFastSavestates();
+   IncrementalSaveStates = incremental_savestates;
+   if (MainRAM_Exposed)
+      StateDirty_MarkAll(&MainRAM_Dirty);
    bool okay = MDFNSS_LoadSM(&st, 0, 0);
    FastSaveStates = false;
+   IncrementalSaveStates = false;
    return okay;
 }
 
@@ -4157,6 +4248,7 @@ void *retro_get_memory_data(unsigned type)
    switch (type)
    {
       case RETRO_MEMORY_SYSTEM_RAM:
+         MainRAM_Exposed = true;
          return MainRAM.data8;
       case RETRO_MEMORY_SAVE_RAM:
          if (use_mednafen_memcard0_method)
@@ -5,7 +5,7 @@
 #define MEDNAFEN_CORE_NAME "Beetle PSX"
 #endif
 #define MEDNAFEN_CORE_VERSION "0.9.44.1"
-#define MEDNAFEN_CORE_EXTENSIONS "exe|cue|toc|ccd|m3u|pbp|chd"
+#define MEDNAFEN_CORE_EXTENSIONS "exe|cue|toc|ccd|m3u|pbp|chd|dcf"
 #define MEDNAFEN_CORE_GEOMETRY_BASE_W 320
 #define MEDNAFEN_CORE_GEOMETRY_BASE_H 240
 #define MEDNAFEN_CORE_GEOMETRY_MAX_W 700
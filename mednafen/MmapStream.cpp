@@ -0,0 +1,204 @@
+/* Mednafen - Multi-system Emulator
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "MmapStream.h"
+#include "error.h"
+
+#include <string.h>
+
+#include <memmap.h>
+
+#ifdef HAVE_MMAN
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/vfs.h>
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__DragonFly__)
+#include <sys/param.h>
+#include <sys/mount.h>
+#endif
+
+// Whether fd is a regular file on a filesystem that can't drop out from under a mapping the way a network share can.
+// Where that can't be told, nothing is mapped.
+static bool IsLocalRegularFile(int fd, const struct stat *st)
+{
+   if(!S_ISREG(st->st_mode))
+      return false;
+
+#if defined(__linux__)
+   struct statfs sfs;
+
+   if(fstatfs(fd, &sfs))
+      return false;
+
+   switch((uint32)sfs.f_type)
+   {
+      case 0x6969:      // NFS
+      case 0x517B:      // SMB
+      case 0xFF534D42:  // CIFS
+      case 0xFE534D42:  // SMB2
+      case 0x564C:      // NCP
+      case 0x65735546:  // FUSE(sshfs, etc.)
+      case 0x01021997:  // 9P
+      case 0x00C36400:  // Ceph
+      case 0x73757245:  // Coda
+      case 0x5346414F:  // AFS
+      case 0x6B414653:  // kAFS
+         return false;
+   }
+
+   return true;
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__DragonFly__)
+   struct statfs sfs;
+
+   if(fstatfs(fd, &sfs))
+      return false;
+
+   return (sfs.f_flags & MNT_LOCAL) != 0;
+#else
+   return false;
+#endif
+}
+#endif
+
+MmapStream::MmapStream(const char *path) : data_buffer(NULL), data_buffer_size(0), position(0), last_read_end(0), readahead_end(0)
+{
+#ifdef HAVE_MMAN
+   struct stat st;
+   void *p;
+   int fd = open(path, O_RDONLY);
+
+   if(fd < 0)
+      return;
+
+   if(fstat(fd, &st) || !IsLocalRegularFile(fd, &st) || st.st_size <= 0 || (uint64)st.st_size > SIZE_MAX)
+   {
+      ::close(fd);
+      return;
+   }
+
+   p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+   ::close(fd);	// The mapping keeps its own reference to the file.
+
+   if(p == MAP_FAILED)
+      return;
+
+   data_buffer = (uint8 *)p;
+   data_buffer_size = st.st_size;
+#endif
+}
+
+MmapStream::~MmapStream()
+{
+   close();
+}
+
+uint8 *MmapStream::map(void)
+{
+   return data_buffer;
+}
+
+void MmapStream::advise(uint64 offset, uint64 count)
+{
+#if defined(HAVE_MMAN) && defined(MADV_WILLNEED)
+   // madvise() wants a page-aligned start; 4KiB covers every page size we run on.
+   const uint64 start = offset & ~(uint64)4095;
+
+   if(offset + count > data_buffer_size)
+      count = data_buffer_size - offset;
+
+   madvise(data_buffer + start, (size_t)(offset + count - start), MADV_WILLNEED);
+#endif
+}
+
+uint64 MmapStream::read(void *data, uint64 count, bool error_on_eos)
+{
+   if(position >= data_buffer_size)
+      return 0;
+
+   if(count > data_buffer_size - position)
+      count = data_buffer_size - position;
+
+   if(position != last_read_end)
+      readahead_end = position;	// Jumped somewhere else; wait and see if reads carry on from here.
+   else if(position + readahead_size / 2 > readahead_end && readahead_end < data_buffer_size)
+   {
+      const uint64 start = (readahead_end > position) ? readahead_end : position;
+
+      advise(start, position + readahead_size - start);
+      readahead_end = position + readahead_size;
+   }
+
+   memcpy(data, data_buffer + position, (size_t)count);
+   position += count;
+   last_read_end = position;
+
+   return count;
+}
+
+void MmapStream::write(const void *data, uint64 count)
+{
+   throw MDFN_Error(ErrnoHolder(EBADF));
+}
+
+void MmapStream::seek(int64 offset, int whence)
+{
+   int64 new_position = position;
+
+   switch(whence)
+   {
+      case SEEK_SET:
+         new_position = offset;
+         break;
+
+      case SEEK_CUR:
+         new_position = position + offset;
+         break;
+
+      case SEEK_END:
+         new_position = data_buffer_size + offset;
+         break;
+   }
+
+   if(new_position < 0)
+      throw MDFN_Error(ErrnoHolder(EINVAL));
+
+   position = new_position;
+}
+
+uint64_t MmapStream::tell(void)
+{
+   return position;
+}
+
+uint64_t MmapStream::size(void)
+{
+   return data_buffer_size;
+}
+
+void MmapStream::close(void)
+{
+#ifdef HAVE_MMAN
+   if(data_buffer)
+      munmap(data_buffer, (size_t)data_buffer_size);
+#endif
+   data_buffer = NULL;
+   data_buffer_size = 0;
+   position = 0;
+}
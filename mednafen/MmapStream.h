@@ -0,0 +1,66 @@
+/* Mednafen - Multi-system Emulator
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __MDFN_MMAPSTREAM_H
+#define __MDFN_MMAPSTREAM_H
+
+#include "Stream.h"
+
+// Read-only stream over a file mapped into memory.  A read is a copy out of the OS page cache, with no system call
+// and no buffer of our own in between, and readahead is requested with madvise() as sequential reads come in.
+//
+// Only regular files on local filesystems are mapped.  Once a file is mapped, an I/O error or the file getting
+// truncated turns the next access to the pages affected into a SIGBUS instead of a failed read().  That's no worse
+// than a local disk going bad under any other mapped file, but a network mount or FUSE filesystem can fail at any
+// time, so those are read through FileStream instead.  No SIGBUS handler is installed; a process-wide one isn't
+// something a core can own.
+//
+// Where mmap() isn't available, or the file isn't a local regular file, can't be opened directly(e.g. it's only
+// reachable through the frontend's VFS) or mapped(e.g. not enough address space), map() returns NULL after
+// construction and the caller should fall back to FileStream.
+class MmapStream : public Stream
+{
+ public:
+
+ MmapStream(const char *path);
+ virtual ~MmapStream();
+
+ uint8 *map(void);
+
+ virtual uint64 read(void *data, uint64 count, bool error_on_eos = true);
+ virtual void write(const void *data, uint64 count);
+ virtual void seek(int64 offset, int whence);
+ virtual uint64_t tell(void);
+ virtual uint64_t size(void);
+ virtual void close(void);
+
+ private:
+ uint8 *data_buffer;
+ uint64 data_buffer_size;
+
+ uint64 position;
+
+ // Reads that carry on from where the last one ended hint that the next readahead_size bytes will be needed soon,
+ // whenever position gets within half of that of the end of the last hint.
+ enum { readahead_size = 1024 * 1024 };
+ uint64 last_read_end;
+ uint64 readahead_end;
+
+ void advise(uint64 offset, uint64 count);
+};
+
+#endif
@@ -0,0 +1,257 @@
+/* Mednafen - Multi-system Emulator
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "PreloadStream.h"
+#include "error.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+PreloadStream::PreloadStream(Stream *stream) : source(stream), data_buffer(NULL), data_buffer_size(0), position(0),
+   chunk_loaded(NULL), chunk_count(0), chunks_left(0), head_chunk(0)
+{
+   data_buffer_size = source->size();
+
+   // Without room for the copy, everything is read from "source".
+   if(data_buffer_size > 0 && data_buffer_size <= SIZE_MAX && (data_buffer = (uint8 *)malloc((size_t)data_buffer_size)))
+   {
+      chunk_count = (data_buffer_size + chunk_size - 1) / chunk_size;
+      chunks_left = chunk_count;
+      chunk_loaded = new bool[chunk_count];
+      memset(chunk_loaded, 0, chunk_count * sizeof(bool));
+   }
+
+#ifdef HAVE_THREADS
+   state_lock = slock_new();
+   source_lock = slock_new();
+   quit = false;
+   thread = chunks_left ? sthread_create(Thread_Main, this) : NULL;
+#else
+   for(uint32 chunk = 0; chunk < chunk_count; chunk++)
+   {
+      if(!LoadChunk(chunk))
+         break;
+   }
+#endif
+}
+
+PreloadStream::~PreloadStream()
+{
+   close();
+
+#ifdef HAVE_THREADS
+   slock_free(state_lock);
+   slock_free(source_lock);
+#endif
+}
+
+bool PreloadStream::LoadChunk(uint32 chunk)
+{
+   const uint64 offset = (uint64)chunk * chunk_size;
+   const uint64 count = (data_buffer_size - offset < chunk_size) ? data_buffer_size - offset : chunk_size;
+   uint64 got;
+
+#ifdef HAVE_THREADS
+   slock_lock(source_lock);
+#endif
+   source->seek(offset, SEEK_SET);
+   got = source->read(data_buffer + offset, count, false);
+#ifdef HAVE_THREADS
+   slock_unlock(source_lock);
+#endif
+
+   if(got != count)
+      return false;
+
+#ifdef HAVE_THREADS
+   slock_lock(state_lock);
+#endif
+   chunk_loaded[chunk] = true;
+   chunks_left--;
+#ifdef HAVE_THREADS
+   slock_unlock(state_lock);
+#endif
+
+   return true;
+}
+
+// Picks the chunk not loaded yet that's nearest head_chunk, the one after it if it's a tie.  Called with state_lock
+// held.
+bool PreloadStream::NextChunk(uint32 *chunk)
+{
+   uint32 ahead = head_chunk;
+   uint32 behind = head_chunk;
+
+   if(!chunks_left)
+      return false;
+
+   while(ahead < chunk_count && chunk_loaded[ahead])
+      ahead++;
+
+   while(behind > 0 && chunk_loaded[behind - 1])
+      behind--;
+
+   if(ahead < chunk_count && (behind == 0 || ahead - head_chunk <= head_chunk - behind))
+      *chunk = ahead;
+   else
+      *chunk = behind - 1;
+
+   return true;
+}
+
+#ifdef HAVE_THREADS
+void PreloadStream::Thread_Main(void *arg)
+{
+   PreloadStream *ps = (PreloadStream *)arg;
+
+   for(;;)
+   {
+      uint32 chunk;
+      bool have_chunk;
+
+      slock_lock(ps->state_lock);
+      have_chunk = !ps->quit && ps->NextChunk(&chunk);
+      slock_unlock(ps->state_lock);
+
+      // On a read error, leave the rest to be read from the file as it's needed.
+      if(!have_chunk || !ps->LoadChunk(chunk))
+         break;
+   }
+}
+#endif
+
+uint64 PreloadStream::read(void *data, uint64 count, bool error_on_eos)
+{
+   bool loaded = (chunk_loaded != NULL);
+   uint32 first, last;
+
+   if(position >= data_buffer_size)
+      return 0;
+
+   if(count > data_buffer_size - position)
+      count = data_buffer_size - position;
+
+   if(!count)
+      return 0;
+
+   first = position / chunk_size;
+   last = (position + count - 1) / chunk_size;
+
+   if(loaded)
+   {
+#ifdef HAVE_THREADS
+      slock_lock(state_lock);
+#endif
+      head_chunk = first;
+
+      for(uint32 chunk = first; loaded && chunk <= last; chunk++)
+         loaded = chunk_loaded[chunk];
+#ifdef HAVE_THREADS
+      slock_unlock(state_lock);
+#endif
+   }
+
+   if(loaded)
+      memcpy(data, data_buffer + position, (size_t)count);
+   else
+   {
+#ifdef HAVE_THREADS
+      slock_lock(source_lock);
+#endif
+      source->seek(position, SEEK_SET);
+      count = source->read(data, count, error_on_eos);
+#ifdef HAVE_THREADS
+      slock_unlock(source_lock);
+#endif
+   }
+
+   position += count;
+
+   return count;
+}
+
+void PreloadStream::write(const void *data, uint64 count)
+{
+   throw MDFN_Error(ErrnoHolder(EBADF));
+}
+
+void PreloadStream::seek(int64 offset, int whence)
+{
+   int64 new_position = position;
+
+   switch(whence)
+   {
+      case SEEK_SET:
+         new_position = offset;
+         break;
+
+      case SEEK_CUR:
+         new_position = position + offset;
+         break;
+
+      case SEEK_END:
+         new_position = data_buffer_size + offset;
+         break;
+   }
+
+   if(new_position < 0)
+      throw MDFN_Error(ErrnoHolder(EINVAL));
+
+   position = new_position;
+}
+
+uint64_t PreloadStream::tell(void)
+{
+   return position;
+}
+
+uint64_t PreloadStream::size(void)
+{
+   return data_buffer_size;
+}
+
+void PreloadStream::close(void)
+{
+#ifdef HAVE_THREADS
+   if(thread)
+   {
+      slock_lock(state_lock);
+      quit = true;
+      slock_unlock(state_lock);
+
+      sthread_join(thread);
+      thread = NULL;
+   }
+#endif
+
+   if(source)
+   {
+      source->close();
+      delete source;
+      source = NULL;
+   }
+
+   free(data_buffer);
+   delete[] chunk_loaded;
+
+   data_buffer = NULL;
+   data_buffer_size = 0;
+   chunk_loaded = NULL;
+   chunk_count = 0;
+   chunks_left = 0;
+   position = 0;
+}
@@ -0,0 +1,78 @@
+/* Mednafen - Multi-system Emulator
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __MDFN_PRELOADSTREAM_H
+#define __MDFN_PRELOADSTREAM_H
+
+#include "Stream.h"
+
+#ifdef HAVE_THREADS
+#include <rthreads/rthreads.h>
+#endif
+
+// Read-only in-memory copy of "stream", like MemoryStream(Stream *), except that the copy is filled in by a thread
+// of its own after construction instead of by the constructor, so that opening a large file doesn't hold everything
+// up.  Reads of parts that aren't in yet go to "stream".
+//
+// The thread loads the chunks nearest to where the last read was first, working outward from there, so that what's
+// about to be read is in memory soonest; before the first read, that's the start of the file.
+//
+// Without threads, the whole copy is made by the constructor.
+class PreloadStream : public Stream
+{
+ public:
+
+ PreloadStream(Stream *stream);	// Takes ownership of "stream", which has to be seekable.
+ virtual ~PreloadStream();
+
+ virtual uint64 read(void *data, uint64 count, bool error_on_eos = true);
+ virtual void write(const void *data, uint64 count);
+ virtual void seek(int64 offset, int whence);
+ virtual uint64_t tell(void);
+ virtual uint64_t size(void);
+ virtual void close(void);
+
+ private:
+ Stream *source;
+
+ uint8 *data_buffer;
+ uint64 data_buffer_size;
+
+ uint64 position;
+
+ enum { chunk_size = 256 * 1024 };
+ bool *chunk_loaded;
+ uint32 chunk_count;
+ uint32 chunks_left;
+ uint32 head_chunk;	// Chunk of the last read.
+
+ bool LoadChunk(uint32 chunk);
+ bool NextChunk(uint32 *chunk);
+
+#ifdef HAVE_THREADS
+ // state_lock guards chunk_loaded, chunks_left and head_chunk; source_lock guards "source".  Chunks are copied into
+ // data_buffer with neither held, and never written again once marked as loaded.
+ slock_t *state_lock;
+ slock_t *source_lock;
+ sthread_t *thread;
+ bool quit;
+
+ static void Thread_Main(void *arg);
+#endif
+};
+
+#endif
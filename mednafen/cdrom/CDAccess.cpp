@@ -28,6 +28,7 @@
 #include "CDAccess.h"
 #include "CDAccess_Image.h"
 #include "CDAccess_CCD.h"
+#include "CDAccess_DCF.h"
 #ifdef HAVE_PBP
 #include "CDAccess_PBP.h"
 #endif
@@ -35,20 +36,27 @@
 #include "CDAccess_CHD.h"
 #endif
 
-CDAccess::CDAccess()
+// Q subchannel byte -> the D6 bits of the eight interleaved subchannel bytes it's spread over, MSB first.
+static uint8_t SubQ_Spread[256][8];
+static bool SubQ_Spread_Inited = false;
+
+CDAccess::CDAccess() : subq_tracks(NULL), subq_first_track(0), subq_num_tracks(0), subq_table(NULL),
+   subq_table_start(0), subq_table_count(0)
 {
 
 }
 
 CDAccess::~CDAccess()
 {
-
+   free(subq_table);
 }
 
 CDAccess *cdaccess_open_image(bool *success, const char *path, bool image_memcache)
 {
    if(strlen(path) >= 4 && !strcasecmp(path + strlen(path) - 4, ".ccd"))
       return new CDAccess_CCD(success, path, image_memcache);
+   else if(strlen(path) >= 4 && !strcasecmp(path + strlen(path) - 4, ".dcf"))
+      return new CDAccess_DCF(success, path, image_memcache);
 #ifdef HAVE_PBP
    else if(strlen(path) >= 4 && !strcasecmp(path + strlen(path) - 4, ".pbp"))
       return new CDAccess_PBP(path, image_memcache);
@@ -70,3 +78,187 @@ bool CDAccess::Read_Raw_PW(uint8_t *buf, int32_t lba)
 
    return true;
 }
+
+// Synthesizes the Q subchannel data of "lba" into subq, and the P subchannel(pause) byte into *pause_or.  Returns
+// the track "lba" is in.
+int32_t CDAccess::SubQ_Synth(int32_t lba, uint8_t *subq, uint8_t *pause_or)
+{
+   const CDRFILE_TRACK_INFO *Tracks = subq_tracks;
+   uint8_t adr, control;
+   int32_t track;
+   uint32_t lba_relative;
+   uint32_t ma, sa, fa;
+   uint32_t m, s, f;
+   bool track_found = false;
+
+   *pause_or = 0x00;
+
+   for(track = subq_first_track; track < (subq_first_track + subq_num_tracks); track++)
+   {
+      if(lba >= (Tracks[track].LBA - Tracks[track].pregap_dv - Tracks[track].pregap) && lba < (Tracks[track].LBA + Tracks[track].sectors + Tracks[track].postgap))
+      {
+         track_found = true;
+         break;
+      }
+   }
+
+   if(!track_found)
+   {
+      printf("MakeSubPQ error for sector %u!", lba);
+      track = subq_first_track;
+   }
+
+   lba_relative = abs((int32)lba - Tracks[track].LBA);
+
+   f            = (lba_relative % 75);
+   s            = ((lba_relative / 75) % 60);
+   m            = (lba_relative / 75 / 60);
+
+   fa           = (lba + 150) % 75;
+   sa           = ((lba + 150) / 75) % 60;
+   ma           = ((lba + 150) / 75 / 60);
+
+   adr          = 0x1; // Q channel data encodes position
+   control      = Tracks[track].subq_control;
+
+   // Handle pause(D7 of interleaved subchannel byte) bit, should be set to 1 when in pregap or postgap.
+   if((lba < Tracks[track].LBA) || (lba >= Tracks[track].LBA + Tracks[track].sectors))
+      *pause_or = 0x80;
+
+   // Handle pregap between audio->data track
+   {
+      int32_t pg_offset = (int32)lba - Tracks[track].LBA;
+
+      // If we're more than 2 seconds(150 sectors) from the real "start" of the track/INDEX 01, and the track is a data track,
+      // and the preceding track is an audio track, encode it as audio(by taking the SubQ control field from the preceding track).
+      //
+      // TODO: Look into how we're supposed to handle subq control field in the four combinations of track types(data/audio).
+      //
+      if(pg_offset < -150)
+      {
+         if((Tracks[track].subq_control & SUBQ_CTRLF_DATA) && (subq_first_track < track) && !(Tracks[track - 1].subq_control & SUBQ_CTRLF_DATA))
+            control = Tracks[track - 1].subq_control;
+      }
+   }
+
+   memset(subq, 0, 0xC);
+   subq[0] = (adr << 0) | (control << 4);
+   subq[1] = U8_to_BCD(track);
+
+   if(lba < Tracks[track].LBA) // Index is 00 in pregap
+      subq[2] = U8_to_BCD(0x00);
+   else
+      subq[2] = U8_to_BCD(0x01);
+
+   /* Track relative MSF address */
+   subq[3] = U8_to_BCD(m);
+   subq[4] = U8_to_BCD(s);
+   subq[5] = U8_to_BCD(f);
+   subq[6] = 0;
+   /* Absolute MSF address */
+   subq[7] = U8_to_BCD(ma);
+   subq[8] = U8_to_BCD(sa);
+   subq[9] = U8_to_BCD(fa);
+
+   subq_generate_checksum(subq);
+
+   if(!SubQReplaceMap.empty())
+   {
+      std::map<uint32_t, cpp11_array_doodad>::const_iterator it = SubQReplaceMap.find(LBA_to_ABA(lba));
+
+      if(it != SubQReplaceMap.end())
+         memcpy(subq, it->second.data, 12);
+   }
+
+   return track;
+}
+
+void CDAccess::SubQ_Build(const CDRFILE_TRACK_INFO *tracks, int32_t first_track, int32_t num_tracks)
+{
+   int32_t start = 0, end = 0;
+
+   if(!SubQ_Spread_Inited)
+   {
+      for(unsigned q = 0; q < 256; q++)
+      {
+         for(unsigned b = 0; b < 8; b++)
+            SubQ_Spread[q][b] = ((q >> (7 - b)) & 1) << 6;
+      }
+
+      SubQ_Spread_Inited = true;
+   }
+
+   subq_tracks = tracks;
+   subq_first_track = first_track;
+   subq_num_tracks = num_tracks;
+
+   free(subq_table);
+   subq_table = NULL;
+   subq_table_start = 0;
+   subq_table_count = 0;
+
+   for(int32_t track = first_track; track < (first_track + num_tracks); track++)
+   {
+      const int32_t track_start = tracks[track].LBA - tracks[track].pregap_dv - tracks[track].pregap;
+      const int32_t track_end = tracks[track].LBA + tracks[track].sectors + tracks[track].postgap;
+
+      if(track == first_track || track_start < start)
+         start = track_start;
+
+      if(track == first_track || track_end > end)
+         end = track_end;
+   }
+
+   // Without room for the table, everything is synthesized as it's read.
+   if(end <= start || !(subq_table = (uint8_t *)malloc((size_t)(end - start) * 13)))
+      return;
+
+   subq_table_start = start;
+   subq_table_count = end - start;
+
+   for(uint32_t i = 0; i < subq_table_count; i++)
+   {
+      uint8_t *entry = &subq_table[i * 13];
+      uint8_t pause_or;
+
+      entry[12] = SubQ_Synth(start + i, entry, &pause_or) | pause_or;
+   }
+}
+
+int32_t CDAccess::SubQ_Make(int32_t lba, uint8_t *SubPWBuf)
+{
+   uint8_t buf[0xC];
+   const uint8_t *subq;
+   uint8_t pause_or;
+   int32_t track;
+
+   if(!subq_tracks)
+      return 0;
+
+   if((uint32_t)(lba - subq_table_start) < subq_table_count)
+   {
+      const uint8_t *entry = &subq_table[(lba - subq_table_start) * 13];
+
+      subq = entry;
+      pause_or = entry[12] & 0x80;
+      track = entry[12] & 0x7F;
+   }
+   else
+   {
+      track = SubQ_Synth(lba, buf, &pause_or);
+      subq = buf;
+   }
+
+   // Eight subchannel bytes at a time, each getting one bit of Q in D6.
+   for(unsigned i = 0; i < 12; i++)
+   {
+      uint64_t pw, spread;
+
+      memcpy(&pw, &SubPWBuf[i << 3], 8);
+      memcpy(&spread, SubQ_Spread[subq[i]], 8);
+      pw |= spread | (pause_or * (uint64_t)0x0101010101010101ULL);
+      memcpy(&SubPWBuf[i << 3], &pw, 8);
+   }
+
+   return track;
+}
@@ -4,11 +4,15 @@
 #include <stdio.h>
 #include <stdint.h>
 
+#include <map>
+
 #include <boolean.h>
 
 #include "CDUtility.h"
 #include "misc.h"
 
+struct CDRFILE_TRACK_INFO;
+
 class CDAccess
 {
  public:
@@ -24,7 +28,40 @@ class CDAccess
 
  virtual void Eject(bool eject_status) = 0;		// Eject a disc if it's physical, otherwise NOP.  Returns true on success(or NOP), false on error
 
+ protected:
+
+ struct cpp11_array_doodad
+ {
+    uint8_t data[12];
+ };
+
+ // Q subchannel data loaded from an .sbi file, by ABA, used in place of what would be synthesized.
+ std::map<uint32_t, cpp11_array_doodad> SubQReplaceMap;
+
+ // For images that don't store subchannel data: synthesizes P and Q for every sector of tracks first_track through
+ // first_track + num_tracks - 1 of "tracks", pregaps and postgaps included, into a table, so that SubQ_Make() is a
+ // lookup.  Call it whenever the track layout or SubQReplaceMap changes, before reading any sectors; "tracks" has
+ // to stay valid until it's called again.
+ void SubQ_Build(const CDRFILE_TRACK_INFO *tracks, int32_t first_track, int32_t num_tracks);
+
+ // ORs the P and Q subchannel data of "lba" into SubPWBuf, and returns the track it's in.  Sectors outside of the
+ // table(lead-out) are synthesized as they're asked for.
+ int32_t SubQ_Make(int32_t lba, uint8_t *SubPWBuf);
+
  private:
+
+ int32_t SubQ_Synth(int32_t lba, uint8_t *subq, uint8_t *pause_or);
+
+ const CDRFILE_TRACK_INFO *subq_tracks;
+ int32_t subq_first_track;
+ int32_t subq_num_tracks;
+
+ // 13 bytes a sector from LBA subq_table_start on: Q(12 bytes, deinterleaved), then the track number, with bit 7
+ // set if the P(pause) bits are.
+ uint8_t *subq_table;
+ int32_t subq_table_start;
+ uint32_t subq_table_count;
+
  CDAccess(const CDAccess&);	// No copy constructor.
  CDAccess& operator=(const CDAccess&); // No assignment operator.
 };
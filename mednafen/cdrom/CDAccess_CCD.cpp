@@ -18,6 +18,7 @@
 #include "../mednafen.h"
 #include "../error.h"
 #include "../general.h"
+#include "../PreloadStream.h"
 #include <compat/msvc.h>
 #include "CDAccess_CCD.h"
 #include "CDUtility.h"
@@ -252,7 +253,7 @@ bool CDAccess_CCD::Load(const char *path, bool image_memcache)
       FileStream *str        = new FileStream(image_path.c_str(), MODE_READ);
 
       if(image_memcache)
-         img_stream = new MemoryStream(str);
+         img_stream = new PreloadStream(str);
       else
          img_stream = str;
 
@@ -273,7 +274,7 @@ bool CDAccess_CCD::Load(const char *path, bool image_memcache)
       FileStream *str      = new FileStream(sub_path.c_str(), MODE_READ);
 
       if(image_memcache)
-         sub_stream = new MemoryStream(str);
+         sub_stream = new PreloadStream(str);
       else
          sub_stream = str;
 
@@ -58,16 +58,26 @@ bool CDAccess_CHD::ImageOpen(const char *path, bool image_memcache)
 
    if (image_memcache)
    {
+#if HAVE_THREADS
+      /* read in by the prefetch thread, so as not to hold up loading */
+      preloading = chd_precache_begin(chd) == CHDERR_NONE;
+#else
       err = chd_precache(chd);
       if (err != CHDERR_NONE)
          return false;
+#endif
    }
 
    /* allocate storage for sector reads */
    const chd_header *head = chd_get_header(chd);
-   hunkmem = (uint8_t*)malloc(head->hunkbytes);
-   oldhunk = -1;
-   
+   for (unsigned i = 0; i < CHD_HUNK_CACHE_SIZE; i++)
+   {
+      hunks[i].data = (uint8_t*)malloc(head->hunkbytes);
+      if (hunks[i].data == NULL)
+         return false;
+   }
+   hunk_count = head->totalhunks;
+
    log_cb(RETRO_LOG_INFO, "chd_load '%s' hunkbytes=%d\n", path, head->hunkbytes);
 
    int plba = -150;
@@ -197,22 +207,70 @@ bool CDAccess_CHD::ImageOpen(const char *path, bool image_memcache)
    }
    sbi_path = MDFN_EvalFIP(base_dir, file_base + std::string(".") + std::string(sbi_ext), true);
 
+#if HAVE_THREADS
+   /* not until the metadata has been read, the thread uses the file too */
+   prefetch_thread = sthread_create(PrefetchThread_Main, this);
+#endif
+
    return true;
 }
 
 void CDAccess_CHD::Cleanup(void)
 {
+#if HAVE_THREADS
+   if (prefetch_thread != NULL)
+   {
+      slock_lock(hunk_lock);
+      prefetch_quit = true;
+      scond_broadcast(hunk_cond);
+      slock_unlock(hunk_lock);
+
+      sthread_join(prefetch_thread);
+      prefetch_thread = NULL;
+   }
+#endif
+
    if(chd != NULL)
       chd_close(chd);
 
-   if (hunkmem != NULL)
-      free(hunkmem);
+   for (unsigned i = 0; i < CHD_HUNK_CACHE_SIZE; i++)
+   {
+      if (hunks[i].data != NULL)
+         free(hunks[i].data);
+   }
+
+#if HAVE_THREADS
+   scond_free(hunk_cond);
+   slock_free(chd_lock);
+   slock_free(hunk_lock);
+#endif
 }
 
 CDAccess_CHD::CDAccess_CHD(const char *path, bool image_memcache)
 {
    chd = NULL;
 
+   for (unsigned i = 0; i < CHD_HUNK_CACHE_SIZE; i++)
+   {
+      hunks[i].data    = NULL;
+      hunks[i].hunknum = -1;
+      hunks[i].pending = false;
+      hunks[i].used    = 0;
+   }
+   hunk_clock    = 0;
+   hunk_count    = 0;
+   last_hunk     = -1;
+   prefetch_hunk = -1;
+
+#if HAVE_THREADS
+   hunk_lock       = slock_new();
+   chd_lock        = slock_new();
+   hunk_cond       = scond_new();
+   prefetch_thread = NULL;
+   prefetch_quit   = false;
+   preloading      = false;
+#endif
+
    NumTracks = 0;
    total_sectors = 0;
    memset(Tracks, 0, sizeof(Tracks));
@@ -231,113 +289,6 @@ CDAccess_CHD::~CDAccess_CHD()
    Cleanup();
 }
 
-// Note: this function makes use of the current contents(as in |=) in SubPWBuf.
-int32_t CDAccess_CHD::MakeSubPQ(int32 lba, uint8 *SubPWBuf)
-{
-   unsigned i;
-   uint8_t buf[0xC], adr, control;
-   int32_t track;
-   uint32_t lba_relative;
-   uint32_t ma, sa, fa;
-   uint32_t m, s, f;
-   uint8_t pause_or = 0x00;
-   bool track_found = false;
-
-   for(track = FirstTrack; track < (FirstTrack + NumTracks); track++)
-   {
-      if(lba >= (Tracks[track].LBA - Tracks[track].pregap_dv - Tracks[track].pregap) && lba < (Tracks[track].LBA + Tracks[track].sectors + Tracks[track].postgap))
-      {
-         track_found = true;
-         break;
-      }
-   }
-
-   //printf("%d %d\n", Tracks[1].LBA, Tracks[1].sectors);
-
-   if(!track_found)
-   {
-      printf("MakeSubPQ error for sector %u!", lba);
-      track = FirstTrack;
-   }
-
-   lba_relative = abs((int32)lba - Tracks[track].LBA);
-
-   f            = (lba_relative % 75);
-   s            = ((lba_relative / 75) % 60);
-   m            = (lba_relative / 75 / 60);
-
-   fa           = (lba + 150) % 75;
-   sa           = ((lba + 150) / 75) % 60;
-   ma           = ((lba + 150) / 75 / 60);
-
-   adr          = 0x1; // Q channel data encodes position
-   control      = Tracks[track].subq_control;
-
-   // Handle pause(D7 of interleaved subchannel byte) bit, should be set to 1 when in pregap or postgap.
-   if((lba < Tracks[track].LBA) || (lba >= Tracks[track].LBA + Tracks[track].sectors))
-   {
-      //printf("pause_or = 0x80 --- %d\n", lba);
-      pause_or = 0x80;
-   }
-
-   // Handle pregap between audio->data track
-   {
-      int32_t pg_offset = (int32)lba - Tracks[track].LBA;
-
-      // If we're more than 2 seconds(150 sectors) from the real "start" of the track/INDEX 01, and the track is a data track,
-      // and the preceding track is an audio track, encode it as audio(by taking the SubQ control field from the preceding track).
-      //
-      // TODO: Look into how we're supposed to handle subq control field in the four combinations of track types(data/audio).
-      //
-      if(pg_offset < -150)
-      {
-         if((Tracks[track].subq_control & SUBQ_CTRLF_DATA) && (FirstTrack < track) && !(Tracks[track - 1].subq_control & SUBQ_CTRLF_DATA))
-         {
-            //printf("Pregap part 1 audio->data: lba=%d track_lba=%d\n", lba, Tracks[track].LBA);
-            control = Tracks[track - 1].subq_control;
-         }
-      }
-   }
-
-   memset(buf, 0, 0xC);
-   buf[0] = (adr << 0) | (control << 4);
-   buf[1] = U8_to_BCD(track);
-
-   if(lba < Tracks[track].LBA) // Index is 00 in pregap
-      buf[2] = U8_to_BCD(0x00);
-   else
-      buf[2] = U8_to_BCD(0x01);
-
-   /* Track relative MSF address */
-   buf[3] = U8_to_BCD(m);
-   buf[4] = U8_to_BCD(s);
-   buf[5] = U8_to_BCD(f);
-   buf[6] = 0;
-   /* Absolute MSF address */
-   buf[7] = U8_to_BCD(ma);
-   buf[8] = U8_to_BCD(sa);
-   buf[9] = U8_to_BCD(fa);
-
-   subq_generate_checksum(buf);
-
-   if(!SubQReplaceMap.empty())
-   {
-      //printf("%d\n", lba);
-      std::map<uint32, cpp11_array_doodad>::const_iterator it = SubQReplaceMap.find(LBA_to_ABA(lba));
-
-      if(it != SubQReplaceMap.end())
-      {
-         //printf("Replace: %d\n", lba);
-         memcpy(buf, it->second.data, 12);
-      }
-   }
-
-   for (i = 0; i < 96; i++)
-      SubPWBuf[i] |= (((buf[i >> 3] >> (7 - (i & 0x7))) & 1) ? 0x40 : 0x00) | pause_or;
-
-   return track;
-}
-
 bool CDAccess_CHD::Read_Raw_Sector(uint8 *buf, int32 lba)
 {
    uint8_t SimuQ[0xC];
@@ -372,7 +323,7 @@ bool CDAccess_CHD::Read_Raw_Sector(uint8 *buf, int32 lba)
    }
 
    memset(buf + 2352, 0, 96);
-   track = MakeSubPQ(lba, buf + 2352);
+   track = SubQ_Make(lba, buf + 2352);
    subq_deinterleave(buf + 2352, SimuQ);
 
    ct = &Tracks[track];
@@ -423,30 +374,214 @@ bool CDAccess_CHD::Read_Raw_Sector(uint8 *buf, int32 lba)
       int sph = head->hunkbytes / (2352 + 96);
       int hunknum = cad / sph; //(cad * head->unitbytes) / head->hunkbytes;
       int hunkofs = cad % sph; //(cad * head->unitbytes) % head->hunkbytes;
-      int err = CHDERR_NONE;
 
-      /* each hunk holds ~8 sectors, optimize when reading contiguous sectors */
-      if (hunknum != oldhunk)
+      /* each hunk holds ~8 sectors, see ReadHunkSector() */
+      if (!ReadHunkSector(buf, hunknum, hunkofs))
       {
-         err = chd_read(chd, hunknum, hunkmem);
-         if (err != CHDERR_NONE)
-            log_cb(RETRO_LOG_ERROR, "chd_read_sector failed lba=%d error=%d\n", lba, err);
-         else
-            oldhunk = hunknum;
+         log_cb(RETRO_LOG_ERROR, "chd_read_sector failed lba=%d\n", lba);
+         memset(buf, 0, 2352);
       }
 
-      memcpy(buf, hunkmem + hunkofs * (2352 + 96), 2352);
-
       if (ct->DIFormat == DI_FORMAT_AUDIO && ct->RawAudioMSBFirst)
          Endian_A16_Swap(buf, 588 * 2);
    }
    return true;
 }
 
+CDAccess_CHD::hunk_slot *CDAccess_CHD::FindHunk(int hunknum)
+{
+   for (unsigned i = 0; i < CHD_HUNK_CACHE_SIZE; i++)
+   {
+      if (hunks[i].hunknum == hunknum)
+         return &hunks[i];
+   }
+
+   return NULL;
+}
+
+/* Picks the slot to decompress a hunk into: an empty one, or else the least
+ * recently used one that isn't pending. */
+CDAccess_CHD::hunk_slot *CDAccess_CHD::EvictHunk(void)
+{
+   hunk_slot *victim = NULL;
+
+   for (unsigned i = 0; i < CHD_HUNK_CACHE_SIZE; i++)
+   {
+      hunk_slot *slot = &hunks[i];
+
+      if (slot->pending)
+         continue;
+
+      if (slot->hunknum < 0)
+         return slot;
+
+      if (victim == NULL || (int32_t)(slot->used - victim->used) < 0)
+         victim = slot;
+   }
+
+   return victim;
+}
+
+/* Decompresses hunknum into slot.  Called with hunk_lock held, which is let go
+ * of meanwhile; the slot is marked pending so that it's left alone until
+ * then. */
+bool CDAccess_CHD::DecompressHunk(hunk_slot *slot, int hunknum)
+{
+   chd_error err;
+
+   slot->hunknum = hunknum;
+   slot->pending = true;
+   slot->used    = hunk_clock;
+
+#if HAVE_THREADS
+   slock_unlock(hunk_lock);
+   slock_lock(chd_lock);
+#endif
+
+   err = chd_read(chd, hunknum, slot->data);
+
+#if HAVE_THREADS
+   slock_unlock(chd_lock);
+   slock_lock(hunk_lock);
+#endif
+
+   slot->pending = false;
+
+   if (err != CHDERR_NONE)
+   {
+      log_cb(RETRO_LOG_ERROR, "chd_read failed hunk=%d error=%d\n", hunknum, err);
+      slot->hunknum = -1;
+   }
+
+#if HAVE_THREADS
+   scond_broadcast(hunk_cond);
+#endif
+
+   return err == CHDERR_NONE;
+}
+
+/* Copies a sector out of the hunk cache, decompressing the hunk if it isn't
+ * there, and moves the prefetch window along. */
+bool CDAccess_CHD::ReadHunkSector(uint8_t *buf, int hunknum, int hunkofs)
+{
+   hunk_slot *slot;
+
+#if HAVE_THREADS
+   slock_lock(hunk_lock);
+#endif
+
+   for (;;)
+   {
+      slot = FindHunk(hunknum);
+
+      if (slot == NULL)
+      {
+         slot = EvictHunk();
+
+         if (!DecompressHunk(slot, hunknum))
+         {
+#if HAVE_THREADS
+            slock_unlock(hunk_lock);
+#endif
+            return false;
+         }
+      }
+#if HAVE_THREADS
+      else if (slot->pending)
+      {
+         /* the prefetch thread is on it */
+         scond_wait(hunk_cond, hunk_lock);
+         continue;
+      }
+#endif
+
+      break;
+   }
+
+   slot->used = ++hunk_clock;
+   memcpy(buf, slot->data + hunkofs * (2352 + 96), 2352);
+
+   /* only prefetch while the reads move on to the following hunk, seeks
+    * (random access, interleaved files) would just waste the work */
+   if (hunknum != last_hunk)
+   {
+      prefetch_hunk = (hunknum == last_hunk + 1) ? hunknum + 1 : -1;
+      last_hunk     = hunknum;
+#if HAVE_THREADS
+      if (prefetch_hunk >= 0)
+         scond_broadcast(hunk_cond);
+#endif
+   }
+
+#if HAVE_THREADS
+   slock_unlock(hunk_lock);
+#endif
+
+   return true;
+}
+
+#if HAVE_THREADS
+/* Decompresses the CHD_HUNK_PREFETCH hunks following the last one read while
+ * reading sequentially, so that the reads find them ready.  Otherwise, while
+ * preloading, reads the file into memory a piece at a time, starting from
+ * around the last hunk read and working outward; that's the start of the
+ * first track, where the boot files are, until the first read. */
+void CDAccess_CHD::PrefetchThread_Main(void *arg)
+{
+   CDAccess_CHD *cda = (CDAccess_CHD*)arg;
+
+   slock_lock(cda->hunk_lock);
+
+   while (!cda->prefetch_quit)
+   {
+      int hunknum = -1;
+
+      for (int h = cda->prefetch_hunk; h >= 0 && h < cda->prefetch_hunk + CHD_HUNK_PREFETCH && h < cda->hunk_count; h++)
+      {
+         if (cda->FindHunk(h) == NULL)
+         {
+            hunknum = h;
+            break;
+         }
+      }
+
+      if (hunknum < 0 && cda->preloading)
+      {
+         int last = cda->last_hunk;
+         int done = 1;
+         chd_error err;
+
+         slock_unlock(cda->hunk_lock);
+         slock_lock(cda->chd_lock);
+         err = chd_precache_step(cda->chd, chd_hunk_offset(cda->chd, last < 0 ? 0 : last), &done);
+         slock_unlock(cda->chd_lock);
+         slock_lock(cda->hunk_lock);
+
+         /* on a read error, leave the rest to be read from the file */
+         if (err != CHDERR_NONE || done)
+            cda->preloading = false;
+         continue;
+      }
+
+      if (hunknum < 0)
+      {
+         scond_wait(cda->hunk_cond, cda->hunk_lock);
+         continue;
+      }
+
+      /* don't keep retrying a bad hunk, the next read will */
+      if (!cda->DecompressHunk(cda->EvictHunk(), hunknum))
+         cda->prefetch_hunk = -1;
+   }
+
+   slock_unlock(cda->hunk_lock);
+}
+#endif
+
 bool CDAccess_CHD::Read_Raw_PW(uint8_t *buf, int32_t lba)
 {
    memset(buf, 0, 96);
-   MakeSubPQ(lba, buf);
+   SubQ_Make(lba, buf);
    return true;
 }
 
@@ -481,6 +616,8 @@ bool CDAccess_CHD::Read_TOC(TOC *toc)
    if (filestream_exists(sbi_path.c_str()))
       LoadSBI(sbi_path.c_str());
 
+   SubQ_Build(Tracks, FirstTrack, NumTracks);
+
    ptoc = toc;
    log_cb(RETRO_LOG_INFO, "chd_read_toc: finished\n");
    return true;
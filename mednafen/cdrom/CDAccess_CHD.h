@@ -6,6 +6,15 @@
 
 #include "chd.h"
 
+#if HAVE_THREADS
+#include <rthreads/rthreads.h>
+#endif
+
+/* Decompressed hunks kept around, and how far past the hunk being read the
+ * prefetch thread decompresses. */
+#define CHD_HUNK_CACHE_SIZE   16
+#define CHD_HUNK_PREFETCH     4
+
 class CDAccess_CHD : public CDAccess
 {
    public:
@@ -23,10 +32,42 @@ class CDAccess_CHD : public CDAccess
 
    private:
       chd_file *chd;
-      /* hunk data cache */
-      uint8_t *hunkmem;
-      /* last hunknum read */
-      int oldhunk;
+
+      /* hunk data cache, least recently used first out */
+      struct hunk_slot
+      {
+         uint8_t *data;
+         int hunknum;      /* -1 if empty */
+         bool pending;     /* being decompressed, data not ready yet */
+         uint32_t used;    /* hunk_clock at the last read */
+      };
+      hunk_slot hunks[CHD_HUNK_CACHE_SIZE];
+      uint32_t hunk_clock;
+      int hunk_count;
+      int last_hunk;
+      /* start of the prefetch window, -1 unless reading sequentially */
+      int prefetch_hunk;
+
+#if HAVE_THREADS
+      /* the hunk cache and chd_read() are each guarded by
+       * their own lock, so that cached sectors can be copied out while a
+       * hunk is being decompressed */
+      slock_t *hunk_lock;
+      slock_t *chd_lock;
+      scond_t *hunk_cond;
+      sthread_t *prefetch_thread;
+      bool prefetch_quit;
+      /* image_memcache: the prefetch thread reads the file into memory
+       * whenever it has nothing else to do, see PrefetchThread_Main() */
+      bool preloading;
+
+      static void PrefetchThread_Main(void *arg);
+#endif
+
+      hunk_slot *FindHunk(int hunknum);
+      hunk_slot *EvictHunk(void);
+      bool DecompressHunk(hunk_slot *slot, int hunknum);
+      bool ReadHunkSector(uint8_t *buf, int hunknum, int hunkofs);
 
       int32_t NumTracks;
       int32_t FirstTrack;
@@ -41,12 +82,6 @@ class CDAccess_CHD : public CDAccess
       void Cleanup(void);
 
       CDRFILE_TRACK_INFO Tracks[100]; // Track #0(HMM?) through 99
-      struct cpp11_array_doodad
-      {
-         uint8 data[12];
-      };
-      std::map<uint32, cpp11_array_doodad> SubQReplaceMap;
-      int32_t MakeSubPQ(int32 lba, uint8 *SubPWBuf);
 };
 
 
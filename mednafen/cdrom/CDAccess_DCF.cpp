@@ -0,0 +1,437 @@
+/* Mednafen - Multi-system Emulator
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "../mednafen.h"
+#include "../error.h"
+#include "../FileStream.h"
+#include "../PreloadStream.h"
+#include "../MmapStream.h"
+#include "../mednafen-endian.h"
+#include "CDAccess_DCF.h"
+#include "CDUtility.h"
+
+#include <zlib.h>
+
+static const uint8_t dcf_magic[8] = { 'M', 'D', 'F', 'N', 'D', 'C', 'F', 0 };
+
+enum
+{
+   DCF_HEADER_SIZE      = 8 + 4 * 4,
+   DCF_TOC_SIZE         = 4 + 101 * 8,
+   DCF_SECTOR_INFO_SIZE = 1 + 12,
+   DCF_GROUP_INDEX_SIZE = 8 + 4,
+   DCF_GROUP_SIZE       = DCF_GROUP_SECTORS * 2352
+};
+
+CDAccess_DCF::CDAccess_DCF(bool *success, const char *path, bool image_memcache) : fp(NULL), sector_count(0), group_count(0),
+   sector_info(NULL), group_offsets(NULL), group_sizes(NULL), group_data(NULL), group_packed(NULL), cur_group(~0U)
+{
+   TOC_Clear(&tocd);
+   if (!Load(path, image_memcache))
+   {
+      Cleanup();
+      *success = false;
+   }
+}
+
+CDAccess_DCF::~CDAccess_DCF()
+{
+   Cleanup();
+}
+
+bool CDAccess_DCF::Load(const char *path, bool image_memcache)
+{
+   uint8_t header[DCF_HEADER_SIZE];
+   uint8_t toc_raw[DCF_TOC_SIZE];
+   uint8_t *index_raw;
+   uint32_t version, group_sectors;
+   uint64_t file_size;
+   MmapStream *ms;
+
+   if(image_memcache)
+      fp = new PreloadStream(new FileStream(path, MODE_READ));
+   else
+   {
+      ms = new MmapStream(path);
+
+      if(ms->map())
+         fp = ms;
+      else
+      {
+         delete ms;
+         fp = new FileStream(path, MODE_READ);
+      }
+   }
+
+   file_size = fp->size();
+
+   if(fp->read(header, sizeof(header), false) != sizeof(header) || memcmp(header, dcf_magic, sizeof(dcf_magic)))
+   {
+      MDFN_Error(0, _("Not a disc cache file: %s"), path);
+      return false;
+   }
+
+   version       = MDFN_de32lsb<false>(&header[8]);
+   sector_count  = MDFN_de32lsb<false>(&header[12]);
+   group_sectors = MDFN_de32lsb<false>(&header[16]);
+   group_count   = MDFN_de32lsb<false>(&header[20]);
+
+   if(version != DCF_VERSION)
+   {
+      MDFN_Error(0, _("Unsupported disc cache file version: %u"), version);
+      return false;
+   }
+
+   if(group_sectors != DCF_GROUP_SECTORS || group_count != (sector_count + DCF_GROUP_SECTORS - 1) / DCF_GROUP_SECTORS ||
+         (uint64_t)sector_count * DCF_SECTOR_INFO_SIZE + (uint64_t)group_count * DCF_GROUP_INDEX_SIZE > file_size)
+   {
+      MDFN_Error(0, _("Disc cache file header is corrupt."));
+      return false;
+   }
+
+   if(fp->read(toc_raw, sizeof(toc_raw), false) != sizeof(toc_raw))
+   {
+      MDFN_Error(0, _("Disc cache file is truncated."));
+      return false;
+   }
+
+   tocd.first_track = toc_raw[0];
+   tocd.last_track  = toc_raw[1];
+   tocd.disc_type   = toc_raw[2];
+
+   for(unsigned i = 0; i < 101; i++)
+   {
+      const uint8_t *te = &toc_raw[4 + i * 8];
+
+      tocd.tracks[i].adr     = te[0];
+      tocd.tracks[i].control = te[1];
+      tocd.tracks[i].valid   = te[2] != 0;
+      tocd.tracks[i].lba     = MDFN_de32lsb<false>(&te[4]);
+   }
+
+   if(tocd.first_track < 1 || tocd.last_track > 99 || tocd.first_track > tocd.last_track || tocd.tracks[100].lba != sector_count)
+   {
+      MDFN_Error(0, _("Disc cache file TOC is corrupt."));
+      return false;
+   }
+
+   sector_info   = new uint8_t[(size_t)sector_count * DCF_SECTOR_INFO_SIZE];
+   group_offsets = new uint64_t[group_count];
+   group_sizes   = new uint32_t[group_count];
+   index_raw     = new uint8_t[(size_t)group_count * DCF_GROUP_INDEX_SIZE];
+
+   if(fp->read(sector_info, (uint64_t)sector_count * DCF_SECTOR_INFO_SIZE, false) != (uint64_t)sector_count * DCF_SECTOR_INFO_SIZE ||
+         fp->read(index_raw, (uint64_t)group_count * DCF_GROUP_INDEX_SIZE, false) != (uint64_t)group_count * DCF_GROUP_INDEX_SIZE)
+   {
+      delete[] index_raw;
+      MDFN_Error(0, _("Disc cache file is truncated."));
+      return false;
+   }
+
+   for(uint32_t g = 0; g < group_count; g++)
+   {
+      group_offsets[g] = MDFN_de64lsb<false>(&index_raw[g * DCF_GROUP_INDEX_SIZE + 0]);
+      group_sizes[g]   = MDFN_de32lsb<false>(&index_raw[g * DCF_GROUP_INDEX_SIZE + 8]);
+
+      if(group_sizes[g] > DCF_GROUP_SIZE || group_offsets[g] > file_size || group_sizes[g] > file_size - group_offsets[g])
+      {
+         delete[] index_raw;
+         MDFN_Error(0, _("Disc cache file group index is corrupt."));
+         return false;
+      }
+   }
+
+   delete[] index_raw;
+
+   group_data   = new uint8_t[DCF_GROUP_SIZE];
+   group_packed = new uint8_t[DCF_GROUP_SIZE];
+
+   return true;
+}
+
+void CDAccess_DCF::Cleanup(void)
+{
+   if(fp)
+   {
+      fp->close();
+      delete fp;
+      fp = NULL;
+   }
+
+   delete[] sector_info;
+   delete[] group_offsets;
+   delete[] group_sizes;
+   delete[] group_data;
+   delete[] group_packed;
+
+   sector_info   = NULL;
+   group_offsets = NULL;
+   group_sizes   = NULL;
+   group_data    = NULL;
+   group_packed  = NULL;
+   cur_group     = ~0U;
+}
+
+bool CDAccess_DCF::LoadGroup(uint32_t group)
+{
+   z_stream zs;
+   int zr;
+
+   if(group == cur_group)
+      return true;
+
+   cur_group = ~0U;
+
+   fp->seek(group_offsets[group], SEEK_SET);
+
+   if(group_sizes[group] == DCF_GROUP_SIZE)
+   {
+      if(fp->read(group_data, DCF_GROUP_SIZE, false) != DCF_GROUP_SIZE)
+      {
+         MDFN_Error(0, _("Disc cache file read error."));
+         return false;
+      }
+
+      cur_group = group;
+      return true;
+   }
+
+   if(fp->read(group_packed, group_sizes[group], false) != group_sizes[group])
+   {
+      MDFN_Error(0, _("Disc cache file read error."));
+      return false;
+   }
+
+   memset(&zs, 0, sizeof(zs));
+
+   if(inflateInit2(&zs, -15) != Z_OK)
+   {
+      MDFN_Error(0, _("Disc cache file decompression error."));
+      return false;
+   }
+
+   zs.next_in   = group_packed;
+   zs.avail_in  = group_sizes[group];
+   zs.next_out  = group_data;
+   zs.avail_out = DCF_GROUP_SIZE;
+
+   zr = inflate(&zs, Z_FINISH);
+   inflateEnd(&zs);
+
+   if(zr != Z_STREAM_END || zs.avail_out)
+   {
+      MDFN_Error(0, _("Disc cache file decompression error."));
+      return false;
+   }
+
+   cur_group = group;
+   return true;
+}
+
+// Regenerates the interleaved P-W bytes from subchannel Q and the P flag; R-W are always 0.
+void CDAccess_DCF::MakePW(int32_t lba, uint8_t *pwbuf)
+{
+   const uint8_t *si = &sector_info[(size_t)lba * DCF_SECTOR_INFO_SIZE];
+   const uint8_t *subq = si + 1;
+   const uint8_t p = (si[0] & DCF_SECTOR_SUBP) ? 0x80 : 0x00;
+
+   for(unsigned i = 0; i < 96; i++)
+      pwbuf[i] = p | (((subq[i >> 3] >> (7 - (i & 7))) & 1) << 6);
+}
+
+bool CDAccess_DCF::Read_Raw_Sector(uint8_t *buf, int32_t lba)
+{
+   if(lba < 0 || (uint32_t)lba >= sector_count)
+   {
+      MDFN_Error(0, _("LBA out of range."));
+      return false;
+   }
+
+   if(!LoadGroup(lba / DCF_GROUP_SECTORS))
+      return false;
+
+   memcpy(buf, &group_data[(lba % DCF_GROUP_SECTORS) * 2352], 2352);
+   MakePW(lba, buf + 2352);
+
+   return true;
+}
+
+bool CDAccess_DCF::Read_Raw_PW(uint8_t *buf, int32_t lba)
+{
+   if(lba < 0 || (uint32_t)lba >= sector_count)
+   {
+      MDFN_Error(0, _("LBA out of range."));
+      return false;
+   }
+
+   MakePW(lba, buf);
+
+   return true;
+}
+
+bool CDAccess_DCF::Read_TOC(TOC *toc)
+{
+   *toc = tocd;
+   return true;
+}
+
+void CDAccess_DCF::Eject(bool eject_status)
+{
+
+}
+
+// Going by the Q control field rather than the TOC, so that e.g. the pregap of an audio track after a data track
+// comes out as audio.
+static uint8_t DCF_SectorType(const uint8_t *buf, const uint8_t *subq)
+{
+   if(!(subq[0] & (SUBQ_CTRLF_DATA << 4)))
+      return DCF_SECTOR_CDDA;
+
+   switch(buf[12 + 3])
+   {
+      case 0x01:
+         return DCF_SECTOR_MODE1;
+
+      case 0x02:
+         return (buf[12 + 6] & 0x20) ? DCF_SECTOR_MODE2_FORM2 : DCF_SECTOR_MODE2_FORM1;
+   }
+
+   return DCF_SECTOR_ZERO;
+}
+
+bool DCF_Convert(CDAccess *src, const TOC *toc, const char *path)
+{
+   const uint32_t sector_count = toc->tracks[100].lba;
+   const uint32_t group_count  = (sector_count + DCF_GROUP_SECTORS - 1) / DCF_GROUP_SECTORS;
+   const uint64_t data_start   = DCF_HEADER_SIZE + DCF_TOC_SIZE + (uint64_t)sector_count * DCF_SECTOR_INFO_SIZE +
+      (uint64_t)group_count * DCF_GROUP_INDEX_SIZE;
+   uint8_t header[DCF_HEADER_SIZE];
+   uint8_t toc_raw[DCF_TOC_SIZE];
+   uint8_t *sector_info = new uint8_t[(size_t)sector_count * DCF_SECTOR_INFO_SIZE];
+   uint8_t *index_raw   = new uint8_t[(size_t)group_count * DCF_GROUP_INDEX_SIZE];
+   uint8_t *group_data  = new uint8_t[DCF_GROUP_SIZE];
+   uint8_t *packed      = new uint8_t[DCF_GROUP_SIZE];
+   uint64_t offset      = data_start;
+   bool ret             = false;
+   z_stream zs;
+   FileStream out(path, MODE_WRITE);
+   const bool opened    = (out.tell() != (uint64_t)-1);
+
+   memset(&zs, 0, sizeof(zs));
+
+   if(!opened || deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+      goto done;
+
+   memcpy(header, dcf_magic, sizeof(dcf_magic));
+   MDFN_en32lsb<false>(&header[8], DCF_VERSION);
+   MDFN_en32lsb<false>(&header[12], sector_count);
+   MDFN_en32lsb<false>(&header[16], DCF_GROUP_SECTORS);
+   MDFN_en32lsb<false>(&header[20], group_count);
+
+   memset(toc_raw, 0, sizeof(toc_raw));
+   toc_raw[0] = toc->first_track;
+   toc_raw[1] = toc->last_track;
+   toc_raw[2] = toc->disc_type;
+
+   for(unsigned i = 0; i < 101; i++)
+   {
+      uint8_t *te = &toc_raw[4 + i * 8];
+
+      te[0] = toc->tracks[i].adr;
+      te[1] = toc->tracks[i].control;
+      te[2] = toc->tracks[i].valid;
+      MDFN_en32lsb<false>(&te[4], toc->tracks[i].lba);
+   }
+
+   // The sector table and group index are written once all of the groups have been, so skip over them for now.
+   out.write(header, sizeof(header));
+   out.write(toc_raw, sizeof(toc_raw));
+   out.seek(data_start, SEEK_SET);
+
+   for(uint32_t g = 0; g < group_count; g++)
+   {
+      uint32_t size;
+
+      memset(group_data, 0, DCF_GROUP_SIZE);
+
+      for(uint32_t s = 0; s < DCF_GROUP_SECTORS && g * DCF_GROUP_SECTORS + s < sector_count; s++)
+      {
+         const int32_t lba = g * DCF_GROUP_SECTORS + s;
+         uint8_t buf[2352 + 96];
+         uint8_t *si = &sector_info[(size_t)lba * DCF_SECTOR_INFO_SIZE];
+
+         if(!src->Read_Raw_Sector(buf, lba))
+         {
+            MDFN_Error(0, _("Error reading sector %d while writing disc cache file: %s"), lba, path);
+            goto done;
+         }
+
+         memcpy(&group_data[s * 2352], buf, 2352);
+
+         subq_deinterleave(buf + 2352, si + 1);
+         si[0] = DCF_SectorType(buf, si + 1);
+         if(buf[2352] & 0x80)
+            si[0] |= DCF_SECTOR_SUBP;
+      }
+
+      deflateReset(&zs);
+      zs.next_in   = group_data;
+      zs.avail_in  = DCF_GROUP_SIZE;
+      zs.next_out  = packed;
+      zs.avail_out = DCF_GROUP_SIZE;
+
+      // Groups that don't get any smaller(e.g. noisy CD-DA) are stored as they are, and read without inflating.
+      if(deflate(&zs, Z_FINISH) == Z_STREAM_END && zs.avail_out)
+      {
+         size = DCF_GROUP_SIZE - zs.avail_out;
+         out.write(packed, size);
+      }
+      else
+      {
+         size = DCF_GROUP_SIZE;
+         out.write(group_data, size);
+      }
+
+      MDFN_en64lsb<false>(&index_raw[g * DCF_GROUP_INDEX_SIZE + 0], offset);
+      MDFN_en32lsb<false>(&index_raw[g * DCF_GROUP_INDEX_SIZE + 8], size);
+      offset += size;
+   }
+
+   out.seek(DCF_HEADER_SIZE + DCF_TOC_SIZE, SEEK_SET);
+   out.write(sector_info, (uint64_t)sector_count * DCF_SECTOR_INFO_SIZE);
+   out.write(index_raw, (uint64_t)group_count * DCF_GROUP_INDEX_SIZE);
+
+   ret = (out.tell() == data_start);
+
+   if(!ret)
+      MDFN_Error(0, _("Error writing disc cache file: %s"), path);
+
+done:
+   deflateEnd(&zs);
+   out.close();
+
+   // Don't leave a partial file around to be mistaken for a good one.
+   if(!ret && opened)
+      remove(path);
+
+   delete[] sector_info;
+   delete[] index_raw;
+   delete[] group_data;
+   delete[] packed;
+
+   return ret;
+}
@@ -0,0 +1,98 @@
+/* Mednafen - Multi-system Emulator
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _CDROM_CDACCESS_DCF_H_
+#define _CDROM_CDACCESS_DCF_H_
+
+#include "../Stream.h"
+#include "CDAccess.h"
+
+//
+// Disc cache file(.dcf): any disc image we can open, converted ahead of time by DCF_Convert() into a single file
+// that needs no parsing, decompression of anything but the sectors read, ECC/EDC regeneration or subchannel
+// synthesis when it's used.
+//
+// Layout, all integers little-endian:
+//
+//  Header:    "MDFNDCF\0", u32 version(DCF_VERSION), u32 sector_count, u32 group_sectors, u32 group_count
+//  TOC:       u8 first_track, u8 last_track, u8 disc_type, u8 0,
+//             then for tracks 0 through 100: u8 adr, u8 control, u8 valid, u8 0, u32 lba
+//  Sectors:   for each of the sector_count sectors from LBA 0 on: u8 flags(DCF_SECTOR_*), u8 subq[12](deinterleaved)
+//  Groups:    for each group of group_sectors sectors: u64 offset, u32 size
+//  Group data: the raw 2352-byte sectors of each group, deflated(raw, no zlib header), or stored as they are when
+//             size is group_sectors * 2352.  The last group is padded out with zeroed sectors.
+//
+// All but the group data is read in when the file is opened, so looking a sector up is an index, and reading
+// subchannel data alone never touches the group data.
+//
+#define DCF_VERSION        1
+#define DCF_GROUP_SECTORS  16
+
+enum
+{
+   DCF_SECTOR_ZERO        = 0x00,   // Mode 0, or anything else we don't know about
+   DCF_SECTOR_CDDA        = 0x01,
+   DCF_SECTOR_MODE1       = 0x02,
+   DCF_SECTOR_MODE2_FORM1 = 0x03,
+   DCF_SECTOR_MODE2_FORM2 = 0x04,
+   DCF_SECTOR_TYPE_MASK   = 0x07,
+
+   DCF_SECTOR_SUBP        = 0x80    // Subchannel P(pause) bits are set
+};
+
+class CDAccess_DCF : public CDAccess
+{
+ public:
+
+ CDAccess_DCF(bool *success, const char *path, bool image_memcache);
+ virtual ~CDAccess_DCF();
+
+ virtual bool Read_Raw_Sector(uint8_t *buf, int32_t lba);
+
+ virtual bool Read_Raw_PW(uint8_t *buf, int32_t lba);
+
+ virtual bool Read_TOC(TOC *toc);
+
+ virtual void Eject(bool eject_status);
+
+ private:
+
+ bool Load(const char *path, bool image_memcache);
+ void Cleanup(void);
+
+ bool LoadGroup(uint32_t group);
+ void MakePW(int32_t lba, uint8_t *pwbuf);
+
+ Stream* fp;
+ TOC tocd;
+
+ uint32_t sector_count;
+ uint32_t group_count;
+ uint8_t *sector_info;      // 13 bytes a sector, as in the file
+ uint64_t *group_offsets;
+ uint32_t *group_sizes;
+
+ // The last group read, decompressed.
+ uint8_t *group_data;
+ uint8_t *group_packed;
+ uint32_t cur_group;
+};
+
+// Writes the disc "src", with the TOC "toc", out to the disc cache file "path".  Returns false on error.
+bool DCF_Convert(CDAccess *src, const TOC *toc, const char *path);
+
+#endif
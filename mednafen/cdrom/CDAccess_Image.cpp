@@ -45,6 +45,8 @@
 #include "../general.h"
 #include "../FileStream.h"
 #include "../MemoryStream.h"
+#include "../MmapStream.h"
+#include "../PreloadStream.h"
 
 #include "CDAccess.h"
 #include "CDAccess_Image.h"
@@ -216,6 +218,26 @@ uint32 CDAccess_Image::GetSectorCount(CDRFILE_TRACK_INFO *track)
    return((size - track->FileOffset) / DI_Size_Table[track->DIFormat]);
 }
 
+// With image_memcache, copies the image file onto the heap(in the background), so that nothing is read from the disc
+// once it's in.  Otherwise maps local image files in, so that reading a sector is a copy out of the page cache; files on
+// network shares or only reachable through the frontend's VFS go through FileStream, see MmapStream.h.
+static Stream *OpenImageFile(const char *path, bool image_memcache)
+{
+   MmapStream *ms;
+
+   if(image_memcache)
+      return new PreloadStream(new FileStream(path, MODE_READ));
+
+   ms = new MmapStream(path);
+
+   if(ms->map())
+      return ms;
+
+   delete ms;
+
+   return new FileStream(path, MODE_READ);
+}
+
 bool CDAccess_Image::ParseTOCFileLineInfo(CDRFILE_TRACK_INFO *track, const int tracknum,
       const std::string &filename, const char *binoffset, const char *msfoffset,
       const char *length, bool image_memcache, std::map<std::string, Stream*> &toc_streamcache)
@@ -243,10 +265,7 @@ bool CDAccess_Image::ParseTOCFileLineInfo(CDRFILE_TRACK_INFO *track, const int t
 
       efn = MDFN_EvalFIP(base_dir, filename);
 
-      if(image_memcache)
-         track->fp = new MemoryStream(new FileStream(efn.c_str(), MODE_READ));
-      else
-         track->fp = new FileStream(efn.c_str(), MODE_READ);
+      track->fp = OpenImageFile(efn.c_str(), image_memcache);
 
       toc_streamcache[filename] = track->fp;
    }
@@ -642,15 +661,12 @@ bool CDAccess_Image::ImageOpen(const char *path, bool image_memcache)
             else
                efn = args[0];
 
-            TmpTrack.fp = new FileStream(efn.c_str(), MODE_READ);
+            TmpTrack.fp = OpenImageFile(efn.c_str(), image_memcache);
             TmpTrack.FirstFileInstance = 1;
 
             if (TmpTrack.fp->tell() == (uint64_t)-1)
                return false;
 
-            if(image_memcache)
-               TmpTrack.fp = new MemoryStream(TmpTrack.fp);
-
             if(!strcasecmp(args[1].c_str(), "BINARY"))
             {
                //TmpTrack.Format = TRACK_FORMAT_DATA;
@@ -929,6 +945,8 @@ bool CDAccess_Image::ImageOpen(const char *path, bool image_memcache)
          LoadSBI(sbi_path.c_str());
    }
 
+   SubQ_Build(Tracks, FirstTrack, NumTracks);
+
    return true;
 }
 
@@ -979,7 +997,7 @@ bool CDAccess_Image::Read_Raw_Sector(uint8 *buf, int32 lba)
 
    memset(buf + 2352, 0, 96);
 
-   MakeSubPQ(lba, buf + 2352);
+   SubQ_Make(lba, buf + 2352);
 
    subq_deinterleave(buf + 2352, SimuQ);
 
@@ -1092,7 +1110,7 @@ bool CDAccess_Image::Read_Raw_Sector(uint8 *buf, int32 lba)
       memcpy(dummy_buf + 16, buf + 16, 2048); 
       memset(dummy_buf + 2352, 0, 96);
 
-      MakeSubPQ(lba, dummy_buf + 2352);
+      SubQ_Make(lba, dummy_buf + 2352);
       encode_mode1_sector(lba + 150, dummy_buf);
 
       for(int i = 0; i < 2352 + 96; i++)
@@ -1114,116 +1132,10 @@ bool CDAccess_Image::Read_Raw_Sector(uint8 *buf, int32 lba)
    return true;
 }
 
-// Note: this function makes use of the current contents(as in |=) in SubPWBuf.
-void CDAccess_Image::MakeSubPQ(int32 lba, uint8 *SubPWBuf)
-{
-   unsigned i;
-   uint8_t buf[0xC], adr, control;
-   int32_t track;
-   uint32_t lba_relative;
-   uint32_t ma, sa, fa;
-   uint32_t m, s, f;
-   uint8_t pause_or = 0x00;
-   bool track_found = false;
-
-   for(track = FirstTrack; track < (FirstTrack + NumTracks); track++)
-   {
-      if(lba >= (Tracks[track].LBA - Tracks[track].pregap_dv - Tracks[track].pregap) 
-            && lba < (Tracks[track].LBA + Tracks[track].sectors + Tracks[track].postgap))
-      {
-         track_found = true;
-         break;
-      }
-   }
-
-   //printf("%d %d\n", Tracks[1].LBA, Tracks[1].sectors);
-
-   if(!track_found)
-   {
-      printf("MakeSubPQ error for sector %u!", lba);
-      track = FirstTrack;
-   }
-
-   lba_relative = abs((int32)lba - Tracks[track].LBA);
-
-   f            = (lba_relative % 75);
-   s            = ((lba_relative / 75) % 60);
-   m            = (lba_relative / 75 / 60);
-
-   fa           = (lba + 150) % 75;
-   sa           = ((lba + 150) / 75) % 60;
-   ma           = ((lba + 150) / 75 / 60);
-
-   adr          = 0x1; // Q channel data encodes position
-   control      = Tracks[track].subq_control;
-
-   // Handle pause(D7 of interleaved subchannel byte) bit, should be set to 1 when in pregap or postgap.
-   if((lba < Tracks[track].LBA) || (lba >= Tracks[track].LBA + Tracks[track].sectors))
-   {
-      //printf("pause_or = 0x80 --- %d\n", lba);
-      pause_or = 0x80;
-   }
-
-   // Handle pregap between audio->data track
-   {
-      int32_t pg_offset = (int32)lba - Tracks[track].LBA;
-
-      // If we're more than 2 seconds(150 sectors) from the real "start" of the track/INDEX 01, and the track is a data track,
-      // and the preceding track is an audio track, encode it as audio(by taking the SubQ control field from the preceding track).
-      //
-      // TODO: Look into how we're supposed to handle subq control field in the four combinations of track types(data/audio).
-      //
-      if(pg_offset < -150)
-      {
-         if((Tracks[track].subq_control & SUBQ_CTRLF_DATA) && (FirstTrack < track) && !(Tracks[track - 1].subq_control & SUBQ_CTRLF_DATA))
-         {
-            //printf("Pregap part 1 audio->data: lba=%d track_lba=%d\n", lba, Tracks[track].LBA);
-            control = Tracks[track - 1].subq_control;
-         }
-      }
-   }
-
-   memset(buf, 0, 0xC);
-   buf[0] = (adr << 0) | (control << 4);
-   buf[1] = U8_to_BCD(track);
-
-   if(lba < Tracks[track].LBA) // Index is 00 in pregap
-      buf[2] = U8_to_BCD(0x00);
-   else
-      buf[2] = U8_to_BCD(0x01);
-
-   /* Track relative MSF address */
-   buf[3] = U8_to_BCD(m);
-   buf[4] = U8_to_BCD(s);
-   buf[5] = U8_to_BCD(f);
-   buf[6] = 0;
-   /* Absolute MSF address */
-   buf[7] = U8_to_BCD(ma);
-   buf[8] = U8_to_BCD(sa);
-   buf[9] = U8_to_BCD(fa);
-
-   subq_generate_checksum(buf);
-
-   if(!SubQReplaceMap.empty())
-   {
-      //printf("%d\n", lba);
-      std::map<uint32, cpp11_array_doodad>::const_iterator it = SubQReplaceMap.find(LBA_to_ABA(lba));
-
-      if(it != SubQReplaceMap.end())
-      {
-         //printf("Replace: %d\n", lba);
-         memcpy(buf, it->second.data, 12);
-      }
-   }
-
-   for (i = 0; i < 96; i++)
-      SubPWBuf[i] |= (((buf[i >> 3] >> (7 - (i & 0x7))) & 1) ? 0x40 : 0x00) | pause_or;
-}
-
 bool CDAccess_Image::Read_Raw_PW(uint8_t *buf, int32_t lba)
 {
    memset(buf, 0, 96);
-   MakeSubPQ(lba, buf);
+   SubQ_Make(lba, buf);
    return true;
 }
 
@@ -28,7 +28,7 @@
 
 #include "../general.h"
 #include "../FileStream.h"
-#include "../MemoryStream.h"
+#include "../PreloadStream.h"
 
 #include "CDAccess.h"
 #include "CDAccess_PBP.h"
@@ -111,7 +111,7 @@ bool CDAccess_PBP::ImageOpen(const char *path, bool image_memcache)
    MDFN_GetFilePathComponents(path, &base_dir, &file_base, &file_ext);
 
    if(image_memcache)
-      fp = new MemoryStream(new FileStream(path, MODE_READ));
+      fp = new PreloadStream(new FileStream(path, MODE_READ));
    else
       fp = new FileStream(path, MODE_READ);
 
@@ -205,11 +205,39 @@ bool CDAccess_PBP::ImageOpen(const char *path, bool image_memcache)
       sbi_path.insert(sbi_path.length()-4, "_x");
    }
 
+   // storage for decompressed blocks
+   for (unsigned i = 0; i < PBP_BLOCK_CACHE_SIZE; i++)
+   {
+      blocks[i].data = (uint8_t (*)[2352])malloc(16 * 2352);
+      if (blocks[i].data == NULL)
+      {
+         log_cb(RETRO_LOG_ERROR, "Unable to allocate memory\n");
+         return false;
+      }
+   }
+
+#if HAVE_THREADS
+   prefetch_thread = sthread_create(PrefetchThread_Main, this);
+#endif
+
    return true;
 }
 
 void CDAccess_PBP::Cleanup(void)
 {
+#if HAVE_THREADS
+   if (prefetch_thread != NULL)
+   {
+      slock_lock(block_lock);
+      prefetch_quit = true;
+      scond_broadcast(block_cond);
+      slock_unlock(block_lock);
+
+      sthread_join(prefetch_thread);
+      prefetch_thread = NULL;
+   }
+#endif
+
    if(fp != NULL)
    {
       fp->close();   // need to manually close for FileStreams?
@@ -217,13 +245,46 @@ void CDAccess_PBP::Cleanup(void)
    }
    if(index_table != NULL)
       free(index_table);
+
+   for (unsigned i = 0; i < PBP_BLOCK_CACHE_SIZE; i++)
+   {
+      if (blocks[i].data != NULL)
+         free(blocks[i].data);
+   }
+
+#if HAVE_THREADS
+   scond_free(block_cond);
+   slock_free(fp_lock);
+   slock_free(block_lock);
+#endif
 }
 
 CDAccess_PBP::CDAccess_PBP(const char *path, bool image_memcache) : NumTracks(0), FirstTrack(0), LastTrack(0), total_sectors(0)
 {
    is_official = false;
    index_table = NULL;
+   index_len = 0;
    fp = NULL;
+
+   for (unsigned i = 0; i < PBP_BLOCK_CACHE_SIZE; i++)
+   {
+      blocks[i].data    = NULL;
+      blocks[i].block   = -1;
+      blocks[i].pending = false;
+      blocks[i].used    = 0;
+   }
+   block_clock    = 0;
+   last_block     = -1;
+   prefetch_block = -1;
+
+#if HAVE_THREADS
+   block_lock      = slock_new();
+   fp_lock         = slock_new();
+   block_cond      = scond_new();
+   prefetch_thread = NULL;
+   prefetch_quit   = false;
+#endif
+
    kirk_init();
    if (!ImageOpen(path, image_memcache))
    {
@@ -235,134 +296,26 @@ CDAccess_PBP::~CDAccess_PBP()
    Cleanup();
 }
 
-// Note: this function makes use of the current contents(as in |=) in SubPWBuf.
-void CDAccess_PBP::MakeSubPQ(int32 lba, uint8 *SubPWBuf)
-{
-   unsigned i;
-   uint8_t buf[0xC], adr, control;
-   int32_t track;
-   uint32_t lba_relative;
-   uint32_t ma, sa, fa;
-   uint32_t m, s, f;
-   uint8_t pause_or = 0x00;
-   bool track_found = false;
-
-   for(track = FirstTrack; track < (FirstTrack + NumTracks); track++)
-   {
-      if(lba >= (Tracks[track].LBA - Tracks[track].pregap_dv - Tracks[track].pregap) && lba < (Tracks[track].LBA + Tracks[track].sectors + Tracks[track].postgap))
-      {
-         track_found = true;
-         break;
-      }
-   }
-
-   //printf("%d %d\n", Tracks[1].LBA, Tracks[1].sectors);
-
-   if(!track_found)
-   {
-      printf("MakeSubPQ error for sector %u!", lba);
-      track = FirstTrack;
-   }
-
-   lba_relative = abs((int32)lba - Tracks[track].LBA);
-
-   f            = (lba_relative % 75);
-   s            = ((lba_relative / 75) % 60);
-   m            = (lba_relative / 75 / 60);
-
-   fa           = (lba + 150) % 75;
-   sa           = ((lba + 150) / 75) % 60;
-   ma           = ((lba + 150) / 75 / 60);
-
-   adr          = 0x1; // Q channel data encodes position
-   control      = Tracks[track].subq_control;
-
-   // Handle pause(D7 of interleaved subchannel byte) bit, should be set to 1 when in pregap or postgap.
-   if((lba < Tracks[track].LBA) || (lba >= Tracks[track].LBA + Tracks[track].sectors))
-   {
-      //printf("pause_or = 0x80 --- %d\n", lba);
-      pause_or = 0x80;
-   }
-
-   // Handle pregap between audio->data track
-   {
-      int32_t pg_offset = (int32)lba - Tracks[track].LBA;
-
-      // If we're more than 2 seconds(150 sectors) from the real "start" of the track/INDEX 01, and the track is a data track,
-      // and the preceding track is an audio track, encode it as audio(by taking the SubQ control field from the preceding track).
-      //
-      // TODO: Look into how we're supposed to handle subq control field in the four combinations of track types(data/audio).
-      //
-      if(pg_offset < -150)
-      {
-         if((Tracks[track].subq_control & SUBQ_CTRLF_DATA) && (FirstTrack < track) && !(Tracks[track - 1].subq_control & SUBQ_CTRLF_DATA))
-         {
-            //printf("Pregap part 1 audio->data: lba=%d track_lba=%d\n", lba, Tracks[track].LBA);
-            control = Tracks[track - 1].subq_control;
-         }
-      }
-   }
-
-   memset(buf, 0, 0xC);
-   buf[0] = (adr << 0) | (control << 4);
-   buf[1] = U8_to_BCD(track);
-
-   if(lba < Tracks[track].LBA) // Index is 00 in pregap
-      buf[2] = U8_to_BCD(0x00);
-   else
-      buf[2] = U8_to_BCD(0x01);
-
-   /* Track relative MSF address */
-   buf[3] = U8_to_BCD(m);
-   buf[4] = U8_to_BCD(s);
-   buf[5] = U8_to_BCD(f);
-   buf[6] = 0;
-   /* Absolute MSF address */
-   buf[7] = U8_to_BCD(ma);
-   buf[8] = U8_to_BCD(sa);
-   buf[9] = U8_to_BCD(fa);
-
-   subq_generate_checksum(buf);
-
-   if(!SubQReplaceMap.empty())
-   {
-      //printf("%d\n", lba);
-      std::map<uint32, cpp11_array_doodad>::const_iterator it = SubQReplaceMap.find(LBA_to_ABA(lba));
-
-      if(it != SubQReplaceMap.end())
-      {
-         //printf("Replace: %d\n", lba);
-         memcpy(buf, it->second.data, 12);
-      }
-   }
-
-   for (i = 0; i < 96; i++)
-      SubPWBuf[i] |= (((buf[i >> 3] >> (7 - (i & 0x7))) & 1) ? 0x40 : 0x00) | pause_or;
-}
-
 bool CDAccess_PBP::Read_Raw_PW(uint8_t *buf, int32_t lba)
 {
    memset(buf, 0, 96);
-   MakeSubPQ(lba, buf);
+   SubQ_Make(lba, buf);
    return true;
 }
 
 
 int CDAccess_PBP::decompress2(void *out, uint32_t *out_size, void *in, uint32_t in_size)
 {
-   static z_stream z;
+   // Not static, every open disc has a prefetch thread of its own to decompress blocks on.
+   z_stream z;
    int ret = 0;
 
-   if (z.zalloc == NULL) {
-      z.next_in = Z_NULL;
-      z.avail_in = 0;
-      z.zalloc = Z_NULL;
-      z.zfree = Z_NULL;
-      z.opaque = Z_NULL;
-      ret = inflateInit2(&z, -15);
-   }
-   else
-      ret = inflateReset(&z);
+   z.next_in = Z_NULL;
+   z.avail_in = 0;
+   z.zalloc = Z_NULL;
+   z.zfree = Z_NULL;
+   z.opaque = Z_NULL;
+   ret = inflateInit2(&z, -15);
 
    if (ret != Z_OK)
       return ret;
@@ -373,6 +326,7 @@ int CDAccess_PBP::decompress2(void *out, uint32_t *out_size, void *in, uint32_t
    z.avail_out = *out_size;
 
    ret = inflate(&z, Z_FINISH);
+   inflateEnd(&z);
 
    *out_size -= z.avail_out;
    return ret == 1 ? 0 : ret;
@@ -383,81 +337,259 @@ bool CDAccess_PBP::Read_Raw_Sector(uint8 *buf, int32 lba)
    uint8_t SimuQ[0xC];
 
    int32_t block = lba >> 4;
-   sector_in_blk = lba & 0xf;
 
    memset(buf + 2352, 0, 96);
-   MakeSubPQ(lba, buf + 2352);
+   SubQ_Make(lba, buf + 2352);
    subq_deinterleave(buf + 2352, SimuQ);
 
-   if (block != current_block)
+   if (lba >= index_len * 16)
    {
-      uint32_t start_byte = index_table[block];
-      uint32_t size = index_table[block+1] - start_byte;
-      bool is_compressed = true;
+      log_cb(RETRO_LOG_ERROR, "[PBP] sector %d is past img end\n", lba);
+      return false;
+   }
 
-      if (lba >= index_len * 16)
-      {
-         log_cb(RETRO_LOG_ERROR, "[PBP] sector %d is past img end\n", lba);
-         return false;
-      }
+   return ReadBlockSector(buf, block, lba & 0xf);
+}
 
-      if (size > sizeof(buff_compressed))
-      {
-         log_cb(RETRO_LOG_ERROR, "[PBP] %u: block %d is too large (%u)\n", lba, block, size);
-         return false;
-      }
-      else if(size == sizeof(buff_compressed))
+CDAccess_PBP::block_slot *CDAccess_PBP::FindBlock(int32_t block)
+{
+   for (unsigned i = 0; i < PBP_BLOCK_CACHE_SIZE; i++)
+   {
+      if (blocks[i].block == block)
+         return &blocks[i];
+   }
+
+   return NULL;
+}
+
+// Picks the slot to decompress a block into: an empty one, or else the least recently used one that isn't pending.
+CDAccess_PBP::block_slot *CDAccess_PBP::EvictBlock(void)
+{
+   block_slot *victim = NULL;
+
+   for (unsigned i = 0; i < PBP_BLOCK_CACHE_SIZE; i++)
+   {
+      block_slot *slot = &blocks[i];
+
+      if (slot->pending)
+         continue;
+
+      if (slot->block < 0)
+         return slot;
+
+      if (victim == NULL || (int32_t)(slot->used - victim->used) < 0)
+         victim = slot;
+   }
+
+   return victim;
+}
+
+// Reads, decompresses and fixes up block into slot.  Called with block_lock held, which is let go of meanwhile; the
+// slot is marked pending so that it's left alone until then.
+bool CDAccess_PBP::DecompressBlock(block_slot *slot, int32_t block)
+{
+   uint32_t start_byte = index_table[block];
+   uint32_t size = index_table[block+1] - start_byte;
+   bool is_compressed = true;
+   bool ok = true;
+
+   slot->block   = block;
+   slot->pending = true;
+   slot->used    = block_clock;
+
+#if HAVE_THREADS
+   slock_unlock(block_lock);
+   slock_lock(fp_lock);
+#endif
+
+   if (size > sizeof(buff_compressed))
+   {
+      log_cb(RETRO_LOG_ERROR, "[PBP] %u: block %d is too large (%u)\n", block * 16, block, size);
+      ok = false;
+   }
+   else
+   {
+      if(size == sizeof(buff_compressed))
          is_compressed = false;  // should be the case here?
 
       fp->seek(start_byte, SEEK_SET);
-      fp->read(is_compressed ? buff_compressed : buff_raw[0], size);
+      fp->read(is_compressed ? buff_compressed : slot->data[0], size);
 
-//log_cb(RETRO_LOG_DEBUG, "lba = %d, block = %u, start_byte = %#x, index_table[%i] = %#x\n", lba, block, start_byte, block, index_table[block]);
+//log_cb(RETRO_LOG_DEBUG, "block = %u, start_byte = %#x, index_table[%i] = %#x\n", block, start_byte, block, index_table[block]);
 
       if (is_compressed)
       {
          if(is_official)
-         {
-            decompress(buff_raw[0], buff_compressed, sizeof(buff_compressed));
-            fixed_sectors = 0;
-         }
+            decompress(slot->data[0], buff_compressed, sizeof(buff_compressed));
          else
          {
-            uint32_t cdbuffer_size_expect = sizeof(buff_raw[0]) << 4;
+            uint32_t cdbuffer_size_expect = sizeof(slot->data[0]) << 4;
             uint32_t cdbuffer_size = cdbuffer_size_expect;
-            int ret = decompress2(buff_raw[0], &cdbuffer_size, buff_compressed, size);
+            int ret = decompress2(slot->data[0], &cdbuffer_size, buff_compressed, size);
             if (ret != 0)
             {
-               log_cb(RETRO_LOG_ERROR, "[PBP] uncompress failed with %d for block %d, sector %d (%u)\n", ret, block, lba, size);
-               return false;
+               log_cb(RETRO_LOG_ERROR, "[PBP] uncompress failed with %d for block %d, sector %d (%u)\n", ret, block, block * 16, size);
+               ok = false;
             }
-            if (cdbuffer_size != cdbuffer_size_expect)
+            else if (cdbuffer_size != cdbuffer_size_expect)
             {
-               log_cb(RETRO_LOG_WARN, "[PBP] cdbuffer_size: %lu != %lu, sector %d\n", cdbuffer_size, cdbuffer_size_expect, lba);
-               return false;
+               log_cb(RETRO_LOG_WARN, "[PBP] cdbuffer_size: %lu != %lu, sector %d\n", cdbuffer_size, cdbuffer_size_expect, block * 16);
+               ok = false;
             }
          }
       }
-      current_block = block;
    }
 
-   if(is_official)
+#if HAVE_THREADS
+   slock_unlock(fp_lock);
+#endif
+
+   // Done once here rather than on every read of the sector, now that the block stays cached.
+   if (ok && is_official)
    {
-      // this will probably rarely get caught but better than trying to do it every time I guess...
-      if(!(fixed_sectors & (0x1 << sector_in_blk)))
+      for (int i = 0; i < 16; i++)
       {
-         if(fix_sector(buff_raw[sector_in_blk], lba) != 0)
-            log_cb(RETRO_LOG_WARN, "[PBP] Failed to fix sector %d\n", lba);
-         else
-            fixed_sectors |= (0x1 << sector_in_blk);
+         if(fix_sector(slot->data[i], block * 16 + i) != 0)
+            log_cb(RETRO_LOG_WARN, "[PBP] Failed to fix sector %d\n", block * 16 + i);
+      }
+   }
+
+#if HAVE_THREADS
+   slock_lock(block_lock);
+#endif
+
+   slot->pending = false;
+
+   if (!ok)
+      slot->block = -1;
+
+#if HAVE_THREADS
+   scond_broadcast(block_cond);
+#endif
+
+   return ok;
+}
+
+// Copies a sector out of the block cache, decompressing the block if it isn't there, and moves the prefetch window
+// along.
+bool CDAccess_PBP::ReadBlockSector(uint8_t *buf, int32_t block, int sector_in_blk)
+{
+   block_slot *slot;
+
+#if HAVE_THREADS
+   slock_lock(block_lock);
+#endif
+
+   for (;;)
+   {
+      slot = FindBlock(block);
+
+      if (slot == NULL)
+      {
+         slot = EvictBlock();
+
+         if (!DecompressBlock(slot, block))
+         {
+#if HAVE_THREADS
+            slock_unlock(block_lock);
+#endif
+            return false;
+         }
+      }
+#if HAVE_THREADS
+      else if (slot->pending)
+      {
+         // the prefetch thread is on it
+         scond_wait(block_cond, block_lock);
+         continue;
       }
+#endif
+
+      break;
    }
 
-   memcpy(buf, buff_raw[sector_in_blk], 2352);
+   slot->used = ++block_clock;
+   memcpy(buf, slot->data[sector_in_blk], 2352);
+
+   // only prefetch while the reads move on to the following block, seeks would just waste the work
+   if (block != last_block)
+   {
+      prefetch_block = (block == last_block + 1) ? block + 1 : -1;
+      last_block     = block;
+#if HAVE_THREADS
+      if (prefetch_block >= 0)
+         scond_broadcast(block_cond);
+#endif
+   }
+
+#if HAVE_THREADS
+   slock_unlock(block_lock);
+#endif
 
    return true;
 }
 
+// Empties the block cache, for when index_table is about to change.
+void CDAccess_PBP::FlushBlocks(void)
+{
+#if HAVE_THREADS
+   slock_lock(block_lock);
+#endif
+
+   for (unsigned i = 0; i < PBP_BLOCK_CACHE_SIZE; i++)
+   {
+#if HAVE_THREADS
+      while (blocks[i].pending)
+         scond_wait(block_cond, block_lock);
+#endif
+      blocks[i].block = -1;
+   }
+
+   last_block     = -1;
+   prefetch_block = -1;
+
+#if HAVE_THREADS
+   slock_unlock(block_lock);
+#endif
+}
+
+#if HAVE_THREADS
+// Decompresses the PBP_BLOCK_PREFETCH blocks following the last one read while reading sequentially, so that the
+// reads find them ready; mostly for streamed FMV, which reads a long way at 2x speed.
+void CDAccess_PBP::PrefetchThread_Main(void *arg)
+{
+   CDAccess_PBP *cda = (CDAccess_PBP*)arg;
+
+   slock_lock(cda->block_lock);
+
+   while (!cda->prefetch_quit)
+   {
+      int32_t block = -1;
+
+      for (int32_t b = cda->prefetch_block; b >= 0 && b < cda->prefetch_block + PBP_BLOCK_PREFETCH && b * 16 < cda->total_sectors; b++)
+      {
+         if (cda->FindBlock(b) == NULL)
+         {
+            block = b;
+            break;
+         }
+      }
+
+      if (block < 0)
+      {
+         scond_wait(cda->block_cond, cda->block_lock);
+         continue;
+      }
+
+      // don't keep retrying a bad block, the next read will
+      if (!cda->DecompressBlock(cda->EvictBlock(), block))
+         cda->prefetch_block = -1;
+   }
+
+   slock_unlock(cda->block_lock);
+}
+#endif
+
 bool CDAccess_PBP::Read_TOC(TOC *toc)
 {
    struct {
@@ -485,7 +617,12 @@ bool CDAccess_PBP::Read_TOC(TOC *toc)
    uint32_t index_table_offset = 0x3C00;
    uint32_t cdimg_base = psisoimg_offset + 0x100000;
 
-   uint8_t* iso_header = (uint8_t*)malloc(0xB6600);
+   uint8_t* iso_header;
+
+   // index_table and the image it points into are about to change(this is also how a disc is swapped)
+   FlushBlocks();
+
+   iso_header = (uint8_t*)malloc(0xB6600);
 
    if(!iso_header)
    {
@@ -616,8 +753,6 @@ bool CDAccess_PBP::Read_TOC(TOC *toc)
    read_offset = index_table_offset;
 
    // set class variables
-   fixed_sectors = 0;
-   current_block = (uint32_t)-1;
    index_len = 0xAFC80 / sizeof(index_entry);   // disc map table has a fixed size of 0xAFC80 (22500 entries)?
 
    if(index_table != NULL)
@@ -675,6 +810,8 @@ bool CDAccess_PBP::Read_TOC(TOC *toc)
       log_cb(RETRO_LOG_WARN, "[PBP] Invalid path/filename for SBI file %s\n", sbi_path.c_str());
    }
 
+   SubQ_Build(Tracks, FirstTrack, NumTracks);
+
    return true;
 }
 
@@ -835,124 +972,126 @@ int CDAccess_PBP::decrypt_pgd(unsigned char* pgd_data, int pgd_size)
    return PGD->data_size;
 }
 
-int CDAccess_PBP::decode_range(unsigned int *range, unsigned int *code, unsigned char **src)
+// Range decoder state for decompress(), kept in a local so that it can live in registers rather than being
+// passed around by pointer.
+struct lzrc_decoder
+{
+   uint32_t range;
+   uint32_t code;
+   const uint8_t *src;
+};
+
+static INLINE uint32_t lzrc_bit_bound(lzrc_decoder &rc)
 {
-   if (!((*range) >> 24))
+   if (!(rc.range >> 24))
    {
-      (*range) <<= 8;
-      *code = ((*code) << 8) + (*src)++[5];
-      return 1;
+      rc.range <<= 8;
+      rc.code = (rc.code << 8) + rc.src++[5];
    }
 
-   return 0;
+   return rc.range >> 8;
 }
 
-int CDAccess_PBP::decode_bit(unsigned int *range, unsigned int *code, 
-      int *index, unsigned char **src, unsigned char *c)
+static INLINE int lzrc_decode_bit(lzrc_decoder &rc, uint8_t *c)
 {
-   unsigned int val = *range;
+   const uint32_t val = lzrc_bit_bound(rc) * (*c);
 
-   if (decode_range(range, code, src))
-      val *= (*c);
-   else
-      val = (val >> 8) * (*c);
+   *c -= (*c) >> 3;
 
-   *c -= ((*c) >> 3);
-   if (index)
-      (*index) <<= 1;
-
-   if (*code < val)
+   if (rc.code < val)
    {
-      *range = val;
+      rc.range = val;
       *c += 31;
-      if (index) (*index)++;
       return 1;
    }
 
-   *code -= val;
-   *range -= val;
+   rc.code -= val;
+   rc.range -= val;
    return 0;
 }
 
-int CDAccess_PBP::decode_word(unsigned char *ptr, int index, 
-      int *bit_flag, unsigned int *range, 
-      unsigned int *code, unsigned char **src)
+// Shifts the decoded bit into *index.
+static INLINE int lzrc_decode_bit(lzrc_decoder &rc, int *index, uint8_t *c)
+{
+   const int bit = lzrc_decode_bit(rc, c);
+
+   *index = ((*index) << 1) | bit;
+
+   return bit;
+}
+
+// Bits with a fixed 50% probability.
+static INLINE int lzrc_decode_direct(lzrc_decoder &rc, int i, int count)
+{
+   if (!(rc.range >> 24))
+   {
+      rc.range <<= 8;
+      rc.code = (rc.code << 8) + rc.src++[5];
+   }
+
+   for (; count > 0; count--)
+   {
+      i <<= 1;
+      rc.range >>= 1;
+      if (rc.code < rc.range)
+         i++;
+      else
+         rc.code -= rc.range;
+   }
+
+   return i;
+}
+
+static int lzrc_decode_word(lzrc_decoder &rc, uint8_t *ptr, int index, int *bit_flag)
 {
    int i = 1;
    index >>= 3;
 
    if (index >= 3)
    {
-      decode_bit(range, code, &i, src, ptr);          // Offset 0x8A8
+      lzrc_decode_bit(rc, &i, ptr);          // Offset 0x8A8
       if (index >= 4)
       {
-         decode_bit(range, code, &i, src, ptr);      // Offset 0x8A8
+         lzrc_decode_bit(rc, &i, ptr);      // Offset 0x8A8
          if (index >= 5)
-         {
-            decode_range(range, code, src);
-            for (; index >= 5; index--)
-            {
-               i <<= 1;
-               (*range) >>= 1;
-               if (*code < *range)
-                  i++;
-               else
-                  (*code) -= *range;
-            }
-         }
+            i = lzrc_decode_direct(rc, i, index - 4);
       }
    }
 
-   *bit_flag = decode_bit(range, code, &i, src, ptr + 3);   // Offset 0x8A8 + 3
+   *bit_flag = lzrc_decode_bit(rc, &i, ptr + 3);   // Offset 0x8A8 + 3
 
    if (index >= 1)
    {
-      decode_bit(range, code, &i, src, ptr + 2);           // Offset 0x8A8 + 2
+      lzrc_decode_bit(rc, &i, ptr + 2);           // Offset 0x8A8 + 2
       if (index >= 2)
-      {
-         decode_bit(range, code, &i, src, ptr + 1);       // Offset 0x8A8 + 1
-      }
+         lzrc_decode_bit(rc, &i, ptr + 1);       // Offset 0x8A8 + 1
    }
 
    return i;
 }
 
-int CDAccess_PBP::decode_number(unsigned char *ptr, int index, int *bit_flag, 
-      unsigned int *range, unsigned int *code, unsigned char **src)
+static int lzrc_decode_number(lzrc_decoder &rc, uint8_t *ptr, int index, int *bit_flag)
 {
    int i = 1;
 
    if (index >= 3)
    {
-      decode_bit(range, code, &i, src, ptr + 0x18);         // Offset 0x978
+      lzrc_decode_bit(rc, &i, ptr + 0x18);         // Offset 0x978
       if (index >= 4)
       {
-         decode_bit(range, code, &i, src, ptr + 0x18);     // Offset 0x978
+         lzrc_decode_bit(rc, &i, ptr + 0x18);     // Offset 0x978
          if (index >= 5)
-         {
-            decode_range(range, code, src);
-            for (; index >= 5; index--)
-            {
-               i <<= 1;
-               (*range) >>= 1;
-               if (*code < *range)
-                  i++;
-               else
-                  (*code) -= *range;
-            }
-         }
+            i = lzrc_decode_direct(rc, i, index - 4);
       }
    }
 
-   *bit_flag = decode_bit(range, code, &i, src, ptr);       // Offset 0x960
+   *bit_flag = lzrc_decode_bit(rc, &i, ptr);       // Offset 0x960
 
-   if (index >= 1) 
+   if (index >= 1)
    {
-      decode_bit(range, code, &i, src, ptr + 0x8);         // Offset 0x968
+      lzrc_decode_bit(rc, &i, ptr + 0x8);         // Offset 0x968
       if (index >= 2)
-      {
-         decode_bit(range, code, &i, src, ptr + 0x10);    // Offset 0x970
-      }
+         lzrc_decode_bit(rc, &i, ptr + 0x10);    // Offset 0x970
    }
 
    return i;
@@ -977,16 +1116,19 @@ int CDAccess_PBP::decompress(unsigned char *out, unsigned char *in, unsigned int
    unsigned char *end = (out + size);
    unsigned char head = in[0];
 
-   unsigned int range = 0xFFFFFFFF;
-   unsigned int code = (in[1] << 24) | (in[2] << 16) | (in[3] << 8) | in[4];
+   lzrc_decoder rc;
+
+   rc.range = 0xFFFFFFFF;
+   rc.code = (in[1] << 24) | (in[2] << 16) | (in[3] << 8) | in[4];
+   rc.src = in;
 
    if (head < 0) // Check if we have a valid starting byte.
    {
       // The dictionary header is invalid, the data is not compressed.
       result = -1;
-      if (code <= size)
+      if (rc.code <= size)
       {
-         memcpy(out, (const void *)(in + 5), code);
+         memcpy(out, (const void *)(in + 5), rc.code);
          result = (start - out);
       }
    }
@@ -998,7 +1140,7 @@ int CDAccess_PBP::decompress(unsigned char *out, unsigned char *in, unsigned int
       {
          // Start reading at 0x920.
          tmp_sect1 = tmp + offset + 0x920;
-         if (!decode_bit(&range, &code, 0, &in, tmp_sect1))  // Raw char.
+         if (!lzrc_decode_bit(rc, tmp_sect1))  // Raw char.
          {
             // Adjust offset and check for stream end.
             if (offset > 0) offset--;
@@ -1012,7 +1154,7 @@ int CDAccess_PBP::decompress(unsigned char *out, unsigned char *in, unsigned int
             // Read, decode and write back.
             do
             {
-               decode_bit(&range, &code, &index, &in, tmp_sect1 + index);
+               lzrc_decode_bit(rc, &index, tmp_sect1 + index);
             } while ((index >> 8) == 0);
 
             // Save index.
@@ -1025,7 +1167,7 @@ int CDAccess_PBP::decompress(unsigned char *out, unsigned char *in, unsigned int
             // Identify the data length bit field.
             do {
                tmp_sect1 += 8;
-               bit_flag = decode_bit(&range, &code, 0, &in, tmp_sect1);
+               bit_flag = lzrc_decode_bit(rc, tmp_sect1);
                index += bit_flag;
             } while ((bit_flag != 0) && (index < 6));
 
@@ -1041,7 +1183,7 @@ int CDAccess_PBP::decompress(unsigned char *out, unsigned char *in, unsigned int
                tmp_sect1 = tmp + 0x960 + sect;
 
                // Decode the data length (8 bit fields).
-               data_length = decode_number(tmp_sect1, index, &bit_flag, &range, &code, &in);
+               data_length = lzrc_decode_number(rc, tmp_sect1, index, &bit_flag);
 
                // If we got valid parameters, seek to find data offset.
                if ((data_length != 3) && ((index > 0) || (bit_flag != 0))) {
@@ -1059,7 +1201,7 @@ int CDAccess_PBP::decompress(unsigned char *out, unsigned char *in, unsigned int
             // Identify the data offset bit field.
             do {
                diff = (shift << 4) - b_size;
-               bit_flag = decode_bit(&range, &code, &shift, &in, tmp_sect2 + (shift << 3));
+               bit_flag = lzrc_decode_bit(rc, &shift, tmp_sect2 + (shift << 3));
             } while (diff < 0);
 
             // If the data offset was found, parse it as a number.
@@ -1072,7 +1214,7 @@ int CDAccess_PBP::decompress(unsigned char *out, unsigned char *in, unsigned int
                tmp_sect3 = tmp + 0x8A8 + diff;
 
                // Decode the data offset (1 bit fields).
-               data_offset = decode_word(tmp_sect3, diff, &bit_flag, &range, &code, &in);
+               data_offset = lzrc_decode_word(rc, tmp_sect3, diff, &bit_flag);
             } else {
                // Assume one byte of advance.
                data_offset = 1;
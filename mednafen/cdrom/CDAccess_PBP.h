@@ -6,6 +6,15 @@
 #include <map>
 #include "CDAccess_Image.h"
 
+#if HAVE_THREADS
+#include <rthreads/rthreads.h>
+#endif
+
+// Decompressed blocks(16 sectors each) kept around, and how far past the block being read the prefetch thread
+// decompresses.
+#define PBP_BLOCK_CACHE_SIZE  16
+#define PBP_BLOCK_PREFETCH    4
+
 class Stream;
 
 class CDAccess_PBP : public CDAccess
@@ -23,6 +32,10 @@ class CDAccess_PBP : public CDAccess
 
       virtual void Eject(bool eject_status);
 
+      // Decodes an LZRC stream(official PBPs) into out; returns how much was written, or -1 on a corrupt stream.  Reads
+      // a few bytes past the end of the stream.
+      static int decompress(unsigned char *out, unsigned char *in, unsigned int size);
+
    private:
       Stream* fp;
 
@@ -41,12 +54,41 @@ class CDAccess_PBP : public CDAccess
       uint32_t pbp_file_offsets[PBP_NUM_FILES];
 
       ////////////////
-      uint8_t buff_raw[16][2352];
       uint8_t buff_compressed[2352 * 16];
       uint32_t *index_table;
       uint32_t index_len;
-      uint32_t current_block;
-      uint32_t sector_in_blk;
+
+      // Block cache, least recently used first out.  Blocks of official images are cached with their sectors already
+      // run through fix_sector().
+      struct block_slot
+      {
+         uint8_t (*data)[2352];
+         int32_t block;    // -1 if empty
+         bool pending;     // being decompressed, data not ready yet
+         uint32_t used;    // block_clock at the last read
+      };
+      block_slot blocks[PBP_BLOCK_CACHE_SIZE];
+      uint32_t block_clock;
+      int32_t last_block;
+      int32_t prefetch_block;    // start of the prefetch window, -1 unless reading sequentially
+
+#if HAVE_THREADS
+      // The block cache and fp(with buff_compressed) are each guarded by their own lock, so that cached sectors can be
+      // copied out while a block is being read and decompressed.
+      slock_t *block_lock;
+      slock_t *fp_lock;
+      scond_t *block_cond;
+      sthread_t *prefetch_thread;
+      bool prefetch_quit;
+
+      static void PrefetchThread_Main(void *arg);
+#endif
+
+      block_slot *FindBlock(int32_t block);
+      block_slot *EvictBlock(void);
+      bool DecompressBlock(block_slot *slot, int32_t block);
+      bool ReadBlockSector(uint8_t *buf, int32_t block, int sector_in_blk);
+      void FlushBlocks(void);
       ////////////////
 
       int32_t NumTracks;
@@ -59,7 +101,6 @@ class CDAccess_PBP : public CDAccess
       uint32_t discs_start_offset[5];
       uint32_t psisoimg_offset;
 
-      uint16_t fixed_sectors;
       bool is_official;    // TODO: find more consistent ways to check for used compression algorithm, compressed (and/or encrypted?) audio tracks and messed up sectors
 
       bool ImageOpen(const char *path, bool image_memcache);
@@ -67,21 +108,9 @@ class CDAccess_PBP : public CDAccess
       void Cleanup(void);
 
       CDRFILE_TRACK_INFO Tracks[100]; // Track #0(HMM?) through 99
-      struct cpp11_array_doodad
-      {
-         uint8 data[12];
-      };
-      std::map<uint32, cpp11_array_doodad> SubQReplaceMap;
-      void MakeSubPQ(int32 lba, uint8 *SubPWBuf);
 
       int decompress2(void *out, uint32_t *out_size, void *in, uint32_t in_size);
 
-      int decode_range(unsigned int *range, unsigned int *code, unsigned char **src);
-      int decode_bit(unsigned int *range, unsigned int *code, int *index, unsigned char **src, unsigned char *c);
-      int decode_word(unsigned char *ptr, int index, int *bit_flag, unsigned int *range, unsigned int *code, unsigned char **src);
-      int decode_number(unsigned char *ptr, int index, int *bit_flag, unsigned int *range, unsigned int *code, unsigned char **src);
-      int decompress(unsigned char *out, unsigned char *in, unsigned int size);
-
       int decrypt_pgd(unsigned char* pgd_data, int pgd_size);
       int fix_sector(uint8_t* sector, int32_t lba);
 };
@@ -24,6 +24,7 @@
 #include "../general.h"
 
 #include <algorithm>
+#include <atomic>
 
 #include <boolean.h>
 #include <rthreads/rthreads.h>
@@ -32,6 +33,7 @@
 #include <libretro.h>
 
 extern retro_log_printf_t log_cb;
+extern struct retro_perf_callback perf_cb;
 
 enum
 {
@@ -81,8 +83,11 @@ class CDIF_Queue
 };
 
 
+// Written by the read thread and looked up by the emu thread without a lock; seq is odd while the read thread is
+// writing the buffer, and changes each time it does, so that a reader can tell its copy is whole(a seqlock).
 typedef struct
 {
+   std::atomic<uint32> seq;
    bool valid;
    bool error;
    uint32 lba;
@@ -98,6 +103,7 @@ class CDIF_MT : public CDIF
       virtual ~CDIF_MT();
 
       virtual void HintReadSector(uint32 lba);
+      virtual void HintReadSpeed(unsigned speed);
       virtual bool ReadRawSector(uint8 *buf, uint32 lba, int64 timeout_us);
       virtual bool ReadRawSectorPWOnly(uint8 *buf, uint32 lba, bool hint_fullread);
 
@@ -125,17 +131,26 @@ class CDIF_MT : public CDIF
 
       uint32 SBWritePos;
 
+      // Only for the emu thread to wait on when a sector it wants isn't in SectorBuffers yet.
       slock_t *SBMutex;
       scond_t *SBCond;
+      std::atomic<bool> SBWaiting;
+
+      std::atomic<unsigned> ReadSpeed;
+
+      bool FindSector(uint8 *buf, uint32 lba, bool *error_condition);
 
       //
       // Read-thread-only:
       //
       bool RT_EjectDisc(bool eject_status, bool skip_actual_eject = false);
+      void RT_ClearSectorBuffers(void);
+      void RT_ReadAhead(int count);
 
       uint32 ra_lba;
       int ra_count;
       uint32 last_read_lba;
+      uint32 ra_latency;   // Recent worst time Read_Raw_Sector() took, in microseconds, decaying slowly
 };
 
 #endif /* HAVE_THREAD */
@@ -280,12 +295,63 @@ bool CDIF_MT::RT_EjectDisc(bool eject_status, bool skip_actual_eject)
       ra_lba = 0;
       ra_count = 0;
       last_read_lba = ~0U;
-      memset(SectorBuffers, 0, SBSize * sizeof(CDIF_Sector_Buffer));
+      RT_ClearSectorBuffers();
    }
 
    return true;
 }
 
+void CDIF_MT::RT_ClearSectorBuffers(void)
+{
+   for(unsigned i = 0; i < SBSize; i++)
+   {
+      CDIF_Sector_Buffer *sb = &SectorBuffers[i];
+      const uint32 seq = sb->seq.load(std::memory_order_relaxed);
+
+      sb->seq.store(seq + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      sb->valid = false;
+      sb->seq.store(seq + 2, std::memory_order_release);
+   }
+}
+
+// Reads count sectors from ra_lba on straight into SectorBuffers, waking the emu thread if it's waiting on one.
+void CDIF_MT::RT_ReadAhead(int count)
+{
+   while(count--)
+   {
+      CDIF_Sector_Buffer *sb = &SectorBuffers[SBWritePos];
+      const uint32 seq = sb->seq.load(std::memory_order_relaxed);
+      retro_time_t start = perf_cb.get_time_usec ? perf_cb.get_time_usec() : 0;
+
+      sb->seq.store(seq + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+
+      disc_cdaccess->Read_Raw_Sector(sb->data, ra_lba);
+      sb->lba   = ra_lba;
+      sb->valid = true;
+      sb->error = false;
+
+      sb->seq.store(seq + 2, std::memory_order_release);
+      SBWritePos = (SBWritePos + 1) % SBSize;
+
+      if(perf_cb.get_time_usec)
+         ra_latency = MAX((uint32)(perf_cb.get_time_usec() - start), ra_latency - (ra_latency >> 6));
+
+      // Pairs with the fence in ReadRawSector(), so that it either finds the sector or gets woken up.
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if(SBWaiting.load(std::memory_order_relaxed))
+      {
+         slock_lock((slock_t*)SBMutex);
+         scond_signal((scond_t*)SBCond);
+         slock_unlock((slock_t*)SBMutex);
+      }
+
+      ra_lba++;
+      ra_count--;
+   }
+}
+
 struct RTS_Args
 {
    CDIF_MT *cdif_ptr;
@@ -307,6 +373,7 @@ int CDIF_MT::ReadThreadStart()
    ra_lba = 0;
    ra_count = 0;
    last_read_lba = ~0U;
+   ra_latency = 0;
 
    RT_EjectDisc(false, true);
 
@@ -333,10 +400,15 @@ int CDIF_MT::ReadThreadStart()
 
             case CDIF_MSG_READ_SECTOR:
                {
-                  static const int       max_ra = 16;
-                  static const int   initial_ra = 1;
-                  static const int speedmult_ra = 2;
-                  uint32_t              new_lba = msg.args[0];
+                  // The read-ahead window covers a few sectors per unit of drive speed, plus however many the drive
+                  // gets through during twice the worst recent read stall, so that slow or bursty storage stays ahead.
+                  const unsigned          speed = ReadSpeed.load(std::memory_order_relaxed);
+                  const uint32      interval_us = 1000000 / (75 * speed);
+                  const int             lag_ra = (2 * ra_latency + interval_us - 1) / interval_us;
+                  const int             max_ra = MAX(16, MIN((int)(SBSize / 4) - 1, (int)(4 * speed) + lag_ra));
+                  const int         initial_ra = MIN(max_ra, (int)speed + lag_ra);
+                  const int       speedmult_ra = speed + 1;
+                  uint32_t             new_lba = msg.args[0];
 
                   assert((unsigned int)max_ra < (SBSize / 4));
 
@@ -362,43 +434,32 @@ int CDIF_MT::ReadThreadStart()
       }
 
       // Don't read >= the "end" of the disc, silly snake.  Slither.
-      if(ra_count && ra_lba == disc_toc.tracks[100].lba)
+      if(ra_count && ra_lba + ra_count > disc_toc.tracks[100].lba)
       {
-         ra_count = 0;
+         ra_count = (ra_lba < disc_toc.tracks[100].lba) ? (disc_toc.tracks[100].lba - ra_lba) : 0;
          //printf("Ephemeral scarabs: %d!\n", ra_lba);
       }
 
+      // Read a batch of sectors before going back to the message queue, rather than one at a time, but not so many
+      // that a seek has to wait long to be noticed.
       if(ra_count)
-      {
-         uint8_t tmpbuf[2352 + 96];
-         bool error_condition = false;
-
-         disc_cdaccess->Read_Raw_Sector(tmpbuf, ra_lba);
-
-         slock_lock((slock_t*)SBMutex);
-
-         SectorBuffers[SBWritePos].lba = ra_lba;
-         memcpy(SectorBuffers[SBWritePos].data, tmpbuf, 2352 + 96);
-         SectorBuffers[SBWritePos].valid = true;
-         SectorBuffers[SBWritePos].error = error_condition;
-         SBWritePos = (SBWritePos + 1) % SBSize;
-
-         scond_signal((scond_t*)SBCond);
-         slock_unlock((slock_t*)SBMutex);
-
-         ra_lba++;
-         ra_count--;
-      }
+         RT_ReadAhead(MIN(ra_count, 8));
    }
 
    return(1);
 }
 
-CDIF_MT::CDIF_MT(CDAccess *cda) : disc_cdaccess(cda), CDReadThread(NULL), SBMutex(NULL), SBCond(NULL)
+CDIF_MT::CDIF_MT(CDAccess *cda) : disc_cdaccess(cda), CDReadThread(NULL), SBMutex(NULL), SBCond(NULL), SBWaiting(false), ReadSpeed(1)
 {
    CDIF_Message msg;
    RTS_Args s;
 
+   for(unsigned i = 0; i < SBSize; i++)
+   {
+      SectorBuffers[i].seq.store(0, std::memory_order_relaxed);
+      SectorBuffers[i].valid = false;
+   }
+
    SBMutex            = slock_new();
    SBCond             = scond_new();
    UnrecoverableError = false;
@@ -425,6 +486,12 @@ CDIF_MT::~CDIF_MT()
       SBMutex = NULL;
    }
 
+   if(SBCond)
+   {
+      scond_free((scond_t*)SBCond);
+      SBCond = NULL;
+   }
+
    if(disc_cdaccess)
    {
       delete disc_cdaccess;
@@ -432,6 +499,28 @@ CDIF_MT::~CDIF_MT()
    }
 }
 
+// Looks lba up in SectorBuffers without taking a lock; see CDIF_Sector_Buffer.
+bool CDIF_MT::FindSector(uint8 *buf, uint32 lba, bool *error_condition)
+{
+   for(unsigned i = 0; i < SBSize; i++)
+   {
+      CDIF_Sector_Buffer *sb = &SectorBuffers[i];
+      const uint32 seq = sb->seq.load(std::memory_order_acquire);
+
+      if((seq & 1) || !sb->valid || sb->lba != lba)
+         continue;
+
+      memcpy(buf, sb->data, 2352 + 96);
+      *error_condition = sb->error;
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if(sb->seq.load(std::memory_order_relaxed) == seq)
+         return true;
+   }
+
+   return false;
+}
+
 bool CDIF_MT::ReadRawSector(uint8 *buf, uint32 lba, int64 timeout_us)
 {
    bool found = false;
@@ -453,20 +542,18 @@ bool CDIF_MT::ReadRawSector(uint8 *buf, uint32 lba, int64 timeout_us)
 
    ReadThreadQueue.Write(CDIF_Message(CDIF_MSG_READ_SECTOR, lba));
 
+   // Read-ahead normally has the sector there already.
+   if(FindSector(buf, lba, &error_condition))
+      return(!error_condition);
+
    slock_lock((slock_t*)SBMutex);
+   SBWaiting.store(true, std::memory_order_relaxed);
 
    do
    {
-      int i;
-      for(i = 0; i < SBSize; i++)
-      {
-         if(SectorBuffers[i].valid && SectorBuffers[i].lba == lba)
-         {
-            error_condition = SectorBuffers[i].error;
-            memcpy(buf, SectorBuffers[i].data, 2352 + 96);
-            found = true;
-         }
-      }
+      // Pairs with the fence in RT_ReadAhead().
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      found = FindSector(buf, lba, &error_condition);
 
       if(!found)
       {
@@ -484,6 +571,7 @@ bool CDIF_MT::ReadRawSector(uint8 *buf, uint32 lba, int64 timeout_us)
       }
    } while(!found);
 
+   SBWaiting.store(false, std::memory_order_relaxed);
    slock_unlock((slock_t*)SBMutex);
 
    return(!error_condition);
@@ -522,6 +610,11 @@ void CDIF_MT::HintReadSector(uint32 lba)
    ReadThreadQueue.Write(CDIF_Message(CDIF_MSG_READ_SECTOR, lba));
 }
 
+void CDIF_MT::HintReadSpeed(unsigned speed)
+{
+   ReadSpeed.store(MAX(1U, speed), std::memory_order_relaxed);
+}
+
 bool CDIF_MT::Eject(bool eject_status)
 {
    CDIF_Message msg;
@@ -38,6 +38,10 @@ class CDIF
       }
 
       virtual void HintReadSector(uint32_t lba) = 0;
+
+      // Speed the emulated drive reads at, in multiples of 75 sectors per second; lets read-ahead keep up.
+      virtual void HintReadSpeed(unsigned speed) { }
+
       virtual bool ReadRawSector(uint8_t *buf, uint32_t lba, int64_t timeout_us = -1) = 0;
       virtual bool ReadRawSectorPWOnly(uint8_t *buf, uint32_t lba, bool hint_fullread) = 0;
 
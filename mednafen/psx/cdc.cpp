@@ -51,10 +51,19 @@
 #include "psx.h"
 #include "cdc.h"
 #include "spu.h"
+#include "mdec.h"
 
 #include "../mednafen-endian.h"
 #include "../state_helpers.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define HAVE_CDC_SSE2 1
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(MSB_FIRST)
+#include <arm_neon.h>
+#define HAVE_CDC_NEON 1
+#endif
+
 PS_CDC::PS_CDC() : DMABuffer(4096)
 {
    IsPSXDisc = false;
@@ -69,6 +78,7 @@ PS_CDC::PS_CDC() : DMABuffer(4096)
 }
 
 extern unsigned cd_2x_speedup;
+extern bool cd_fastload_adaptive;
 extern bool cd_async;
 extern bool cd_warned_slow;
 extern int64 cd_slow_timeout;
@@ -181,6 +191,7 @@ void PS_CDC::SoftReset(void)
    SB_In = 0;
    SectorPipe_Pos = SectorPipe_In = 0;
    SectorsRead = 0;
+   FastloadHoldoff = 0;
 
    memset(SubQBuf, 0, sizeof(SubQBuf));
    memset(SubQBuf_Safe, 0, sizeof(SubQBuf_Safe));
@@ -323,6 +334,7 @@ int PS_CDC::StateAction(StateMem *sm, int load, int data_only)
 
       SFVAR(CurSector),
       SFVAR(SectorsRead),
+      SFVAR(FastloadHoldoff),
 
 
       SFVAR(AsyncIRQPending),
@@ -504,16 +516,7 @@ bool PS_CDC::DecodeSubQ(uint8 *subpw)
    return(false);
 }
 
-static const int16 CDADPCMImpulse[7][25] =
-{
-   {     0,    -5,    17,   -35,    70,   -23,   -68,   347,  -839,  2062, -4681, 15367, 21472, -5882,  2810, -1352,   635,  -235,    26,    43,   -35,    16,    -8,     2,     0,  }, /* 0 */
-   {     0,    -2,    10,   -34,    65,   -84,    52,     9,  -266,  1024, -2680,  9036, 26516, -6016,  3021, -1571,   848,  -365,   107,    10,   -16,    17,    -8,     3,    -1,  }, /* 1 */
-   {    -2,     0,     3,   -19,    60,   -75,   162,  -227,   306,   -67,  -615,  3229, 29883, -4532,  2488, -1471,   882,  -424,   166,   -27,     5,     6,    -8,     3,    -1,  }, /* 2 */
-   {    -1,     3,    -2,    -5,    31,   -74,   179,  -402,   689,  -926,  1272, -1446, 31033, -1446,  1272,  -926,   689,  -402,   179,   -74,    31,    -5,    -2,     3,    -1,  }, /* 3 */
-   {    -1,     3,    -8,     6,     5,   -27,   166,  -424,   882, -1471,  2488, -4532, 29883,  3229,  -615,   -67,   306,  -227,   162,   -75,    60,   -19,     3,     0,    -2,  }, /* 4 */
-   {    -1,     3,    -8,    17,   -16,    10,   107,  -365,   848, -1571,  3021, -6016, 26516,  9036, -2680,  1024,  -266,     9,    52,   -84,    65,   -34,    10,    -2,     0,  }, /* 5 */
-   {     0,     2,    -8,    16,   -35,    43,    26,  -235,   635, -1352,  2810, -5882, 21472, 15367, -4681,  2062,  -839,   347,   -68,   -23,    70,   -35,    17,    -5,     0,  }, /* 6 */
-};
+#include "cdc_kernels.inc"
 
 void PS_CDC::ReadAudioBuffer(int32 samples[2])
 {
@@ -561,14 +564,9 @@ void PS_CDC::GetCDAudio(int32 samples[2], const unsigned freq)
       for(unsigned i = 0; i < 2; i++)
       {
          const int16* imp = CDADPCMImpulse[ADPCM_ResampCurPhase];
-         int16* wf = &ADPCM_ResampBuf[i][(ADPCM_ResampCurPos + 32 - 25) & 0x1F];
+         const int16* wf = &ADPCM_ResampBuf[i][(ADPCM_ResampCurPos + 32 - 25) & 0x1F];
 
-         for(unsigned s = 0; s < 25; s++)
-         {
-            out_tmp[i] += imp[s] * wf[s];
-         }
-
-         out_tmp[i] >>= 15;
+         out_tmp[i] = ResampleDot(imp, wf) >> 15;
          clamp(&out_tmp[i], -32768, 32767);
          samples[i] = out_tmp[i];
       }
@@ -599,47 +597,6 @@ void PS_CDC::GetCDAudio(int32 samples[2], const unsigned freq)
 }
 
 
-struct XA_Subheader
-{
-   uint8 file;
-   uint8 channel;
-   uint8 submode;
-   uint8 coding;
-
-   uint8 file_dup;
-   uint8 channel_dup;
-   uint8 submode_dup;
-   uint8 coding_dup;
-};
-
-struct XA_SoundGroup
-{
-   uint8 params[16];
-   uint8 samples[112];
-};
-
-#define XA_SUBMODE_EOF		0x80
-#define XA_SUBMODE_REALTIME	0x40
-#define XA_SUBMODE_FORM		0x20
-#define XA_SUBMODE_TRIGGER	0x10
-#define XA_SUBMODE_DATA		0x08
-#define XA_SUBMODE_AUDIO	0x04
-#define XA_SUBMODE_VIDEO	0x02
-#define XA_SUBMODE_EOR		0x01
-
-#define XA_CODING_EMPHASIS	0x40
-
-//#define XA_CODING_BPS_MASK	0x30
-//#define XA_CODING_BPS_4BIT	0x00
-//#define XA_CODING_BPS_8BIT	0x10
-//#define XA_CODING_SR_MASK	0x0C
-//#define XA_CODING_SR_378	0x00
-//#define XA_CODING_SR_
-
-#define XA_CODING_8BIT		0x10
-#define XA_CODING_189		0x04
-#define XA_CODING_STEREO	0x01
-
 // Special regression prevention test cases:
 //	Um Jammer Lammy (start doing poorly)
 //	Yarudora Series Vol.1 - Double Cast (non-FMV speech)
@@ -691,122 +648,6 @@ void PS_CDC::ClearAudioBuffers(void)
    ADPCM_ResampCurPos = 0;
 }
 
-//
-// output should be readable at -2 and -1
-static void DecodeXAADPCM(const uint8 *input, int16 *output, const unsigned shift, const unsigned weight)
-{
-   // Weights copied over from SPU channel ADPCM playback code, 
-   // may not be entirely the same for CD-XA ADPCM, we need to run tests.
-   static const int32 Weights[16][2] =
-   {
-      // s-1    s-2
-      {   0,    0 },
-      {  60,    0 },
-      { 115,  -52 },
-      {  98,  -55 },
-      { 122,  -60 },
-   };
-
-   for(int i = 0; i < 28; i++)
-   {
-      int32 sample = (int16)(input[i] << 8);
-      sample >>= shift;
-
-      sample += ((output[i - 1] * Weights[weight][0]) >> 6) + ((output[i - 2] * Weights[weight][1]) >> 6);
-
-      clamp(&sample, -32768, 32767);
-      output[i] = sample;
-   }
-}
-
-void PS_CDC::XA_ProcessSector(const uint8 *sdata, CD_Audio_Buffer *ab)
-{
-   const XA_Subheader *sh = (const XA_Subheader *)&sdata[12 + 4];
-   const unsigned unit_index_shift = (sh->coding & XA_CODING_8BIT) ? 0 : 1;
-
-   ab->ReadPos = 0;
-   ab->Size = 18 * (4 << unit_index_shift) * 28;
-
-   if(sh->coding & XA_CODING_STEREO)
-      ab->Size >>= 1;
-
-   ab->Freq = (sh->coding & XA_CODING_189) ? 3 : 6;
-
-   //fprintf(stderr, "Coding: %02x %02x\n", sh->coding, sh->coding_dup);
-
-   for(unsigned group = 0; group < 18; group++)
-   {
-      const XA_SoundGroup *sg = (const XA_SoundGroup *)&sdata[12 + 4 + 8 + group * 128];
-
-      for(unsigned unit = 0; unit < (4U << unit_index_shift); unit++)
-      {
-         const uint8 param = sg->params[(unit & 3) | ((unit & 4) << 1)];
-         const uint8 param_copy = sg->params[4 | (unit & 3) | ((unit & 4) << 1)];
-         uint8 ibuffer[28];
-         int16 obuffer[2 + 28];
-
-         if(param != param_copy)
-         {
-            PSX_WARNING("[CDC] CD-XA param != param_copy --- %d %02x %02x\n", unit, param, param_copy);
-         }
-
-         for(unsigned i = 0; i < 28; i++)
-         {
-            uint8 tmp = sg->samples[i * 4 + (unit >> unit_index_shift)];
-
-            if(unit_index_shift)
-            {
-               tmp <<= (unit & 1) ? 0 : 4;
-               tmp &= 0xf0;
-            }
-
-            ibuffer[i] = tmp;
-         }
-
-         const bool ocn = (bool)(unit & 1) && (sh->coding & XA_CODING_STEREO);
-
-         obuffer[0] = xa_previous[ocn][0];
-         obuffer[1] = xa_previous[ocn][1];
-
-         DecodeXAADPCM(ibuffer, &obuffer[2], param & 0x0F, param >> 4);
-
-         xa_previous[ocn][0] = obuffer[28];
-         xa_previous[ocn][1] = obuffer[29];
-
-         if(param != param_copy)
-            memset(obuffer, 0, sizeof(obuffer));
-
-         if(sh->coding & XA_CODING_STEREO)
-         {
-            for(unsigned s = 0; s < 28; s++)
-            {
-               ab->Samples[ocn][group * (2 << unit_index_shift) * 28 + (unit >> 1) * 28 + s] = obuffer[2 + s];
-            }
-         }
-         else
-         {
-            for(unsigned s = 0; s < 28; s++)
-            {
-               ab->Samples[0][group * (4 << unit_index_shift) * 28 + unit * 28 + s] = obuffer[2 + s];
-               ab->Samples[1][group * (4 << unit_index_shift) * 28 + unit * 28 + s] = obuffer[2 + s];
-            }
-         }
-      }
-   }
-
-#if 0
-   // Test
-   for(unsigned i = 0; i < ab->Size; i++)
-   {
-      static unsigned counter = 0;
-
-      ab->Samples[0][i] = (counter & 2) ? -0x6000 : 0x6000;
-      ab->Samples[1][i] = rand();
-      counter++;
-   }
-#endif
-}
-
 void PS_CDC::ClearAIP(void)
 {
    AsyncResultsPendingCount = 0;
@@ -880,7 +721,31 @@ void PS_CDC::EnbufferizeCDDASector(const uint8 *buf)
    }
    else
    {
-      for(int i = 0; i < 588; i++)
+      int i = 0;
+
+#if defined(HAVE_CDC_SSE2)
+      // Each 32-bit lane is one left/right sample pair.
+      for(; i < 588 - 7; i += 8)
+      {
+         const __m128i a = _mm_loadu_si128((const __m128i *)&buf[i * 4 + 0]);
+         const __m128i b = _mm_loadu_si128((const __m128i *)&buf[i * 4 + 16]);
+         const __m128i l = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16), _mm_srai_epi32(_mm_slli_epi32(b, 16), 16));
+         const __m128i r = _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16));
+
+         _mm_storeu_si128((__m128i *)&ab->Samples[0][i], l);
+         _mm_storeu_si128((__m128i *)&ab->Samples[1][i], r);
+      }
+#elif defined(HAVE_CDC_NEON)
+      for(; i < 588 - 7; i += 8)
+      {
+         const int16x8x2_t lr = vld2q_s16((const int16 *)&buf[i * 4]);
+
+         vst1q_s16(&ab->Samples[0][i], lr.val[0]);
+         vst1q_s16(&ab->Samples[1][i], lr.val[1]);
+      }
+#endif
+
+      for(; i < 588; i++)
       {
          ab->Samples[0][i] = (int16)MDFN_de16lsb<false>(&buf[i * sizeof(int16) * 2 + 0]);
          ab->Samples[1][i] = (int16)MDFN_de16lsb<false>(&buf[i * sizeof(int16) * 2 + 2]);
@@ -890,6 +755,45 @@ void PS_CDC::EnbufferizeCDDASector(const uint8 *buf)
    ab->ReadPos = 0;
 }
 
+// How long adaptive fast-load keeps to native speed after the last sign of streaming.  MDEC is only busy while a
+// frame is being decoded, so this has to cover the gaps between the frames of a movie(a second at 2x covers even
+// 15fps ones several times over).
+#define FASTLOAD_HOLDOFF_SECTORS 150
+
+// Called once per sector read.  In adaptive fast-load mode, anything that paces itself by the rate sectors come in at
+// holds fast-loading off: CD-DA play, XA-ADPCM or CD-DA playback(the mode bits, or audio still left in the buffer)
+// and movies being decoded by the MDEC.
+void PS_CDC::UpdateFastloadHoldoff(void)
+{
+   if(!cd_fastload_adaptive)
+      return;
+
+   if((Mode & (MODE_CDDA | MODE_STRSND)) || DriveStatus == DS_PLAYING || AudioBuffer.ReadPos < AudioBuffer.Size || MDEC_Busy())
+      FastloadHoldoff = FASTLOAD_HOLDOFF_SECTORS;
+   else if(FastloadHoldoff)
+      FastloadHoldoff--;
+}
+
+// Sector rate, in multiples of the 1x rate.  The fast-load multiplier only applies to 2x mode.  The fixed 4x-14x
+// settings keep to native speed while MODE_CDDA or MODE_STRSND is set, except for the first sector after a
+// seek(seek_done), as they always have.  Adaptive mode also keeps to native speed for that one and during CD-DA Play,
+// and until FastloadHoldoff has run out.
+unsigned PS_CDC::ReadSpeedMul(bool seek_done)
+{
+   if(!(Mode & MODE_SPEED))
+      return 1;
+
+   if(cd_fastload_adaptive)
+   {
+      if((Mode & (MODE_CDDA | MODE_STRSND)) || DriveStatus == DS_PLAYING || FastloadHoldoff)
+         return 2;
+   }
+   else if(!seek_done && (Mode & (MODE_CDDA | MODE_STRSND)))
+      return 2;
+
+   return 2 * cd_2x_speedup;
+}
+
 void PS_CDC::HandlePlayRead(void)
 {
    uint8 read_buf[2352 + 96];
@@ -1028,7 +932,7 @@ void PS_CDC::HandlePlayRead(void)
                   }
                   else
                   {
-                     XA_ProcessSector(buf, &AudioBuffer);
+                     XA_DecodeSector(buf, &AudioBuffer, xa_previous);
                   }
                }
             }
@@ -1079,23 +983,11 @@ void PS_CDC::HandlePlayRead(void)
    SectorPipe_Pos = (SectorPipe_Pos + 1) % SectorPipe_Count;
    SectorPipe_In++;
 
-   unsigned speed_mul;
-
-   if (Mode & MODE_SPEED) {
-      // We're in 2x mode
-      if (Mode & (MODE_CDDA | MODE_STRSND)) {
-         // We're probably streaming audio to the CD drive, keep the
-         // native speed
-         speed_mul = 2;
-      } else {
-         // *Probably* not streaming audio, we can try increasing the
-         // *CD speed beyond native
-         speed_mul = 2 * cd_2x_speedup;
-      }
-   } else {
-      // 1x mode
-      speed_mul = 1;
-   }
+   UpdateFastloadHoldoff();
+
+   const unsigned speed_mul = ReadSpeedMul(false);
+
+   Cur_CDIF->HintReadSpeed(speed_mul);
 
    PSRCounter += 33868800 / (75 * speed_mul);
 
@@ -1141,6 +1033,10 @@ int32_t PS_CDC::Update(const int32_t timestamp)
       if(chunk_clocks > SPUCounter)
          chunk_clocks = SPUCounter;
 
+      // Sector reads and commands change what the SPU gets from the audio buffer.
+      if((PSRCounter > 0 && PSRCounter <= chunk_clocks) || (PendingCommandCounter > 0 && PendingCommandCounter <= chunk_clocks))
+         PSX_SPU->FlushSamples();
+
       if(DiscStartupDelay > 0)
       {
          if(chunk_clocks > DiscStartupDelay)
@@ -1209,7 +1105,7 @@ int32_t PS_CDC::Update(const int32_t timestamp)
                      DriveStatus = StatusAfterSeek;
 
                      if(DriveStatus != DS_PAUSED && DriveStatus != DS_STANDBY)
-                        PSRCounter = 33868800 / (75 * ((Mode & MODE_SPEED) ? (2 * cd_2x_speedup) : 1));
+                        PSRCounter = 33868800 / (75 * ReadSpeedMul(true));
                   }
                   break;
                case DS_SEEKING_LOGICAL:
@@ -1237,7 +1133,7 @@ int32_t PS_CDC::Update(const int32_t timestamp)
                         DriveStatus = StatusAfterSeek;
 
                         if(DriveStatus != DS_PAUSED && DriveStatus != DS_STANDBY)
-                           PSRCounter = 33868800 / (75 * ((Mode & MODE_SPEED) ? (2 * cd_2x_speedup) : 1));
+                           PSRCounter = 33868800 / (75 * ReadSpeedMul(true));
                      }
                   }
                   break;
@@ -1378,6 +1274,7 @@ void PS_CDC::Write(const int32_t timestamp, uint32 A, uint8 V)
       const unsigned reg_index = ((RegSelector & 0x3) * 3) + (A - 1);
 
       Update(timestamp);
+      PSX_SPU->FlushSamples();
       //PSX_WARNING("[CDC] Write to register 0x%02x: 0x%02x @ %d --- 0x%02x 0x%02x\n", reg_index, V, timestamp, DMABuffer.in_count, IRQBuffer);
 
       switch(reg_index)
@@ -1585,6 +1482,23 @@ uint32 PS_CDC::DMARead(void)
    return data;
 }
 
+// Copies up to max_words words of what DMARead() would return, in PS1(little-endian) byte order, to dest; stops short
+// of the first word that would underflow.  Returns the number of words copied.
+uint32 PS_CDC::DMAReadBulk(uint8 *dest, uint32 max_words)
+{
+   const uint32 words = std::min<uint32>(max_words, DMABuffer.in_count >> 2);
+   const uint32 count = words << 2;
+   const uint32 first = std::min<uint32>(count, DMABuffer.size - DMABuffer.read_pos);
+
+   memcpy(dest, &DMABuffer.data[DMABuffer.read_pos], first);
+   memcpy(dest + first, &DMABuffer.data[0], count - first);
+
+   DMABuffer.read_pos = (DMABuffer.read_pos + count) & (DMABuffer.size - 1);
+   DMABuffer.in_count -= count;
+
+   return words;
+}
+
 bool PS_CDC::CommandCheckDiscPresent(void)
 {
    if(!Cur_CDIF || DiscStartupDelay > 0)
@@ -1639,6 +1553,16 @@ int32 PS_CDC::CalcSeekTime(int32 initial, int32 target, bool motor_on, bool paus
 {
    int32 ret = 0;
 
+   // Adaptive fast-load seeks are as fast as the shortest real ones, while nothing is streaming.
+   if(cd_fastload_adaptive && ReadSpeedMul(false) > 2)
+   {
+      ret = 20000 + PSX_GetRandU32(0, 25000);
+
+      PSX_DBG(PSX_DBG_SPARSE, "[CDC] CalcSeekTime() %d->%d = %d\n", initial, target, ret);
+
+      return(ret);
+   }
+
    if(!motor_on)
    {
       initial = 0;
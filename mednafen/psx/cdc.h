@@ -35,6 +35,7 @@ class PS_CDC
 
       bool DMACanRead(void);
       uint32 DMARead(void);
+      uint32 DMAReadBulk(uint8 *dest, uint32 max_words);
       void SoftReset(void);
 
       void GetCDAudio(int32 samples[2], const unsigned freq);
@@ -164,6 +165,10 @@ class PS_CDC
 
       int32 CurSector;
       uint32 SectorsRead;	// Reset to 0 on Read*/Play command start; used in the rough simulation of PS1 SetLoc->Read->Pause->Read behavior.
+      uint32 FastloadHoldoff;	// Adaptive fast-load: sectors left to read at native speed since streaming was last seen.
+
+      void UpdateFastloadHoldoff(void);
+      unsigned ReadSpeedMul(bool seek_done);
 
       unsigned AsyncIRQPending;
       uint8 AsyncResultsPending[16];
@@ -196,7 +201,6 @@ class PS_CDC
 
       void EnbufferizeCDDASector(const uint8 *buf);
       bool XA_Test(const uint8 *sdata);
-      void XA_ProcessSector(const uint8 *sdata, CD_Audio_Buffer *ab);
       int16 xa_previous[2][2];
       bool xa_cur_set;
       uint8 xa_cur_file;
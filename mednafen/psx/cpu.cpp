@@ -34,6 +34,7 @@
 // int pgxpMode = PGXP_GetModes();
 
 extern bool psx_gte_overclock;
+extern enum cpu_idle_skip_mode psx_cpu_idle_skip;
 
 
 #if 0
@@ -81,6 +82,15 @@ PS_CPU::PS_CPU()
  CPUHook = NULL;
  ADDBT = NULL;
 
+ IdleSkipMode = CPU_IDLE_SKIP_DISABLED;
+ IdleBranchPC = ~0U;
+ IdleTargetPC = ~0U;
+ IdleSafe = false;
+ IdleCount = 0;
+ IdleInputs = 0;
+ IdleLastTS = 0;
+ IdleDelta = 0;
+
  GTE_Init();
 
  for(unsigned i = 0; i < 24; i++)
@@ -771,6 +781,9 @@ pscpu_timestamp_t PS_CPU::RunReal(pscpu_timestamp_t timestamp_in)
 	  new_PC = ((new_PC - 4) & mask) + offset;		\
 	  BDBT = 3;						\
      DEBUG_ADDBT() \
+								\
+	  if(!DebugMode && MDFN_UNLIKELY(IdleSkipMode) && new_PC <= old_PC)	\
+	   IdleCheck(timestamp, old_PC, new_PC);		\
 	 }							\
 								\
 	 goto SkipNPCStuff;					\
@@ -2656,6 +2669,10 @@ pscpu_timestamp_t PS_CPU::RunReal(pscpu_timestamp_t timestamp_in)
 
 pscpu_timestamp_t PS_CPU::Run(pscpu_timestamp_t timestamp_in, bool BIOSPrintMode, bool ILHMode)
 {
+ // Timestamps are reset every frame, so start idle loop detection over.
+ IdleSkipMode = psx_cpu_idle_skip;
+ IdleBranchPC = ~0U;
+
  if(CPUHook || ADDBT)
   return(RunReal<true, true, false>(timestamp_in));
 #ifdef DEBUG
@@ -2667,6 +2684,329 @@ pscpu_timestamp_t PS_CPU::Run(pscpu_timestamp_t timestamp_in, bool BIOSPrintMode
  return(RunReal<false, false, false>(timestamp_in));
 }
 
+//
+// Idle loop skipping
+//
+// A loop qualifies if it's at most IDLE_MAX_INSTS instructions long, contains nothing but loads and simple ALU instructions besides
+// its non-linking backward branch, and every register it reads is either left alone by the loop or written earlier in the same
+// iteration; each iteration then computes exactly the same thing as long as the memory it reads doesn't change.  Loads must be from
+// main RAM, BIOS ROM, the scratchpad, the interrupt controller registers, or the GPU status register, none of which have read side
+// effects or change other than during event processing(DMA, IRQs, GPU updates).
+//
+// The loop must also have taken the same number of cycles for two iterations in a row.  CPU_IDLE_SKIP_ACCURATE then advances by a
+// whole number of iterations, leaving the one the next event lands in to run normally, so the result is identical to not skipping.
+// CPU_IDLE_SKIP_FAST jumps straight to the next event, which can be off by part of an iteration.
+//
+enum
+{
+ IDLE_OP_BAD = 0,
+ IDLE_OP_ALU,
+ IDLE_OP_LOAD,
+ IDLE_OP_BRANCH
+};
+
+static INLINE unsigned IdleDecode(uint32 instr, uint32 *srcs, unsigned *dest, unsigned *size)
+{
+ const unsigned rs = (instr >> 21) & 0x1F;
+ const unsigned rt = (instr >> 16) & 0x1F;
+ const unsigned rd = (instr >> 11) & 0x1F;
+ uint32 opf = instr & 0x3F;
+
+ if(instr & (0x3F << 26))
+  opf = 0x40 | (instr >> 26);
+
+ *srcs = 0;
+ *dest = 0;
+
+ switch(opf)
+ {
+  case 0x00: case 0x02: case 0x03:	// SLL, SRL, SRA
+	*srcs = 1U << rt;
+	*dest = rd;
+	return IDLE_OP_ALU;
+
+  case 0x04: case 0x06: case 0x07:	// SLLV, SRLV, SRAV
+  case 0x21: case 0x23:			// ADDU, SUBU
+  case 0x24: case 0x25: case 0x26: case 0x27:	// AND, OR, XOR, NOR
+  case 0x2A: case 0x2B:			// SLT, SLTU
+	*srcs = (1U << rs) | (1U << rt);
+	*dest = rd;
+	return IDLE_OP_ALU;
+
+  case 0x49: case 0x4A: case 0x4B:	// ADDIU, SLTI, SLTIU
+  case 0x4C: case 0x4D: case 0x4E:	// ANDI, ORI, XORI
+	*srcs = 1U << rs;
+	*dest = rt;
+	return IDLE_OP_ALU;
+
+  case 0x4F:				// LUI
+	*dest = rt;
+	return IDLE_OP_ALU;
+
+  case 0x60: case 0x64: *size = 1; goto Load;	// LB, LBU
+  case 0x61: case 0x65: *size = 2; goto Load;	// LH, LHU
+  case 0x63: *size = 4;				// LW
+	Load:;
+	*srcs = 1U << rs;
+	*dest = rt;
+	return IDLE_OP_LOAD;
+
+  case 0x41:				// BCOND(without link)
+	if((rt & 0x1E) == 0x10)
+	 return IDLE_OP_BAD;
+	*srcs = 1U << rs;
+	return IDLE_OP_BRANCH;
+
+  case 0x44: case 0x45:			// BEQ, BNE
+	*srcs = (1U << rs) | (1U << rt);
+	return IDLE_OP_BRANCH;
+
+  case 0x46: case 0x47:			// BLEZ, BGTZ
+	*srcs = 1U << rs;
+	return IDLE_OP_BRANCH;
+
+  case 0x42:				// J
+	return IDLE_OP_BRANCH;
+ }
+
+ return IDLE_OP_BAD;
+}
+
+static INLINE uint32 IdleEval(uint32 instr, uint32 a, uint32 b)
+{
+ const uint32 shamt = (instr >> 6) & 0x1F;
+ const uint32 immediate = (int32)(int16)(instr & 0xFFFF);
+ uint32 opf = instr & 0x3F;
+
+ if(instr & (0x3F << 26))
+  opf = 0x40 | (instr >> 26);
+
+ switch(opf)
+ {
+  case 0x00: return b << shamt;
+  case 0x02: return b >> shamt;
+  case 0x03: return (int32)b >> shamt;
+  case 0x04: return b << (a & 0x1F);
+  case 0x06: return b >> (a & 0x1F);
+  case 0x07: return (int32)b >> (a & 0x1F);
+  case 0x21: return a + b;
+  case 0x23: return a - b;
+  case 0x24: return a & b;
+  case 0x25: return a | b;
+  case 0x26: return a ^ b;
+  case 0x27: return ~(a | b);
+  case 0x2A: return (int32)a < (int32)b;
+  case 0x2B: return a < b;
+  case 0x49: return a + immediate;
+  case 0x4A: return (int32)a < (int32)immediate;
+  case 0x4B: return a < immediate;
+  case 0x4C: return a & (instr & 0xFFFF);
+  case 0x4D: return a | (instr & 0xFFFF);
+  case 0x4E: return a ^ (instr & 0xFFFF);
+  case 0x4F: return instr << 16;
+ }
+
+ return 0;
+}
+
+// Main RAM and BIOS ROM, the only places idle loops are looked for.
+INLINE bool PS_CPU::IdleIsCodeAddress(uint32 addr)
+{
+ const uint32 pa = addr & addr_mask[addr >> 29];
+
+ return pa < 0x00800000 || (pa >= 0x1FC00000 && pa < 0x1FC80000);
+}
+
+// Same instruction word ReadInstruction() would return, without the side effects.
+INLINE uint32 PS_CPU::IdlePeekInstruction(uint32 PC)
+{
+ if(ICache[(PC & 0xFFC) >> 2].TV == PC)
+  return ICache[(PC & 0xFFC) >> 2].Data;
+
+ return MDFN_de32lsb<true>((uint8*)(FastMap[PC >> FAST_MAP_SHIFT] + PC));
+}
+
+bool PS_CPU::IdleLoopIsSafe(uint32 branch_PC, uint32 target_PC)
+{
+ const unsigned count = ((branch_PC - target_PC) >> 2) + 2;
+ uint32 *instrs = IdleInstrs;
+ uint32 written = 0;
+ uint32 inputs = 0;
+ uint32 defined = 0;
+ uint32 known;
+ uint32 pending = 0;
+ uint32 values[32];
+
+ if(count > IDLE_MAX_INSTS || (CP0.SR & 0x10000))
+  return false;
+
+ for(unsigned i = 0; i < count; i++)
+ {
+  const uint32 addr = target_PC + (i << 2);
+  uint32 srcs;
+  unsigned dest, size;
+  unsigned type;
+
+  if(!IdleIsCodeAddress(addr))
+   return false;
+
+  instrs[i] = IdlePeekInstruction(addr);
+  type = IdleDecode(instrs[i], &srcs, &dest, &size);
+
+  if(type == IDLE_OP_BAD || ((type == IDLE_OP_BRANCH) != (i == (count - 2))))
+   return false;
+
+  written |= 1U << dest;
+  inputs |= srcs;
+ }
+
+ written &= ~1U;
+ known = ~written;
+
+ for(unsigned i = 0; i < 32; i++)
+  values[i] = GPR[i];
+
+ values[0] = 0;
+
+ //
+ // Walk one iteration in order, making sure nothing depends on the previous iteration, and evaluating what we can to find
+ // the load addresses.
+ //
+ for(unsigned i = 0; i < count; i++)
+ {
+  const uint32 instr = instrs[i];
+  const unsigned rs = (instr >> 21) & 0x1F;
+  const unsigned rt = (instr >> 16) & 0x1F;
+  uint32 srcs;
+  unsigned dest, size;
+  unsigned type;
+
+  type = IdleDecode(instr, &srcs, &dest, &size);
+
+  if(srcs & written & ~defined)
+   return false;
+
+  // Load results only become visible after the instruction following the load.
+  defined |= pending;
+  pending = 0;
+
+  if(type == IDLE_OP_LOAD)
+  {
+   uint32 address, pa;
+
+   if(!(known & (1U << rs)))
+    return false;
+
+   address = values[rs] + (int32)(int16)(instr & 0xFFFF);
+
+   if(address & (size - 1))
+    return false;
+
+   pa = address & addr_mask[address >> 29];
+
+   if(!(pa < 0x00800000 ||
+	(pa >= 0x1FC00000 && pa <= 0x1FC7FFFF) ||
+	(pa >= 0x1F800000 && pa <= 0x1F8003FF) ||
+	(pa >= 0x1F801070 && pa <= 0x1F801077) ||
+	(pa >= 0x1F801814 && pa <= 0x1F801817)))
+    return false;
+
+   pending = 1U << dest;
+   known &= ~(1U << dest);
+  }
+  else if(type == IDLE_OP_ALU)
+  {
+   defined |= 1U << dest;
+
+   if((srcs & known) == srcs)
+   {
+    values[dest] = IdleEval(instr, values[rs], values[rt]);
+    known |= 1U << dest;
+   }
+   else
+    known &= ~(1U << dest);
+  }
+
+  values[0] = 0;
+  known |= 1;
+ }
+
+ IdleCount = count;
+ IdleInputs = inputs & ~written & ~1U;
+
+ for(unsigned i = 0; i < 32; i++)
+  IdleInputValues[i] = GPR[i];
+
+ return true;
+}
+
+// Cheap recheck that nothing IdleLoopIsSafe() based its verdict on has changed.
+INLINE bool PS_CPU::IdleLoopUnchanged(void)
+{
+ if(CP0.SR & 0x10000)
+  return false;
+
+ for(unsigned i = 0; i < IdleCount; i++)
+ {
+  if(IdlePeekInstruction(IdleTargetPC + (i << 2)) != IdleInstrs[i])
+   return false;
+ }
+
+ for(unsigned i = 1; i < 32; i++)
+ {
+  if((IdleInputs & (1U << i)) && GPR[i] != IdleInputValues[i])
+   return false;
+ }
+
+ return true;
+}
+
+NO_INLINE void PS_CPU::IdleCheck(pscpu_timestamp_t &timestamp, uint32 branch_PC, uint32 target_PC)
+{
+ pscpu_timestamp_t new_ts;
+ int32 delta;
+
+ if(branch_PC != IdleBranchPC || target_PC != IdleTargetPC)
+ {
+  IdleBranchPC = branch_PC;
+  IdleTargetPC = target_PC;
+  IdleSafe = IdleLoopIsSafe(branch_PC, target_PC);
+  IdleLastTS = timestamp;
+  IdleDelta = 0;
+  return;
+ }
+
+ if(!IdleSafe)
+  return;
+
+ delta = timestamp - IdleLastTS;
+ IdleLastTS = timestamp;
+
+ if(delta != IdleDelta)
+ {
+  IdleDelta = delta;
+  return;
+ }
+
+ if(IdleSkipMode == CPU_IDLE_SKIP_FAST)
+  new_ts = next_event_ts;
+ else
+  new_ts = timestamp + ((next_event_ts - timestamp) / delta - 1) * delta;
+
+ if(new_ts <= timestamp)
+  return;
+
+ // Registers the loads are based on, or the code itself, may have changed since the loop was first examined.
+ if(!IdleLoopUnchanged() && !IdleLoopIsSafe(branch_PC, target_PC))
+ {
+  IdleSafe = false;
+  return;
+ }
+
+ timestamp = new_ts;
+ IdleLastTS = timestamp;
+}
+
 void PS_CPU::SetCPUHook(void (*cpuh)(const pscpu_timestamp_t timestamp, uint32 pc), void (*addbt)(uint32 from, uint32 to, bool exception))
 {
  ADDBT = addbt;
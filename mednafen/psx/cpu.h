@@ -61,6 +61,13 @@
 
 #include "gte.h"
 
+enum cpu_idle_skip_mode
+{
+ CPU_IDLE_SKIP_DISABLED = 0,
+ CPU_IDLE_SKIP_ACCURATE,
+ CPU_IDLE_SKIP_FAST
+};
+
 #if NOT_LIBRETRO
 namespace MDFN_IEN_PSX
 {
@@ -231,6 +238,29 @@ class PS_CPU
 
  uint32 ReadInstruction(pscpu_timestamp_t &timestamp, uint32 address);
 
+ //
+ // Idle loop skipping.  Short loops that just poll memory or I/O registers(waiting on VSync, DMA, the CD, etc.) are detected at
+ // their backward branch, and the timestamp is advanced toward the next event instead of spinning through every iteration.
+ //
+ enum { IDLE_MAX_INSTS = 8 };	// Including the branch delay slot.
+
+ unsigned IdleSkipMode;
+ uint32 IdleBranchPC;
+ uint32 IdleTargetPC;
+ bool IdleSafe;
+ unsigned IdleCount;
+ uint32 IdleInstrs[IDLE_MAX_INSTS];
+ uint32 IdleInputs;		// Registers read by the loop but not written by it.
+ uint32 IdleInputValues[32];
+ pscpu_timestamp_t IdleLastTS;
+ int32 IdleDelta;
+
+ INLINE bool IdleIsCodeAddress(uint32 addr);
+ INLINE uint32 IdlePeekInstruction(uint32 PC);
+ bool IdleLoopIsSafe(uint32 branch_PC, uint32 target_PC);
+ INLINE bool IdleLoopUnchanged(void);
+ NO_INLINE void IdleCheck(pscpu_timestamp_t &timestamp, uint32 branch_PC, uint32 target_PC);
+
  //
  // Mednafen debugger stuff follows:
  //
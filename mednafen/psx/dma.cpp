@@ -419,6 +419,28 @@ static INLINE void RunChannel(int32_t timestamp, int32_t clocks, int ch)
             DMACH[ch].WordCounter = DMACH[ch].BlockControl & 0xFFFF;
          }
 
+         // CDC to RAM in burst mode: copy as many words as the clocks left cover in one go, each at the same cost
+         // ChRW() and the per-word path below would charge.
+         if(ch == CH_CDC && !(CRModeCache & 0x703) && !(DMACH[ch].CurAddr & 0x800000))
+         {
+            const uint32_t addr = DMACH[ch].CurAddr & 0x1FFFFC;
+            uint32_t words = std::min<uint32_t>(DMACH[ch].WordCounter, (DMACH[ch].ClockCounter + 8) / 9);
+
+            words = std::min<uint32_t>(words, (0x200000 - addr) >> 2);
+            words = PSX_CDC->DMAReadBulk(&MainRAM.data8[addr], words);
+
+            if(words)
+            {
+               StateDirty_MarkRange(&MainRAM_Dirty, addr, words << 2);
+
+               DMACH[ch].CurAddr = (DMACH[ch].CurAddr + (words << 2)) & 0xFFFFFF;
+               DMACH[ch].WordCounter -= words;
+               DMACH[ch].ClockCounter -= (int32_t)(words * 9);
+
+               goto SkipPayloadStuff;
+            }
+         }
+
          // Do the payload read/write
          {
             uint32_t vtmp;
@@ -439,7 +461,10 @@ static INLINE void RunChannel(int32_t timestamp, int32_t clocks, int ch)
             ChRW(ch, CRModeCache, DMACH[ch].CurAddr, &vtmp, &voffs);
 
             if(!(CRModeCache & 0x1))
+            {
+               StateDirty_Mark(&MainRAM_Dirty, (DMACH[ch].CurAddr + (voffs << 2)) & 0x1FFFFC);
                MainRAM.WriteU32((DMACH[ch].CurAddr + (voffs << 2)) & 0x1FFFFC, vtmp);
+            }
          }
 
          if(CRModeCache & 0x2)
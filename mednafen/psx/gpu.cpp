@@ -67,14 +67,6 @@
    Vertical start and end can be changed during active display, with effect(though it needs to be vs0->ve0->vs1->ve1->..., vs0->vs1->ve0 doesn't apparently do anything
    different from vs0->ve0.
    */
-static const int8 dither_table[4][4] =
-{
-   { -4,  0, -3,  1 },
-   {  2, -2,  3, -1 },
-   { -3,  1, -4,  0 },
-   {  3, -1,  2, -2 },
-};
-
 static FastFIFO<uint32, 0x20> GPU_BlitterFIFO; // 0x10 on an actual PS1 GPU, 0x20 here (see comment at top of gpu.h)
 
 struct CTEntry
@@ -97,6 +89,7 @@ static INLINE void InvalidateTexCache(PS_GPU *gpu)
    unsigned i;
    for (i = 0; i < 256; i++)
       gpu->TexCache[i].Tag = ~0U;
+   gpu->TexCacheGen++;
 }
 
 static INLINE void InvalidateCache(PS_GPU *gpu)
@@ -105,6 +98,8 @@ static INLINE void InvalidateCache(PS_GPU *gpu)
    InvalidateTexCache(gpu);
 }
 
+#include "gpu_threads.cpp"
+
 static void SetTPage(PS_GPU *gpu, const uint32_t cmdw)
 {
    const unsigned NewTexPageX = (cmdw & 0xF) * 64;
@@ -173,6 +168,9 @@ static void Command_FBFill(PS_GPU* gpu, const uint32 *cb)
    int32_t height            = (cb[2] >> 16) & 0x1FF;
 
    //printf("[GPU] FB Fill %d:%d w=%d, h=%d\n", destX, destY, width, height);
+   RasterQueue_Sync();
+   MarkVRAMLines(destY, destY + height - 1);
+
    gpu->DrawTimeAvail       -= 46; // Approximate
 
    for(y = 0; y < height; y++)
@@ -213,6 +211,8 @@ static void Command_FBCopy(PS_GPU* g, const uint32 *cb)
       height = 0x200;
 
    InvalidateTexCache(g);
+   RasterQueue_Sync();
+   MarkVRAMLines(destY, destY + height - 1);
    //printf("FB Copy: %d %d %d %d %d %d\n", sourceX, sourceY, destX, destY, width, height);
 
    g->DrawTimeAvail -= (width * height) * 2;
@@ -269,6 +269,7 @@ static void Command_FBWrite(PS_GPU* g, const uint32 *cb)
    g->FBRW_CurY = g->FBRW_Y;
 
    InvalidateTexCache(g);
+   RasterQueue_Sync();
 
    if(g->FBRW_W != 0 && g->FBRW_H != 0)
       g->InCmd = INCMD_FBWRITE;
@@ -298,6 +299,7 @@ static void Command_FBRead(PS_GPU* g, const uint32 *cb)
    g->FBRW_CurY = g->FBRW_Y;
 
    InvalidateTexCache(g);
+   RasterQueue_Sync();
 
    if(g->FBRW_W != 0 && g->FBRW_H != 0)
       g->InCmd = INCMD_FBREAD;
@@ -311,6 +313,8 @@ static void Command_FBRead(PS_GPU* g, const uint32 *cb)
                g->FBRW_W, g->FBRW_H,
                g->vram);
 
+       MarkVRAMLines(g->FBRW_Y, g->FBRW_Y + g->FBRW_H - 1);
+
        //if (!supported)
        //    fprintf(stderr, "Game is trying to reading back from VRAM, but SW rendering is not enabled, and RSX backend does not support it.\n");
    }
@@ -661,6 +665,11 @@ void GPU_Init(bool pal_clock_and_tv,
    GPU.dither_upscale_shift = 0;
 
    GPU.killQuadPart = 0;
+
+   memset(GPU.RasterRows, 1, sizeof(GPU.RasterRows));
+
+   Span_Init();
+   StateDirty_Init(&VRAM_Dirty, 1024 * 512 * sizeof(uint16));
 }
 
 void GPU_RecalcClockRatio(void) {
@@ -674,6 +683,7 @@ void GPU_RecalcClockRatio(void) {
 
 void GPU_Destroy(void)
 {
+   RasterQueue_Stop();
    delete [] GPU.vram;
 }
 
@@ -687,6 +697,8 @@ void GPU_Destroy(void)
  */
 void GPU_Rescale(uint8 ushift)
 {
+   RasterQueue_Sync();
+
    if (GPU.upscale_shift == 0) 
    {
       /* VRAM is already at 1x, make the buffer point to the old VRAM
@@ -730,6 +742,9 @@ void GPU_Rescale(uint8 ushift)
    if (vram_new)
       delete [] vram_new;
    vram_new = NULL;
+
+   StateDirty_MarkAll(&VRAM_Dirty);
+   RasterQueue_PutVRAM();
 }
 
 void GPU_FillVideoParams(MDFNGI* gi)
@@ -845,7 +860,9 @@ void GPU_SoftReset(void) // Control command 0x00
 
 void GPU_Power(void)
 {
+   RasterQueue_Sync();
    memset(GPU.vram, 0, 512 * 1024 * UPSCALE(&GPU) * UPSCALE(&GPU) * sizeof(*GPU.vram));
+   StateDirty_MarkAll(&VRAM_Dirty);
 
    memset(GPU.CLUT_Cache, 0, sizeof(GPU.CLUT_Cache));
    GPU.CLUT_Cache_VB = ~0U;
@@ -938,6 +955,7 @@ void GPU_Power(void)
    GPU.lastts = 0;
 
    GPU_SoftReset();
+   RasterQueue_PutCaches();
 
    IRQ_Assert(IRQ_VBLANK, GPU.InVBlank);
    TIMER_SetVBlank(GPU.InVBlank);
@@ -976,7 +994,10 @@ static void ProcessFIFO(uint32_t in_count)
                 fetch = texel_fetch(&GPU, GPU.FBRW_CurX & 1023, GPU.FBRW_CurY & 511) & GPU.MaskEvalAND;
 
             if (!fetch)
+            {
+               StateDirty_Mark(&VRAM_Dirty, (GPU.FBRW_CurY & 511) << 11);
                texel_put(GPU.FBRW_CurX & 1023, GPU.FBRW_CurY & 511, InData | GPU.MaskSetOR);
+            }
 
             GPU.FBRW_CurX++;
             if(GPU.FBRW_CurX == (GPU.FBRW_X + GPU.FBRW_W))
@@ -1658,6 +1679,10 @@ int32_t GPU_Update(const int32_t sys_timestamp)
 
                if (rsx_intf_is_type() == RSX_SOFTWARE)
                {
+                  if (dx_end > dx_start)
+                     RasterQueue_SyncRect(fb_x >> 1, GPU.DisplayFB_CurLineYReadout,
+                           (((dx_end - dx_start) * ((GPU.DisplayMode & DISP_RGB24) ? 3 : 2)) >> 1) + 1, 1);
+
                   // Convert the necessary variables to the upscaled version
                   uint32_t x;
                   uint32_t y        = GPU.DisplayFB_CurLineYReadout << GPU.upscale_shift;
@@ -1750,6 +1775,8 @@ TheEnd:
 
 void GPU_StartFrame(EmulateSpecStruct *espec_arg)
 {
+   RasterQueue_Configure();
+
    GPU.sl_zero_reached = false;
    GPU.espec           = espec_arg;
    GPU.surface         = GPU.espec->surface;
@@ -1798,9 +1825,13 @@ void GPU_RestoreStateP2(bool load)
    {
       if (load)
       {
-         // Restore upscaled VRAM from savestate
+         // Restore upscaled VRAM from savestate, only the lines that were
+         // loaded with an incremental savestate
          for (unsigned y = 0; y < 512; y++)
          {
+            if (!StateDirty_Loaded(&VRAM_Dirty, y))
+               continue;
+
             for (unsigned x = 0; x < 1024; x++)
                texel_put(x, y, vram_new[y * 1024 + x]);
          }
@@ -1822,6 +1853,7 @@ void GPU_RestoreStateP3(void)
    }
    RecalcTexWindowStuff(&GPU);
    rsx_intf_set_tex_window(GPU.tww, GPU.twh, GPU.twx, GPU.twy);
+   RasterQueue_PutCaches();
 
    GPU_BlitterFIFO.SaveStatePostLoad();
 
@@ -1859,13 +1891,15 @@ void GPU_RestoreStateP3(void)
 
 int GPU_StateAction(StateMem *sm, int load, int data_only)
 {
-   GPU_RestoreStateP1(load);
+   RasterQueue_GetCaches();
+   // No need to downscale VRAM when only measuring the state(see MDFNSS_SaveSize())
+   GPU_RestoreStateP1(load || !sm->data);
 
    SFORMAT StateRegs[] =
    {
       // Hardcode entry name to remain backward compatible with the
       // previous fixed internal resolution code
-      SFARRAY16N(vram_new, 1024 * 512, "&GPURAM[0][0]"),
+      SFARRAY16DIRTYN(vram_new, 1024 * 512, "&GPURAM[0][0]", &VRAM_Dirty),
 
       SFVARN(GPU.DMAControl, "DMAControl"),
 
@@ -2004,7 +2038,9 @@ unsigned GPU_get_display_change_count(void)
 
 void GPU_set_dither_upscale_shift(uint8 factor)
 {
+   RasterQueue_Sync();
    GPU.dither_upscale_shift = factor;
+   RasterQueue_PutVRAM();
 }
 
 uint8 GPU_get_dither_upscale_shift(void)
@@ -2029,16 +2065,20 @@ bool GPU_DMACanWrite(void)
 
 uint16 *GPU_get_vram(void)
 {
+   RasterQueue_Sync();
    return GPU.vram;
 }
 
 uint16 GPU_PeekRAM(uint32 A)
 {
+   RasterQueue_Sync();
    return texel_fetch(&GPU, A & 0x3FF, (A >> 10) & 0x1FF);
 }
 
 void GPU_PokeRAM(uint32 A, uint16 V)
 {
+   RasterQueue_Sync();
+   StateDirty_Mark(&VRAM_Dirty, ((A >> 10) & 0x1FF) << 11);
    texel_put(A & 0x3FF, (A >> 10) & 0x1FF, V);
 }
 
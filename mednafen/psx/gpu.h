@@ -219,6 +219,12 @@ struct PS_GPU
 
    uint8_t DitherLUT[4][4][512]; // Y, X, 8-bit source value(256 extra for saturation)
 
+   // Software rasterizer threading(see gpu_threads.cpp); non-zero RasterRows entries mark the
+   // VRAM lines this PS_GPU's rasterizers draw.
+   uint8 RasterRows[512];
+   bool RasterQueued;
+   uint32 TexCacheGen;
+
    /*
    VRAM has to be a ptr type or else we have to rely on smartcode void* shenanigans to
    wrestle a variable-sized struct.
@@ -281,6 +287,13 @@ void GPU_PokeRAM(uint32 A, uint16 V);
 
 int32_t GPU_GetScanlineNum(void);
 
+/* Number of threads the software rasterizer hands its pixel work to,
+ * 0 to rasterize on the emulation thread; applied at the next frame. */
+void GPU_SetRasterThreads(unsigned count);
+
+/* Waits until all queued primitives have been drawn to VRAM */
+void GPU_RasterSync(void);
+
 void texel_put(uint32 x, uint32 y, uint16 v);
 
 #endif
@@ -13,6 +13,44 @@ extern enum dither_mode psx_gpu_dither_mode;
 
 #define UPSCALE(gpu)          (1U << (gpu)->upscale_shift)
 
+static const int8 dither_table[4][4] =
+{
+   { -4,  0, -3,  1 },
+   {  2, -2,  3, -1 },
+   { -3,  1, -4,  0 },
+   {  3, -1,  2, -2 },
+};
+
+/* Native VRAM lines written since the last savestate, see StateDirty */
+static StateDirty VRAM_Dirty;
+
+/* Marks native VRAM lines y0 to y1, wrapping around */
+static INLINE void MarkVRAMLines(int32 y0, int32 y1)
+{
+   if(y1 - y0 >= 511)
+      StateDirty_MarkAll(&VRAM_Dirty);
+   else
+   {
+      for(int32 y = y0; y <= y1; y++)
+         StateDirty_Mark(&VRAM_Dirty, (y & 511) << 11);
+   }
+}
+
+/* Whether this PS_GPU draws VRAM line y(native coordinates) */
+#define RasterRowEnabled(gpu, y) ((gpu)->RasterRows[(y) & 511])
+
+/* Queueing of primitives to the raster threads, see gpu_threads.cpp */
+typedef void (*RasterTriangleFunc)(PS_GPU *gpu, tri_vertex *vertices);
+typedef void (*RasterSpriteFunc)(PS_GPU *gpu, int32_t x, int32_t y, int32_t w, int32_t h,
+      uint8_t u, uint8_t v, uint32_t color, uint32_t clut_offset);
+typedef void (*RasterLineFunc)(PS_GPU *gpu, line_point *points);
+
+static void RasterQueue_CLUT(PS_GPU *g, uint16 raw_clut, uint32 count);
+static void RasterQueue_Triangle(PS_GPU *g, RasterTriangleFunc func, const tri_vertex *vertices, int TexMode);
+static void RasterQueue_Sprite(PS_GPU *g, RasterSpriteFunc func, int32_t x, int32_t y, int32_t w, int32_t h,
+      uint8_t u, uint8_t v, uint32_t color, uint32_t clut, int TexMode);
+static void RasterQueue_Line(PS_GPU *g, RasterLineFunc func, const line_point *points);
+
 template<int BlendMode>
 static INLINE void PlotPixelBlend(uint16_t bg_pix, uint16_t *fore_pix)
 {
@@ -109,6 +147,20 @@ static INLINE void PlotNativePixel(PS_GPU *gpu, int32_t x, int32_t y, uint16_t f
 
 #define ModTexel(dither_offset, texel, r, g, b) ((texel & 0x8000) | (dither_offset[(((texel & 0x1F)  * (r))   >> (5 - 1))] << 0) | (dither_offset[(((texel & 0x3E0)  * (g))  >> (10 - 1))] << 5) | (dither_offset[(((texel & 0x7C00) * (b)) >> (15 - 1))] << 10))
 
+static INLINE void Load_CLUT_Cache(PS_GPU *g, uint16 raw_clut, uint32 count)
+{
+   uint16_t y = (raw_clut >> 6) & 0x1FF;
+
+   //uint16* const gpulp = GPURAM[(raw_clut >> 6) & 0x1FF];
+   const uint32 cxo = (raw_clut & 0x3F) << 4;
+
+   for(unsigned i = 0; i < count; i++)
+   {
+      uint16_t x = (cxo + i) & 0x3FF;
+      g->CLUT_Cache[i] = texel_fetch(g, x, y);
+   }
+}
+
 template<uint32 TexMode_TA>
 static INLINE void Update_CLUT_Cache(PS_GPU *g, uint16 raw_clut)
 {
@@ -118,19 +170,14 @@ static INLINE void Update_CLUT_Cache(PS_GPU *g, uint16 raw_clut)
 
   if(g->CLUT_Cache_VB != new_ccvb)
   {
-     uint16_t y = (raw_clut >> 6) & 0x1FF;
-
-     //uint16* const gpulp = GPURAM[(raw_clut >> 6) & 0x1FF];
-     const uint32 cxo = (raw_clut & 0x3F) << 4;
      const uint32 count = (TexMode_TA ? 256 : 16);
 
      g->DrawTimeAvail -= count;
 
-     for(unsigned i = 0; i < count; i++)
-        {
-           uint16_t x = (cxo + i) & 0x3FF;
-           g->CLUT_Cache[i] = texel_fetch(g, x, y);
-        }
+     if(g->RasterQueued)
+        RasterQueue_CLUT(g, raw_clut, count);
+     else
+        Load_CLUT_Cache(g, raw_clut, count);
 
    g->CLUT_Cache_VB = new_ccvb;
   }
@@ -181,6 +228,19 @@ struct TexCache_t
       uint32 Tag;
 };
 
+template<uint32_t TexMode_TA>
+static INLINE PS_GPU::TexCache_t *GetTexCacheEntry(PS_GPU *g, uint32_t gro)
+{
+     PS_GPU::TexCache_t *TexCache = &g->TexCache[0];
+
+     switch(TexMode_TA)
+     {
+      case 0: return &TexCache[((gro >> 2) & 0x3) | ((gro >> 8) & 0xFC)];	// 64x64
+      case 1: return &TexCache[((gro >> 2) & 0x7) | ((gro >> 7) & 0xF8)];	// 64x32 (NOT 32x64!)
+      default: return &TexCache[((gro >> 2) & 0x7) | ((gro >> 7) & 0xF8)];	// 32x32
+     }
+}
+
 template<uint32_t TexMode_TA>
 static INLINE uint16_t GetTexel(PS_GPU *g, int32_t u_arg, int32_t v_arg)
 {
@@ -193,15 +253,7 @@ static INLINE uint16_t GetTexel(PS_GPU *g, int32_t u_arg, int32_t v_arg)
      uint32_t fbtex_y = (v_arg & g->SUCV.TWY_AND) + g->SUCV.TWY_ADD;
      uint32_t gro = fbtex_y * 1024U + fbtex_x;
 
-     PS_GPU::TexCache_t *TexCache = &g->TexCache[0];
-     PS_GPU::TexCache_t *c = NULL;
-
-     switch(TexMode_TA)
-     {
-      case 0: c = &TexCache[((gro >> 2) & 0x3) | ((gro >> 8) & 0xFC)]; break;	// 64x64
-      case 1: c = &TexCache[((gro >> 2) & 0x7) | ((gro >> 7) & 0xF8)]; break;	// 64x32 (NOT 32x64!)
-      case 2: c = &TexCache[((gro >> 2) & 0x7) | ((gro >> 7) & 0xF8)]; break;	// 32x32
-     }
+     PS_GPU::TexCache_t *c = GetTexCacheEntry<TexMode_TA>(g, gro);
 
      if(MDFN_UNLIKELY(c->Tag != (gro &~ 0x3)))
      {
@@ -236,6 +288,25 @@ static INLINE uint16_t GetTexel(PS_GPU *g, int32_t u_arg, int32_t v_arg)
      return(fbw);
 }
 
+/* The texture cache lookup GetTexel() does, tags only.  When the raster threads fetch the texels, the emulation
+ * thread runs this in their place so that cache misses are charged to DrawTimeAvail exactly as when it draws itself. */
+template<uint32_t TexMode_TA>
+static INLINE void TouchTexel(PS_GPU *g, int32_t u_arg, int32_t v_arg)
+{
+     uint32_t u_ext = ((u_arg & g->SUCV.TWX_AND) + g->SUCV.TWX_ADD);
+     uint32_t fbtex_x = ((u_ext >> (2 - TexMode_TA))) & 1023;
+     uint32_t fbtex_y = (v_arg & g->SUCV.TWY_AND) + g->SUCV.TWY_ADD;
+     uint32_t gro = fbtex_y * 1024U + fbtex_x;
+
+     PS_GPU::TexCache_t *c = GetTexCacheEntry<TexMode_TA>(g, gro);
+
+     if(MDFN_UNLIKELY(c->Tag != (gro &~ 0x3)))
+     {
+      g->DrawTimeAvail -= 4;
+      c->Tag = (gro &~ 0x3);
+     }
+}
+
 static INLINE bool LineSkipTest(PS_GPU* g, unsigned y)
 {
    if((g->DisplayMode & 0x24) != 0x24)
@@ -154,7 +154,7 @@ static void DrawLine(PS_GPU *gpu, line_point *points)
          }
 
          // FIXME: There has to be a faster way than checking for being inside the drawing area for each pixel.
-         if(x >= gpu->ClipX0 && x <= gpu->ClipX1 && y >= gpu->ClipY0 && y <= gpu->ClipY1)
+         if(x >= gpu->ClipX0 && x <= gpu->ClipX1 && y >= gpu->ClipY0 && y <= gpu->ClipY1 && RasterRowEnabled(gpu, y))
             PlotNativePixel<BlendMode, MaskEval_TA, false>(gpu, x, y, pix);
       }
 
@@ -240,5 +240,17 @@ static void Command_DrawLine(PS_GPU *gpu, const uint32_t *cb)
 #endif
 
    if (rsx_intf_has_software_renderer())
+   {
+      // DrawLine() wraps y at 2048
+      const int32 y0 = std::min(points[0].y, points[1].y) & 2047;
+      const int32 y1 = y0 + delta_y;
+
+      MarkVRAMLines(std::max<int32>(y0, gpu->ClipY0), std::min<int32>(y1, gpu->ClipY1));
+      MarkVRAMLines(std::max<int32>(y0 - 2048, gpu->ClipY0), std::min<int32>(y1 - 2048, gpu->ClipY1));
+
+      if (gpu->RasterQueued)
+         RasterQueue_Line(gpu, DrawLine<goraud, BlendMode, MaskEval_TA>, points);
+
       DrawLine<goraud, BlendMode, MaskEval_TA>(gpu, points);
+   }
 }
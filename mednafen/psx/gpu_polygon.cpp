@@ -115,6 +115,8 @@ static INLINE void AddIDeltas_DY(i_group &ig, const i_deltas &idl, uint32_t coun
    }
 }
 
+#include "gpu_span.cpp"
+
 template<bool goraud, bool textured, int BlendMode, bool TexMult, uint32 TexMode_TA, bool MaskEval_TA>
 static INLINE void DrawSpan(PS_GPU *gpu, int y, const int32 x_start, const int32 x_bound, i_group ig, const i_deltas &idl)
 {
@@ -162,6 +164,26 @@ static INLINE void DrawSpan(PS_GPU *gpu, int y, const int32 x_start, const int32
         gpu->DrawTimeAvail -= w >> gpu->upscale_shift;
   }
 
+  if(!RasterRowEnabled(gpu, y >> gpu->upscale_shift))
+  {
+     if(textured && gpu->RasterQueued)
+     {
+        do
+        {
+           TouchTexel<TexMode_TA>(gpu, ig.u >> (COORD_FBS + COORD_POST_PADDING), ig.v >> (COORD_FBS + COORD_POST_PADDING));
+           AddIDeltas_DX<false, true>(ig, idl);
+        } while(MDFN_LIKELY(--w > 0));
+     }
+     return;
+  }
+
+#ifdef HAVE_SPAN_VECTOR
+  DrawSpan_Vector<goraud, textured, BlendMode, TexMult, TexMode_TA, MaskEval_TA>(gpu, y, x, w, ig, idl);
+
+  if(w <= 0)
+     return;
+#endif
+
   do
   {
    const uint32 r = ig.r >> (COORD_FBS + COORD_POST_PADDING);
@@ -1175,7 +1197,16 @@ static void Command_DrawPolygon(PS_GPU *gpu, const uint32_t *cb)
       }
 
 		if (rsx_intf_has_software_renderer())
+		{
+			MarkVRAMLines(std::max<int32>(std::min(vertices[0].y, std::min(vertices[1].y, vertices[2].y)) >> gpu->upscale_shift, gpu->ClipY0),
+					std::min<int32>(std::max(vertices[0].y, std::max(vertices[1].y, vertices[2].y)) >> gpu->upscale_shift, gpu->ClipY1));
+
+			if (gpu->RasterQueued)
+				RasterQueue_Triangle(gpu, DrawTriangle<goraud, textured, BlendMode, TexMult, TexMode_TA, MaskEval_TA>,
+						vertices, textured ? (int)TexMode_TA : -1);
+
 			DrawTriangle<goraud, textured, BlendMode, TexMult, TexMode_TA, MaskEval_TA>(gpu, vertices);
+		}
 
 		// Line Render: Overwrite vertices with those of the second triangle
 		if ((lineFound) && (numvertices == 3) && (textured))
@@ -0,0 +1,289 @@
+/*
+ * Vector span rasterization for DrawSpan().
+ *
+ * Each backend draws 8 or 16 pixels of a span per iteration with 16-bit lanes: the colour interpolants, dithering,
+ * texture modulation, semi-transparency and mask evaluation are computed exactly as in the scalar loop, which is
+ * left to draw whatever doesn't fill a whole vector.  Only the texel fetches are still done one pixel at a time,
+ * since the texture cache has to see them in the same order(its misses are charged to DrawTimeAvail).
+ *
+ * SSE2 and NEON are picked at compile time, AVX2 at runtime when the host has it.
+ */
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define HAVE_SPAN_SSE2 1
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAVE_SPAN_AVX2 1
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define HAVE_SPAN_NEON 1
+#endif
+
+#if defined(HAVE_SPAN_SSE2) || defined(HAVE_SPAN_NEON)
+#define HAVE_SPAN_VECTOR 1
+
+// Narrower spans aren't worth setting up the vectors for.
+#define SPAN_MIN_WIDTH 8
+
+// Largest dither_upscale_shift the kernels handle(16x internal resolution).
+#define SPAN_MAX_DITHER_SHIFT 4
+
+#ifdef HAVE_SPAN_SSE2
+struct SpanVec_SSE2
+{
+   enum { N = 8 };
+
+   typedef __m128i vec;
+
+   // i * step for each of the N pixels, in 32 bits.
+   struct ramp
+   {
+      __m128i lo, hi;
+   };
+
+   static INLINE vec load(const void *p) { return _mm_loadu_si128((const __m128i *)p); }
+   static INLINE void store(void *p, vec v) { _mm_storeu_si128((__m128i *)p, v); }
+   static INLINE vec set1(int v) { return _mm_set1_epi16((int16)v); }
+
+   static INLINE vec add(vec a, vec b) { return _mm_add_epi16(a, b); }
+   static INLINE vec sub(vec a, vec b) { return _mm_sub_epi16(a, b); }
+   static INLINE vec and_(vec a, vec b) { return _mm_and_si128(a, b); }
+   static INLINE vec or_(vec a, vec b) { return _mm_or_si128(a, b); }
+   static INLINE vec xor_(vec a, vec b) { return _mm_xor_si128(a, b); }
+   static INLINE vec mullo(vec a, vec b) { return _mm_mullo_epi16(a, b); }
+
+   // Signed
+   static INLINE vec min(vec a, vec b) { return _mm_min_epi16(a, b); }
+   static INLINE vec max(vec a, vec b) { return _mm_max_epi16(a, b); }
+
+   template<int n> static INLINE vec srl(vec v) { return _mm_srli_epi16(v, n); }
+   template<int n> static INLINE vec sll(vec v) { return _mm_slli_epi16(v, n); }
+   template<int n> static INLINE vec sra(vec v) { return _mm_srai_epi16(v, n); }
+
+   static INLINE vec cmpeq(vec a, vec b) { return _mm_cmpeq_epi16(a, b); }
+   static INLINE vec select(vec mask, vec a, vec b) { return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b)); }
+
+   static INLINE ramp Ramp(uint32 step)
+   {
+      ramp ret;
+
+      ret.lo = _mm_setr_epi32(0, step, step * 2, step * 3);
+      ret.hi = _mm_add_epi32(ret.lo, _mm_set1_epi32(step * 4));
+
+      return ret;
+   }
+
+   // ((base + i * step) >> 24) for each pixel.
+   static INLINE vec Interp(uint32 base, const ramp &r)
+   {
+      const __m128i b = _mm_set1_epi32(base);
+      __m128i lo = _mm_srli_epi32(_mm_add_epi32(b, r.lo), COORD_FBS + COORD_POST_PADDING);
+      __m128i hi = _mm_srli_epi32(_mm_add_epi32(b, r.hi), COORD_FBS + COORD_POST_PADDING);
+
+      return _mm_packs_epi32(lo, hi);
+   }
+};
+
+#define SPAN_KERNEL SpanKernel_SSE2
+#define SPAN_VEC SpanVec_SSE2
+#define SPAN_ATTR
+#include "gpu_span.inc"
+#undef SPAN_ATTR
+#undef SPAN_VEC
+#undef SPAN_KERNEL
+
+typedef SpanKernel_SSE2 SpanKernel;
+#endif
+
+#ifdef HAVE_SPAN_AVX2
+#define SPAN_AVX2_ATTR __attribute__((target("avx2")))
+
+struct SpanVec_AVX2
+{
+   enum { N = 16 };
+
+   typedef __m256i vec;
+
+   struct ramp
+   {
+      __m256i lo, hi;
+   };
+
+   SPAN_AVX2_ATTR static INLINE vec load(const void *p) { return _mm256_loadu_si256((const __m256i *)p); }
+   SPAN_AVX2_ATTR static INLINE void store(void *p, vec v) { _mm256_storeu_si256((__m256i *)p, v); }
+   SPAN_AVX2_ATTR static INLINE vec set1(int v) { return _mm256_set1_epi16((int16)v); }
+
+   SPAN_AVX2_ATTR static INLINE vec add(vec a, vec b) { return _mm256_add_epi16(a, b); }
+   SPAN_AVX2_ATTR static INLINE vec sub(vec a, vec b) { return _mm256_sub_epi16(a, b); }
+   SPAN_AVX2_ATTR static INLINE vec and_(vec a, vec b) { return _mm256_and_si256(a, b); }
+   SPAN_AVX2_ATTR static INLINE vec or_(vec a, vec b) { return _mm256_or_si256(a, b); }
+   SPAN_AVX2_ATTR static INLINE vec xor_(vec a, vec b) { return _mm256_xor_si256(a, b); }
+   SPAN_AVX2_ATTR static INLINE vec mullo(vec a, vec b) { return _mm256_mullo_epi16(a, b); }
+
+   SPAN_AVX2_ATTR static INLINE vec min(vec a, vec b) { return _mm256_min_epi16(a, b); }
+   SPAN_AVX2_ATTR static INLINE vec max(vec a, vec b) { return _mm256_max_epi16(a, b); }
+
+   template<int n> SPAN_AVX2_ATTR static INLINE vec srl(vec v) { return _mm256_srli_epi16(v, n); }
+   template<int n> SPAN_AVX2_ATTR static INLINE vec sll(vec v) { return _mm256_slli_epi16(v, n); }
+   template<int n> SPAN_AVX2_ATTR static INLINE vec sra(vec v) { return _mm256_srai_epi16(v, n); }
+
+   SPAN_AVX2_ATTR static INLINE vec cmpeq(vec a, vec b) { return _mm256_cmpeq_epi16(a, b); }
+   SPAN_AVX2_ATTR static INLINE vec select(vec mask, vec a, vec b) { return _mm256_blendv_epi8(b, a, mask); }
+
+   SPAN_AVX2_ATTR static INLINE ramp Ramp(uint32 step)
+   {
+      ramp ret;
+
+      ret.lo = _mm256_setr_epi32(0, step, step * 2, step * 3, step * 4, step * 5, step * 6, step * 7);
+      ret.hi = _mm256_add_epi32(ret.lo, _mm256_set1_epi32(step * 8));
+
+      return ret;
+   }
+
+   SPAN_AVX2_ATTR static INLINE vec Interp(uint32 base, const ramp &r)
+   {
+      const __m256i b = _mm256_set1_epi32(base);
+      __m256i lo = _mm256_srli_epi32(_mm256_add_epi32(b, r.lo), COORD_FBS + COORD_POST_PADDING);
+      __m256i hi = _mm256_srli_epi32(_mm256_add_epi32(b, r.hi), COORD_FBS + COORD_POST_PADDING);
+
+      // The pack works within 128-bit halves, put the pixels back in order.
+      return _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xD8);
+   }
+};
+
+#define SPAN_KERNEL SpanKernel_AVX2
+#define SPAN_VEC SpanVec_AVX2
+#define SPAN_ATTR SPAN_AVX2_ATTR
+#include "gpu_span.inc"
+#undef SPAN_ATTR
+#undef SPAN_VEC
+#undef SPAN_KERNEL
+
+static bool span_avx2 = false;
+#endif
+
+#ifdef HAVE_SPAN_NEON
+struct SpanVec_NEON
+{
+   enum { N = 8 };
+
+   typedef uint16x8_t vec;
+
+   struct ramp
+   {
+      uint32x4_t lo, hi;
+   };
+
+   static INLINE vec load(const void *p) { return vld1q_u16((const uint16_t *)p); }
+   static INLINE void store(void *p, vec v) { vst1q_u16((uint16_t *)p, v); }
+   static INLINE vec set1(int v) { return vdupq_n_u16((uint16)v); }
+
+   static INLINE vec add(vec a, vec b) { return vaddq_u16(a, b); }
+   static INLINE vec sub(vec a, vec b) { return vsubq_u16(a, b); }
+   static INLINE vec and_(vec a, vec b) { return vandq_u16(a, b); }
+   static INLINE vec or_(vec a, vec b) { return vorrq_u16(a, b); }
+   static INLINE vec xor_(vec a, vec b) { return veorq_u16(a, b); }
+   static INLINE vec mullo(vec a, vec b) { return vmulq_u16(a, b); }
+
+   static INLINE vec min(vec a, vec b) { return vreinterpretq_u16_s16(vminq_s16(vreinterpretq_s16_u16(a), vreinterpretq_s16_u16(b))); }
+   static INLINE vec max(vec a, vec b) { return vreinterpretq_u16_s16(vmaxq_s16(vreinterpretq_s16_u16(a), vreinterpretq_s16_u16(b))); }
+
+   template<int n> static INLINE vec srl(vec v) { return vshrq_n_u16(v, n); }
+   template<int n> static INLINE vec sll(vec v) { return vshlq_n_u16(v, n); }
+   template<int n> static INLINE vec sra(vec v) { return vreinterpretq_u16_s16(vshrq_n_s16(vreinterpretq_s16_u16(v), n)); }
+
+   static INLINE vec cmpeq(vec a, vec b) { return vceqq_u16(a, b); }
+   static INLINE vec select(vec mask, vec a, vec b) { return vbslq_u16(mask, a, b); }
+
+   static INLINE ramp Ramp(uint32 step)
+   {
+      const uint32 steps[4] = { 0, step, step * 2, step * 3 };
+      ramp ret;
+
+      ret.lo = vld1q_u32(steps);
+      ret.hi = vaddq_u32(ret.lo, vdupq_n_u32(step * 4));
+
+      return ret;
+   }
+
+   static INLINE vec Interp(uint32 base, const ramp &r)
+   {
+      const uint32x4_t b = vdupq_n_u32(base);
+      uint16x4_t lo = vmovn_u32(vshrq_n_u32(vaddq_u32(b, r.lo), COORD_FBS + COORD_POST_PADDING));
+      uint16x4_t hi = vmovn_u32(vshrq_n_u32(vaddq_u32(b, r.hi), COORD_FBS + COORD_POST_PADDING));
+
+      return vcombine_u16(lo, hi);
+   }
+};
+
+#define SPAN_KERNEL SpanKernel_NEON
+#define SPAN_VEC SpanVec_NEON
+#define SPAN_ATTR
+#include "gpu_span.inc"
+#undef SPAN_ATTR
+#undef SPAN_VEC
+#undef SPAN_KERNEL
+
+typedef SpanKernel_NEON SpanKernel;
+#endif
+
+static void Span_Init(void)
+{
+#ifdef HAVE_SPAN_AVX2
+   __builtin_cpu_init();
+   span_avx2 = __builtin_cpu_supports("avx2");
+#endif
+}
+
+// Whether a texel fetched while drawing the span could come from a pixel the span itself draws; the kernels write
+// back a whole vector at a time, so the scalar loop has to take those.
+template<uint32 TexMode_TA>
+static INLINE bool Span_TextureHazard(PS_GPU *gpu, int32 y, int32 x, int32 w)
+{
+   const uint32 shift = gpu->upscale_shift;
+   const uint32 tshift = 2 - TexMode_TA;
+
+   // Texels are only fetched from the first line of each upscaled native line.
+   if(y & ((1 << shift) - 1))
+      return false;
+
+   // (v & TWY_AND) and (u & TWX_AND) are both 0..255.
+   if((((y >> shift) & 511) - gpu->SUCV.TWY_ADD) > 255)
+      return false;
+
+   const uint32 tx0 = (gpu->SUCV.TWX_ADD >> tshift) & ~3;
+   const uint32 tw = (((gpu->SUCV.TWX_ADD + 255) >> tshift) | 3) - tx0 + 1;
+   const uint32 sx0 = x >> shift;
+   const uint32 sw = ((x + w - 1) >> shift) - sx0 + 1;
+
+   return ((sx0 - tx0) & 1023) < tw || ((tx0 - sx0) & 1023) < sw;
+}
+
+// Draws as much of the span as fits in whole vectors, leaving the rest(if any) to the scalar loop.
+template<bool goraud, bool textured, int BlendMode, bool TexMult, uint32 TexMode_TA, bool MaskEval_TA>
+static INLINE void DrawSpan_Vector(PS_GPU *gpu, int32 y, int32 &x, int32 &w, i_group &ig, const i_deltas &idl)
+{
+   if(w < SPAN_MIN_WIDTH)
+      return;
+
+   if(gpu->dither_upscale_shift > SPAN_MAX_DITHER_SHIFT)
+      return;
+
+   if(textured && Span_TextureHazard<TexMode_TA>(gpu, y, x, w))
+      return;
+
+#ifdef HAVE_SPAN_AVX2
+   if(span_avx2 && w >= SpanKernel_AVX2::N)
+      SpanKernel_AVX2::Draw<goraud, textured, BlendMode, TexMult, TexMode_TA, MaskEval_TA>(gpu, y, x, w, ig, idl);
+#endif
+
+   if(w >= SpanKernel::N)
+      SpanKernel::Draw<goraud, textured, BlendMode, TexMult, TexMode_TA, MaskEval_TA>(gpu, y, x, w, ig, idl);
+}
+#else
+static void Span_Init(void)
+{
+}
+#endif
@@ -1,4 +1,23 @@
 
+/* PlotNativePixel() for a sprite pixel, on the first upscaled line only.
+ * Returns false if the mask bit kept the pixel from being drawn. */
+template<int BlendMode, bool MaskEval_TA, bool textured>
+static INLINE bool PlotSpritePixel(PS_GPU *gpu, uint16_t *pix, uint32_t scale, uint16_t fore_pix)
+{
+   if(BlendMode >= 0 && (fore_pix & 0x8000))
+      PlotPixelBlend<BlendMode>(pix[0], &fore_pix);
+
+   if(MaskEval_TA && (pix[0] & 0x8000))
+      return false;
+
+   const uint16_t value = (textured ? fore_pix : (fore_pix & 0x7FFF)) | gpu->MaskSetOR;
+
+   for(uint32_t i = 0; i < scale; i++)
+      pix[i] = value;
+
+   return true;
+}
+
 template<bool textured, int BlendMode, bool TexMult, uint32_t TexMode_TA,
    bool MaskEval_TA, bool FlipX, bool FlipY>
 static void DrawSprite(PS_GPU *gpu, int32_t x_arg, int32_t y_arg, int32_t w, int32_t h,
@@ -87,27 +106,80 @@ static void DrawSprite(PS_GPU *gpu, int32_t x_arg, int32_t y_arg, int32_t w, int
             gpu->DrawTimeAvail -= suck_time;
          }
 
-         for(int32_t x = x_start; MDFN_LIKELY(x < x_bound); x++)
+         if(textured && gpu->RasterQueued && !RasterRowEnabled(gpu, y))
          {
-            if(textured)
+            for(int32_t x = x_start; MDFN_LIKELY(x < x_bound); x++)
             {
-               uint16_t fbw = GetTexel<TexMode_TA>(gpu, u_r, v);
+               TouchTexel<TexMode_TA>(gpu, u_r, v);
+               u_r += u_inc;
+            }
+         }
 
-               if(fbw)
+         if(RasterRowEnabled(gpu, y) && x_bound > x_start)
+         {
+            /* The row is drawn into the first upscaled line, then copied
+             * to the others. Texels and the pixels under the sprite are
+             * only ever read from the first line, so this draws exactly
+             * what plotting each pixel with texel_put() would. */
+            const uint32_t shift = gpu->upscale_shift;
+            const uint32_t scale = 1U << shift;
+            uint16_t *row        = &gpu->vram[((y & 511) << shift) << (10 + shift)];
+            uint16_t *row_start  = row + (x_start << shift);
+            const uint32_t row_w = (x_bound - x_start) << shift;
+            bool holes           = false;
+            uint8_t drawn[1024];
+
+            if(!textured && BlendMode < 0 && !MaskEval_TA)
+               std::fill(row_start, row_start + row_w, (uint16_t)((fill_color & 0x7FFF) | gpu->MaskSetOR));
+            else
+            {
+               for(int32_t x = x_start; MDFN_LIKELY(x < x_bound); x++)
                {
-                  if(TexMult)
+                  bool plotted = false;
+
+                  if(textured)
                   {
-                     uint8_t *dither_offset = gpu->DitherLUT[2][3];
-                     fbw = ModTexel(dither_offset, fbw, r, g, b);
+                     uint16_t fbw = GetTexel<TexMode_TA>(gpu, u_r, v);
+
+                     if(fbw)
+                     {
+                        if(TexMult)
+                        {
+                           uint8_t *dither_offset = gpu->DitherLUT[2][3];
+                           fbw = ModTexel(dither_offset, fbw, r, g, b);
+                        }
+                        plotted = PlotSpritePixel<BlendMode, MaskEval_TA, true>(gpu, &row[x << shift], scale, fbw);
+                     }
                   }
-                  PlotNativePixel<BlendMode, MaskEval_TA, true>(gpu, x, y, fbw);
+                  else
+                     plotted = PlotSpritePixel<BlendMode, MaskEval_TA, false>(gpu, &row[x << shift], scale, fill_color);
+
+                  if(textured || MaskEval_TA)
+                  {
+                     drawn[x - x_start] = plotted;
+                     holes |= !plotted;
+                  }
+
+                  if(textured)
+                     u_r += u_inc;
                }
             }
-            else
-               PlotNativePixel<BlendMode, MaskEval_TA, false>(gpu, x, y, fill_color);
 
-            if(textured)
-               u_r += u_inc;
+            for(uint32_t line = 1; line < scale; line++)
+            {
+               uint16_t *dest = row_start + (line << (10 + shift));
+
+               if(!holes)
+                  memcpy(dest, row_start, row_w * sizeof(uint16_t));
+               else
+               {
+                  for(int32_t i = 0; i < (x_bound - x_start); i++)
+                  {
+                     if(drawn[i])
+                        memcpy(dest + (i << shift), row_start + (i << shift), scale * sizeof(uint16_t));
+                  }
+               }
+            }
          }
       }
       if(textured)
@@ -236,34 +308,43 @@ static void Command_DrawSprite(PS_GPU *gpu, const uint32_t *cb)
    if (!rsx_intf_has_software_renderer())
       return;
 
+   RasterSpriteFunc draw = NULL;
+
    switch(gpu->SpriteFlip & 0x3000)
    {
       case 0x0000:
          if(!TexMult || color == 0x808080)
-            DrawSprite<textured, BlendMode, false, TexMode_TA, MaskEval_TA, false, false>(gpu, x, y, w, h, u, v, color, clut);
+            draw = DrawSprite<textured, BlendMode, false, TexMode_TA, MaskEval_TA, false, false>;
          else
-            DrawSprite<textured, BlendMode, true, TexMode_TA, MaskEval_TA, false, false>(gpu, x, y, w, h, u, v, color, clut);
+            draw = DrawSprite<textured, BlendMode, true, TexMode_TA, MaskEval_TA, false, false>;
          break;
 
       case 0x1000:
          if(!TexMult || color == 0x808080)
-            DrawSprite<textured, BlendMode, false, TexMode_TA, MaskEval_TA, true, false>(gpu, x, y, w, h, u, v, color, clut);
+            draw = DrawSprite<textured, BlendMode, false, TexMode_TA, MaskEval_TA, true, false>;
          else
-            DrawSprite<textured, BlendMode, true, TexMode_TA, MaskEval_TA, true, false>(gpu, x, y, w, h, u, v, color, clut);
+            draw = DrawSprite<textured, BlendMode, true, TexMode_TA, MaskEval_TA, true, false>;
          break;
 
       case 0x2000:
          if(!TexMult || color == 0x808080)
-            DrawSprite<textured, BlendMode, false, TexMode_TA, MaskEval_TA, false, true>(gpu, x, y, w, h, u, v, color, clut);
+            draw = DrawSprite<textured, BlendMode, false, TexMode_TA, MaskEval_TA, false, true>;
          else
-            DrawSprite<textured, BlendMode, true, TexMode_TA, MaskEval_TA, false, true>(gpu, x, y, w, h, u, v, color, clut);
+            draw = DrawSprite<textured, BlendMode, true, TexMode_TA, MaskEval_TA, false, true>;
          break;
 
       case 0x3000:
          if(!TexMult || color == 0x808080)
-            DrawSprite<textured, BlendMode, false, TexMode_TA, MaskEval_TA, true, true>(gpu, x, y, w, h, u, v, color, clut);
+            draw = DrawSprite<textured, BlendMode, false, TexMode_TA, MaskEval_TA, true, true>;
          else
-            DrawSprite<textured, BlendMode, true, TexMode_TA, MaskEval_TA, true, true>(gpu, x, y, w, h, u, v, color, clut);
+            draw = DrawSprite<textured, BlendMode, true, TexMode_TA, MaskEval_TA, true, true>;
          break;
    }
+
+   MarkVRAMLines(std::max<int32>(y, gpu->ClipY0), std::min<int32>(y + h - 1, gpu->ClipY1));
+
+   if(gpu->RasterQueued)
+      RasterQueue_Sprite(gpu, draw, x, y, w, h, u, v, color, clut, textured ? (int)TexMode_TA : -1);
+
+   draw(gpu, x, y, w, h, u, v, color, clut);
 }
@@ -0,0 +1,616 @@
+/*
+ * Threaded software rasterizer.
+ *
+ * When enabled, the draw commands still run on the emulation thread so that
+ * DrawTimeAvail and the command sequencing stay where they were, but with every
+ * RasterRows entry of the main PS_GPU cleared the rasterizers only account for
+ * timing there.  The primitive is recorded into a ring buffer instead, along with
+ * the drawing state it depends on, and replayed in order by each raster thread.
+ * Every thread owns an interleaved set of 8-line VRAM stripes and only writes
+ * those, so the threads never touch the same pixels and need no ordering
+ * between them.
+ *
+ * The emulation thread only has to wait for the raster threads when it is about
+ * to access VRAM itself(FB read/write/copy/fill, display readout of pending rows,
+ * savestates, rescaling, frame end), when a queued primitive samples a texture
+ * page or CLUT that a still pending primitive draws into, or when a queued
+ * primitive draws into a texture page or CLUT that a still pending job samples.
+ * Pending writes and reads are tracked in 64x16 tiles for this purpose.
+ *
+ * Each thread has its own texture cache.  The emulation thread still walks the
+ * texel addresses of every row it doesn't draw through the tags of the main
+ * PS_GPU's texture cache(see TouchTexel()), so cache misses are charged to
+ * DrawTimeAvail exactly as when drawing on a single thread.
+ */
+
+#if HAVE_THREADS
+
+#include <rthreads/rthreads.h>
+
+#define RASTER_QUEUE_SIZE     1024 // Power of 2
+#define RASTER_STRIPE_SHIFT   3
+#define RASTER_MAX_THREADS    8
+
+enum
+{
+   RASTER_JOB_CLUT = 0,
+   RASTER_JOB_TRIANGLE,
+   RASTER_JOB_SPRITE,
+   RASTER_JOB_LINE
+};
+
+struct raster_job
+{
+   uint8 type;
+
+   // Drawing state the rasterizers read, as of when the job was queued.
+   uint32 TexCacheGen;
+   int32 ClipX0, ClipY0, ClipX1, ClipY1;
+   uint32 TWX_AND, TWX_ADD, TWY_AND, TWY_ADD;
+   uint32 MaskSetOR;
+   uint32 DisplayMode;
+   uint32 DisplayFB_YStart;
+   uint16 off_u, off_v;
+   bool dtd, dfe, field_ram_readout;
+
+   union
+   {
+      struct
+      {
+         uint16 raw_clut;
+         uint32 count;
+      } clut;
+
+      struct
+      {
+         RasterTriangleFunc func;
+         tri_vertex vertices[3];
+      } tri;
+
+      struct
+      {
+         RasterSpriteFunc func;
+         int32 x, y, w, h;
+         uint8 u, v;
+         uint32 color, clut;
+      } sprite;
+
+      struct
+      {
+         RasterLineFunc func;
+         line_point points[2];
+      } line;
+   };
+};
+
+struct raster_thread
+{
+   sthread_t *thread;
+   PS_GPU *gpu;
+   uint32 TexCacheGen;
+   unsigned read;       // Jobs consumed, guarded by raster_lock
+};
+
+static raster_job *raster_jobs = NULL;
+static raster_thread raster_threads[RASTER_MAX_THREADS];
+static unsigned raster_count = 0;
+static unsigned raster_wanted = 0;
+
+static slock_t *raster_lock = NULL;
+static scond_t *raster_work_cond = NULL;
+static scond_t *raster_done_cond = NULL;
+static unsigned raster_write = 0;   // Jobs queued, guarded by raster_lock
+static unsigned raster_synced = 0;
+static bool raster_quit = false;
+
+// Tiles with pending writes and pending texture/CLUT reads, one bit per 64 halfwords of a 16 line band.
+static uint16 raster_dirty[32];
+static bool raster_dirty_any = false;
+static uint16 raster_reads[32];
+static bool raster_reads_any = false;
+
+// Returns a mask of the tiles covered by [pos, pos + len) in a dimension of (1 << size_shift), wrapping around.
+static uint32 RasterTileMask(uint32 pos, uint32 len, unsigned size_shift, unsigned tile_shift)
+{
+   const uint32 size = 1U << size_shift;
+   const uint32 all  = (2U << ((size >> tile_shift) - 1)) - 1;
+   uint32 first_on, last_on;
+
+   if(!len)
+      return 0;
+
+   if(len >= size)
+      return all;
+
+   pos     &= size - 1;
+   first_on = all & ~((1U << (pos >> tile_shift)) - 1);
+   last_on  = (2U << (((pos + len - 1) & (size - 1)) >> tile_shift)) - 1;
+
+   if(pos + len > size)
+      return first_on | last_on;
+
+   return first_on & last_on;
+}
+
+static void RasterTiles_Mark(uint16 *tiles, uint32 x, uint32 y, uint32 w, uint32 h)
+{
+   const uint32 columns = RasterTileMask(x, w, 10, 6);
+   const uint32 rows    = RasterTileMask(y, h, 9, 4);
+
+   for(unsigned i = 0; i < 32; i++)
+   {
+      if(rows & (1U << i))
+         tiles[i] |= columns;
+   }
+}
+
+static bool RasterTiles_Test(const uint16 *tiles, uint32 x, uint32 y, uint32 w, uint32 h)
+{
+   const uint32 columns = RasterTileMask(x, w, 10, 6);
+   const uint32 rows    = RasterTileMask(y, h, 9, 4);
+
+   for(unsigned i = 0; i < 32; i++)
+   {
+      if((rows & (1U << i)) && (tiles[i] & columns))
+         return true;
+   }
+
+   return false;
+}
+
+static void RasterJob_Run(raster_thread *t, const raster_job *job)
+{
+   PS_GPU *g = t->gpu;
+
+   if(t->TexCacheGen != job->TexCacheGen)
+   {
+      InvalidateTexCache(g);
+      t->TexCacheGen = job->TexCacheGen;
+   }
+
+   g->ClipX0            = job->ClipX0;
+   g->ClipY0            = job->ClipY0;
+   g->ClipX1            = job->ClipX1;
+   g->ClipY1            = job->ClipY1;
+   g->SUCV.TWX_AND      = job->TWX_AND;
+   g->SUCV.TWX_ADD      = job->TWX_ADD;
+   g->SUCV.TWY_AND      = job->TWY_AND;
+   g->SUCV.TWY_ADD      = job->TWY_ADD;
+   g->MaskSetOR         = job->MaskSetOR;
+   g->DisplayMode       = job->DisplayMode;
+   g->DisplayFB_YStart  = job->DisplayFB_YStart;
+   g->off_u             = job->off_u;
+   g->off_v             = job->off_v;
+   g->dtd               = job->dtd;
+   g->dfe               = job->dfe;
+   g->field_ram_readout = job->field_ram_readout;
+
+   switch(job->type)
+   {
+      case RASTER_JOB_CLUT:
+         Load_CLUT_Cache(g, job->clut.raw_clut, job->clut.count);
+         break;
+
+      case RASTER_JOB_TRIANGLE:
+         {
+            // The rasterizer sorts the vertices in place.
+            tri_vertex vertices[3];
+
+            memcpy(vertices, job->tri.vertices, sizeof(vertices));
+            job->tri.func(g, vertices);
+         }
+         break;
+
+      case RASTER_JOB_SPRITE:
+         job->sprite.func(g, job->sprite.x, job->sprite.y, job->sprite.w, job->sprite.h,
+               job->sprite.u, job->sprite.v, job->sprite.color, job->sprite.clut);
+         break;
+
+      case RASTER_JOB_LINE:
+         {
+            line_point points[2];
+
+            memcpy(points, job->line.points, sizeof(points));
+            job->line.func(g, points);
+         }
+         break;
+   }
+}
+
+static void RasterThread_Main(void *arg)
+{
+   raster_thread *t = (raster_thread*)arg;
+
+   slock_lock(raster_lock);
+
+   for(;;)
+   {
+      unsigned end;
+
+      while(t->read == raster_write && !raster_quit)
+         scond_wait(raster_work_cond, raster_lock);
+
+      if(t->read == raster_write)
+         break;
+
+      end = raster_write;
+      slock_unlock(raster_lock);
+
+      for(unsigned i = t->read; i != end; i++)
+         RasterJob_Run(t, &raster_jobs[i & (RASTER_QUEUE_SIZE - 1)]);
+
+      slock_lock(raster_lock);
+      t->read = end;
+      scond_signal(raster_done_cond);
+   }
+
+   slock_unlock(raster_lock);
+}
+
+// Returns the number of jobs the slowest raster thread still has to run; raster_lock must be held.
+static unsigned RasterQueue_Pending(void)
+{
+   unsigned pending = 0;
+
+   for(unsigned i = 0; i < raster_count; i++)
+      pending = std::max<unsigned>(pending, raster_write - raster_threads[i].read);
+
+   return pending;
+}
+
+// Waits until the raster threads are idle.
+static void RasterQueue_Sync(void)
+{
+   if(raster_synced == raster_write)
+      return;
+
+   slock_lock(raster_lock);
+
+   while(RasterQueue_Pending())
+      scond_wait(raster_done_cond, raster_lock);
+
+   slock_unlock(raster_lock);
+
+   memset(raster_dirty, 0, sizeof(raster_dirty));
+   memset(raster_reads, 0, sizeof(raster_reads));
+   raster_dirty_any = false;
+   raster_reads_any = false;
+   raster_synced    = raster_write;
+}
+
+// Waits for the raster threads if they may still write to the given VRAM area.
+static void RasterQueue_SyncRect(uint32 x, uint32 y, uint32 w, uint32 h)
+{
+   if(raster_dirty_any && RasterTiles_Test(raster_dirty, x, y, w, h))
+      RasterQueue_Sync();
+}
+
+// Records that the last committed job reads the given VRAM area when it is replayed.
+static void RasterQueue_MarkRead(uint32 x, uint32 y, uint32 w, uint32 h)
+{
+   RasterTiles_Mark(raster_reads, x, y, w, h);
+   raster_reads_any = true;
+}
+
+static raster_job *RasterQueue_Alloc(PS_GPU *g, uint8 type)
+{
+   raster_job *job;
+
+   if(raster_write - raster_synced >= RASTER_QUEUE_SIZE)
+   {
+      slock_lock(raster_lock);
+
+      while(RasterQueue_Pending() >= RASTER_QUEUE_SIZE)
+         scond_wait(raster_done_cond, raster_lock);
+
+      slock_unlock(raster_lock);
+   }
+
+   job = &raster_jobs[raster_write & (RASTER_QUEUE_SIZE - 1)];
+
+   job->type              = type;
+   job->TexCacheGen       = g->TexCacheGen;
+   job->ClipX0            = g->ClipX0;
+   job->ClipY0            = g->ClipY0;
+   job->ClipX1            = g->ClipX1;
+   job->ClipY1            = g->ClipY1;
+   job->TWX_AND           = g->SUCV.TWX_AND;
+   job->TWX_ADD           = g->SUCV.TWX_ADD;
+   job->TWY_AND           = g->SUCV.TWY_AND;
+   job->TWY_ADD           = g->SUCV.TWY_ADD;
+   job->MaskSetOR         = g->MaskSetOR;
+   job->DisplayMode       = g->DisplayMode;
+   job->DisplayFB_YStart  = g->DisplayFB_YStart;
+   job->off_u             = g->off_u;
+   job->off_v             = g->off_v;
+   job->dtd               = g->dtd;
+   job->dfe               = g->dfe;
+   job->field_ram_readout = g->field_ram_readout;
+
+   return job;
+}
+
+// Runs a job on the emulation thread, with the first raster thread's state drawing every line; the
+// raster threads must be idle.
+static void RasterQueue_RunSerial(const raster_job *job)
+{
+   raster_thread *t = &raster_threads[0];
+   uint8 rows[512];
+
+   memcpy(rows, t->gpu->RasterRows, sizeof(rows));
+   memset(t->gpu->RasterRows, 1, sizeof(rows));
+   RasterJob_Run(t, job);
+   memcpy(t->gpu->RasterRows, rows, sizeof(rows));
+}
+
+static void RasterQueue_Commit(PS_GPU *g, const raster_job *job, bool draws, bool serial)
+{
+   if(serial)
+   {
+      RasterQueue_RunSerial(job);
+      return;
+   }
+
+   // Everything a primitive draws lies within the drawing area.  The rows of a pending job that samples
+   // the area may be replayed by another thread after this primitive's rows, so wait for it first.
+   if(draws && g->ClipX1 >= g->ClipX0 && g->ClipY1 >= g->ClipY0)
+   {
+      const uint32 w = g->ClipX1 - g->ClipX0 + 1;
+      const uint32 h = g->ClipY1 - g->ClipY0 + 1;
+
+      if(raster_reads_any && RasterTiles_Test(raster_reads, g->ClipX0, g->ClipY0, w, h))
+         RasterQueue_Sync();
+
+      RasterTiles_Mark(raster_dirty, g->ClipX0, g->ClipY0, w, h);
+      raster_dirty_any = true;
+   }
+
+   slock_lock(raster_lock);
+   raster_write++;
+   scond_broadcast(raster_work_cond);
+   slock_unlock(raster_lock);
+}
+
+/* Makes sure the texture page the primitive samples isn't still being drawn to.  Returns true if
+ * the primitive may sample its own output, which only comes out right when a single thread draws
+ * it in order. */
+static bool RasterQueue_SyncTexture(PS_GPU *g, int TexMode)
+{
+   const uint32 tw = 64 << TexMode;
+
+   if(TexMode < 0)
+      return false;
+
+   if(g->ClipX1 >= g->ClipX0 && g->ClipY1 >= g->ClipY0 &&
+         (RasterTileMask(g->TexPageX, tw, 10, 6) & RasterTileMask(g->ClipX0, g->ClipX1 - g->ClipX0 + 1, 10, 6)) &&
+         (RasterTileMask(g->TexPageY, 256, 9, 4) & RasterTileMask(g->ClipY0, g->ClipY1 - g->ClipY0 + 1, 9, 4)))
+   {
+      RasterQueue_Sync();
+      return true;
+   }
+
+   RasterQueue_SyncRect(g->TexPageX, g->TexPageY, tw, 256);
+   return false;
+}
+
+static void RasterQueue_CLUT(PS_GPU *g, uint16 raw_clut, uint32 count)
+{
+   raster_job *job;
+
+   RasterQueue_SyncRect((raw_clut & 0x3F) << 4, (raw_clut >> 6) & 0x1FF, count, 1);
+
+   job                = RasterQueue_Alloc(g, RASTER_JOB_CLUT);
+   job->clut.raw_clut = raw_clut;
+   job->clut.count    = count;
+   RasterQueue_Commit(g, job, false, false);
+   RasterQueue_MarkRead((raw_clut & 0x3F) << 4, (raw_clut >> 6) & 0x1FF, count, 1);
+}
+
+static void RasterQueue_Triangle(PS_GPU *g, RasterTriangleFunc func, const tri_vertex *vertices, int TexMode)
+{
+   const bool serial = RasterQueue_SyncTexture(g, TexMode);
+   raster_job *job   = RasterQueue_Alloc(g, RASTER_JOB_TRIANGLE);
+
+   job->tri.func = func;
+   memcpy(job->tri.vertices, vertices, sizeof(job->tri.vertices));
+   RasterQueue_Commit(g, job, true, serial);
+
+   if(TexMode >= 0 && !serial)
+      RasterQueue_MarkRead(g->TexPageX, g->TexPageY, 64 << TexMode, 256);
+}
+
+static void RasterQueue_Sprite(PS_GPU *g, RasterSpriteFunc func, int32_t x, int32_t y, int32_t w, int32_t h,
+      uint8_t u, uint8_t v, uint32_t color, uint32_t clut, int TexMode)
+{
+   const bool serial = RasterQueue_SyncTexture(g, TexMode);
+   raster_job *job   = RasterQueue_Alloc(g, RASTER_JOB_SPRITE);
+
+   job->sprite.func  = func;
+   job->sprite.x     = x;
+   job->sprite.y     = y;
+   job->sprite.w     = w;
+   job->sprite.h     = h;
+   job->sprite.u     = u;
+   job->sprite.v     = v;
+   job->sprite.color = color;
+   job->sprite.clut  = clut;
+   RasterQueue_Commit(g, job, true, serial);
+
+   if(TexMode >= 0 && !serial)
+      RasterQueue_MarkRead(g->TexPageX, g->TexPageY, 64 << TexMode, 256);
+}
+
+static void RasterQueue_Line(PS_GPU *g, RasterLineFunc func, const line_point *points)
+{
+   raster_job *job = RasterQueue_Alloc(g, RASTER_JOB_LINE);
+
+   job->line.func = func;
+   memcpy(job->line.points, points, sizeof(job->line.points));
+   RasterQueue_Commit(g, job, true, false);
+}
+
+/* The raster threads keep their own caches.  The main PS_GPU's texture cache tags are kept up to date by
+ * TouchTexel(), only its data and the CLUT cache have to be brought back, for savestates or for drawing on the
+ * emulation thread again. */
+static void RasterQueue_GetCaches(void)
+{
+   if(!raster_count)
+      return;
+
+   RasterQueue_Sync();
+   memcpy(GPU.CLUT_Cache, raster_threads[0].gpu->CLUT_Cache, sizeof(GPU.CLUT_Cache));
+
+   for(unsigned i = 0; i < 256; i++)
+   {
+      const uint32 tag = GPU.TexCache[i].Tag;
+
+      if(tag == ~0U)
+         continue;
+
+      for(unsigned j = 0; j < 4; j++)
+         GPU.TexCache[i].Data[j] = texel_fetch(&GPU, (tag & 1023) + j, tag >> 10);
+   }
+}
+
+static void RasterQueue_PutCaches(void)
+{
+   for(unsigned i = 0; i < raster_count; i++)
+   {
+      memcpy(raster_threads[i].gpu->TexCache, GPU.TexCache, sizeof(GPU.TexCache));
+      memcpy(raster_threads[i].gpu->CLUT_Cache, GPU.CLUT_Cache, sizeof(GPU.CLUT_Cache));
+      raster_threads[i].TexCacheGen = GPU.TexCacheGen;
+   }
+}
+
+// Hands the raster threads the main PS_GPU fields that change outside of commands; they must be idle.
+static void RasterQueue_PutVRAM(void)
+{
+   for(unsigned i = 0; i < raster_count; i++)
+   {
+      PS_GPU *g = raster_threads[i].gpu;
+
+      g->vram                 = GPU.vram;
+      g->upscale_shift        = GPU.upscale_shift;
+      g->dither_upscale_shift = GPU.dither_upscale_shift;
+   }
+}
+
+static void RasterQueue_Stop(void)
+{
+   if(!raster_jobs)
+      return;
+
+   RasterQueue_GetCaches();
+
+   slock_lock(raster_lock);
+   raster_quit = true;
+   scond_broadcast(raster_work_cond);
+   slock_unlock(raster_lock);
+
+   for(unsigned i = 0; i < raster_count; i++)
+   {
+      sthread_join(raster_threads[i].thread);
+      delete raster_threads[i].gpu;
+   }
+
+   raster_count = 0;
+
+   scond_free(raster_done_cond);
+   scond_free(raster_work_cond);
+   slock_free(raster_lock);
+   delete [] raster_jobs;
+   raster_jobs = NULL;
+
+   memset(GPU.RasterRows, 1, sizeof(GPU.RasterRows));
+   GPU.RasterQueued = false;
+}
+
+static void RasterQueue_Start(unsigned count)
+{
+   raster_jobs      = new raster_job[RASTER_QUEUE_SIZE];
+   raster_lock      = slock_new();
+   raster_work_cond = scond_new();
+   raster_done_cond = scond_new();
+   raster_write     = 0;
+   raster_synced    = 0;
+   raster_quit      = false;
+   memset(raster_dirty, 0, sizeof(raster_dirty));
+   memset(raster_reads, 0, sizeof(raster_reads));
+   raster_dirty_any = false;
+   raster_reads_any = false;
+
+   for(unsigned i = 0; i < count; i++)
+   {
+      raster_thread *t = &raster_threads[i];
+
+      t->gpu         = new PS_GPU(GPU);
+      t->TexCacheGen = GPU.TexCacheGen;
+      t->read        = 0;
+
+      for(unsigned y = 0; y < 512; y++)
+         t->gpu->RasterRows[y] = ((y >> RASTER_STRIPE_SHIFT) % count) == i;
+   }
+
+   for(raster_count = 0; raster_count < count; raster_count++)
+   {
+      raster_thread *t = &raster_threads[raster_count];
+
+      if(!(t->thread = sthread_create(RasterThread_Main, t)))
+      {
+         for(unsigned i = raster_count; i < count; i++)
+            delete raster_threads[i].gpu;
+
+         RasterQueue_Stop();
+         raster_wanted = 0;
+         return;
+      }
+   }
+
+   memset(GPU.RasterRows, 0, sizeof(GPU.RasterRows));
+   GPU.RasterQueued = true;
+}
+
+// Applies a changed thread count; called between frames.
+static void RasterQueue_Configure(void)
+{
+   unsigned count = rsx_intf_has_software_renderer() ? raster_wanted : 0;
+
+   if(count == raster_count)
+      return;
+
+   RasterQueue_Stop();
+
+   if(count)
+      RasterQueue_Start(count);
+}
+
+void GPU_SetRasterThreads(unsigned count)
+{
+   raster_wanted = std::min<unsigned>(count, RASTER_MAX_THREADS);
+}
+
+void GPU_RasterSync(void)
+{
+   if(raster_count)
+      RasterQueue_Sync();
+}
+
+#else
+
+static void RasterQueue_Sync(void) { }
+static void RasterQueue_SyncRect(uint32 x, uint32 y, uint32 w, uint32 h) { }
+static void RasterQueue_CLUT(PS_GPU *g, uint16 raw_clut, uint32 count) { }
+static void RasterQueue_Triangle(PS_GPU *g, RasterTriangleFunc func, const tri_vertex *vertices, int TexMode) { }
+static void RasterQueue_Sprite(PS_GPU *g, RasterSpriteFunc func, int32_t x, int32_t y, int32_t w, int32_t h,
+      uint8_t u, uint8_t v, uint32_t color, uint32_t clut, int TexMode) { }
+static void RasterQueue_Line(PS_GPU *g, RasterLineFunc func, const line_point *points) { }
+static void RasterQueue_GetCaches(void) { }
+static void RasterQueue_PutCaches(void) { }
+static void RasterQueue_PutVRAM(void) { }
+static void RasterQueue_Stop(void) { }
+static void RasterQueue_Configure(void) { }
+
+void GPU_SetRasterThreads(unsigned count) { }
+void GPU_RasterSync(void) { }
+
+#endif /* HAVE_THREADS */
@@ -65,6 +65,10 @@
 #if defined(__SSE2__)
 #include <xmmintrin.h>
 #include <emmintrin.h>
+#define HAVE_MDEC_SSE2 1
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(MSB_FIRST)
+#include <arm_neon.h>
+#define HAVE_MDEC_NEON 1
 #endif
 
 #if defined(ARCH_POWERPC_ALTIVEC) && defined(HAVE_ALTIVEC_H)
@@ -224,99 +228,7 @@ int MDEC_StateAction(StateMem *sm, int load, int data_only)
    return(ret);
 }
 
-static INLINE int8 Mask9ClampS8(int32 v)
-{
-   v = sign_x_to_s32(9, v);
-
-   if(v < -128)
-      v = -128;
-
-   if(v > 127)
-      v = 127;
-
-   return v;
-}
-
-template<typename T>
-static void IDCT_1D_Multi(int16 *in_coeff, T *out_coeff)
-{
-   unsigned col, x;
-
-   for(col = 0; col < 8; col++)
-   {
-#if defined(__SSE2__)
-      __m128i c =  _mm_load_si128((__m128i *)&in_coeff[(col * 8)]);
-#endif
-
-      for( x = 0; x < 8; x++)
-      {
-#ifdef __SSE2__
-         MDFN_ALIGN(16) int32 tmp[4];
-         __m128i m   = _mm_load_si128((__m128i *)&IDCTMatrix[(x * 8)]);
-         __m128i sum = _mm_madd_epi16(m, c);
-         sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, (3 << 0) | (2 << 2) | (1 << 4) | (0 << 6)));
-         sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, (1 << 0) | (0 << 2)));
-
-         _mm_store_si128((__m128i*)tmp, sum);
-
-         if(sizeof(T) == 1)
-            out_coeff[(col * 8) + x] = Mask9ClampS8((tmp[0] + 0x4000) >> 15);
-         else
-            out_coeff[(x * 8) + col] = (tmp[0] + 0x4000) >> 15;
-#else
-         int32 sum = 0;
-         unsigned u;
-
-         for(u = 0; u < 8; u++)
-            sum += (in_coeff[(col * 8) + u] * IDCTMatrix[(x * 8) + u]);
-
-         if(sizeof(T) == 1)
-            out_coeff[(col * 8) + x] = Mask9ClampS8((sum + 0x4000) >> 15);
-         else
-            out_coeff[(x * 8) + col] = (sum + 0x4000) >> 15;
-#endif
-      }
-   }
-}
-
-static void IDCT(int16 *in_coeff, int8 *out_coeff)
-{
-   MDFN_ALIGN(16) int16 tmpbuf[64];
-
-   IDCT_1D_Multi<int16>(in_coeff, tmpbuf);
-   IDCT_1D_Multi<int8>(tmpbuf, out_coeff);
-}
-
-static INLINE void YCbCr_to_RGB(const int8 y, const int8 cb, const int8 cr, int &r, int &g, int &b)
-{
-   // The formula for green is still a bit off(precision/rounding issues when both cb and cr are non-zero).
-   r = Mask9ClampS8(y + (((359 * cr) + 0x80) >> 8));
-   //g = Mask9ClampS8(y + (((-88 * cb) + (-183 * cr) + 0x80) >> 8));
-   g = Mask9ClampS8(y + ((((-88 * cb) &~ 0x1F) + ((-183 * cr) &~ 0x07) + 0x80) >> 8));
-   b = Mask9ClampS8(y + (((454 * cb) + 0x80) >> 8));
-
-   r ^= 0x80;
-   g ^= 0x80;
-   b ^= 0x80;
-}
-
-static INLINE uint16 RGB_to_RGB555(uint8 r, uint8 g, uint8 b)
-{
-   r = (r + 4) >> 3;
-   g = (g + 4) >> 3;
-   b = (b + 4) >> 3;
-
-   if(r > 0x1F)
-      r = 0x1F;
-
-   if(g > 0x1F)
-      g = 0x1F;
-
-   if(b > 0x1F)
-      b = 0x1F;
-
-   return((r << 0) | (g << 5) | (b << 10));
-}
+#include "mdec_kernels.inc"
 
 static void EncodeImage(const unsigned ybn)
 {
@@ -375,17 +287,8 @@ static void EncodeImage(const unsigned ybn)
                const int8* cb = &block_cb[(y >> 1) | ((ybn & 2) << 1)][(ybn & 1) << 2];
                const int8* cr = &block_cr[(y >> 1) | ((ybn & 2) << 1)][(ybn & 1) << 2];
 
-               for(int x = 0; x < 8; x++)
-               {
-                  int r, g, b;
-
-                  YCbCr_to_RGB(by[x], cb[x >> 1], cr[x >> 1], r, g, b);
-
-                  pix_out[0] = r ^ rgb_xor;
-                  pix_out[1] = g ^ rgb_xor;
-                  pix_out[2] = b ^ rgb_xor;
-                  pix_out += 3;
-               }
+               YCbCr_to_RGB888_Row(pix_out, by, cb, cr, rgb_xor);
+               pix_out += 24;
             }
             PixelBufferCount32 = 48;
          }
@@ -402,15 +305,8 @@ static void EncodeImage(const unsigned ybn)
                const int8* cb = &block_cb[(y >> 1) | ((ybn & 2) << 1)][(ybn & 1) << 2];
                const int8* cr = &block_cr[(y >> 1) | ((ybn & 2) << 1)][(ybn & 1) << 2];
 
-               for(int x = 0; x < 8; x++)
-               {
-                  int r, g, b;
-
-                  YCbCr_to_RGB(by[x], cb[x >> 1], cr[x >> 1], r, g, b);
-
-                  StoreU16_LE(pix_out, pixel_xor ^ RGB_to_RGB555(r, g, b));
-                  pix_out++;
-               }
+               YCbCr_to_RGB555_Row(pix_out, by, cb, cr, pixel_xor);
+               pix_out += 8;
             }
             PixelBufferCount32 = 32;
          }
@@ -707,6 +603,12 @@ bool MDEC_DMACanRead(void)
  return((OutFIFO.in_count >= 0x20) && (Control & (1U << 29)));
 }
 
+// True while a command is being run, including while it's waiting on more of its data.
+bool MDEC_Busy(void)
+{
+ return InCommand;
+}
+
 void MDEC_Write(const int32_t timestamp, uint32 A, uint32 V)
 {
    //PSX_WARNING("[MDEC] Write: 0x%08x 0x%08x, %d  --- %u %u", A, V, timestamp, InFIFO.in_count, OutFIFO.in_count);
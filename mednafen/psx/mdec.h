@@ -12,6 +12,7 @@ void MDEC_Power(void);
 
 bool MDEC_DMACanWrite(void);
 bool MDEC_DMACanRead(void);
+bool MDEC_Busy(void);
 void MDEC_Run(int32 clocks);
 
 int MDEC_StateAction(StateMem *sm, int load, int data_only);
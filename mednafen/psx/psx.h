@@ -101,6 +101,7 @@ extern PS_CPU *PSX_CPU;
 extern PS_CDC *PSX_CDC;
 extern PS_SPU *PSX_SPU;
 extern MultiAccessSizeMem<2048 * 1024, uint32_t, false> MainRAM;
+extern StateDirty MainRAM_Dirty;
 
 #define OVERCLOCK_SHIFT 8
 extern int32_t psx_overclock_factor;
@@ -73,25 +73,34 @@
 
 #include "../state_helpers.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define HAVE_SPU_SSE2 1
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(MSB_FIRST)
+#include <arm_neon.h>
+#define HAVE_SPU_NEON 1
+#endif
+
 uint32_t IntermediateBufferPos;
 int16_t IntermediateBuffer[4096][2];
 
-//#define SPUIRQ_DBG(format, ...) { printf("[SPUIRQDBG] " format " -- Voice 22 CA=0x%06x,LA=0x%06x\n", ## __VA_ARGS__, Voices[22].CurAddr, Voices[22].LoopAddr); }
+/* SPU RAM pages written since the last savestate, see StateDirty */
+static StateDirty SPURAM_Dirty;
+
+//#define SPUIRQ_DBG(format, ...) { printf("[SPUIRQDBG] " format " -- Voice 22 CA=0x%06x,LA=0x%06x\n", ## __VA_ARGS__, VoiceCurAddr[22], VoiceLoopAddr[22]); }
 
 static INLINE void SPUIRQ_DBG(const char *fmt, ...)
 {
 }
 
-static const int16 FIR_Table[256][4] =
-{
-#include "spu_fir_table.inc"
-};
+#include "spu_kernels.inc"
 
 PS_SPU::PS_SPU()
 {
    IntermediateBufferPos = 0;
    memset(IntermediateBuffer, 0, sizeof(IntermediateBuffer));
 
+   StateDirty_Init(&SPURAM_Dirty, sizeof(SPURAM));
 }
 
 PS_SPU::~PS_SPU()
@@ -101,8 +110,10 @@ PS_SPU::~PS_SPU()
 void PS_SPU::Power(void)
 {
    clock_divider = 768;
+   PendingSamples = 0;
 
    memset(SPURAM, 0, sizeof(SPURAM));
+   StateDirty_MarkAll(&SPURAM_Dirty);
 
    for(int i = 0; i < 24; i++)
    {
@@ -124,20 +135,21 @@ void PS_SPU::Power(void)
       Voices[i].Sweep[0].Power();
       Voices[i].Sweep[1].Power();
 
-      Voices[i].Pitch = 0;
-      Voices[i].CurPhase = 0;
+      VoicePitch[i] = 0;
+      VoiceCurPhase[i] = 0;
 
-      Voices[i].StartAddr = 0;
+      VoiceStartAddr[i] = 0;
 
-      Voices[i].CurAddr = 0;
+      VoiceCurAddr[i] = 0;
 
       Voices[i].ADSRControl = 0;
 
-      Voices[i].LoopAddr = 0;
+      VoiceLoopAddr[i] = 0;
 
       Voices[i].PreLRSample = 0;
 
       memset(&Voices[i].ADSR, 0, sizeof(SPU_ADSR));
+      VoiceEnvLevel[i] = 0;
    }
 
    GlobalSweep[0].Power();
@@ -305,12 +317,15 @@ void PS_SPU::RunDecoder(SPU_Voice *voice)
       {  98,  -55 },
       { 122,  -60 },
    };
+   const unsigned voice_num = voice - Voices;
+   uint32 &CurAddr = VoiceCurAddr[voice_num];
+   uint32 &LoopAddr = VoiceLoopAddr[voice_num];
 
    if(voice->DecodeAvail >= 11)
    {
       if(SPUControl & 0x40)
       {
-         unsigned test_addr = (voice->CurAddr - 1) & 0x3FFFF;
+         unsigned test_addr = (CurAddr - 1) & 0x3FFFF;
          if(IRQAddr == test_addr || IRQAddr == (test_addr & 0x3FFF8))
          {
             //SPUIRQ_DBG("SPU IRQ (VDA): 0x%06x", addr);
@@ -321,7 +336,7 @@ void PS_SPU::RunDecoder(SPU_Voice *voice)
       return;
    }
 
-   if((voice->CurAddr & 0x7) == 0)
+   if((CurAddr & 0x7) == 0)
    {
       // Handle delayed flags from the previously-decoded block.
       //
@@ -333,16 +348,16 @@ void PS_SPU::RunDecoder(SPU_Voice *voice)
       // have to separate the CurAddr = LoopAddr logic, so we don't generate spurious early SPU IRQs.
       if(voice->DecodeFlags & 0x1)
       {
-         voice->CurAddr = voice->LoopAddr & ~0x7;
+         CurAddr = LoopAddr & ~0x7;
 
-         BlockEnd |= 1 << (voice - Voices);
+         BlockEnd |= 1 << voice_num;
 
          if(!(voice->DecodeFlags & 0x2))	// Force enveloping to 0 if not "looping".  TODO: Should we reset the ADSR divider counter too?
          {
-            if(!(Noise_Mode & (1 << (voice - Voices))))
+            if(!(Noise_Mode & (1 << voice_num)))
             {
                voice->ADSR.Phase = ADSR_RELEASE;
-               voice->ADSR.EnvLevel = 0;
+               VoiceEnvLevel[voice_num] = 0;
             }
          }
       }
@@ -353,7 +368,7 @@ void PS_SPU::RunDecoder(SPU_Voice *voice)
 
       if(SPUControl & 0x40)
       {
-         unsigned test_addr = voice->CurAddr & 0x3FFFF;
+         unsigned test_addr = CurAddr & 0x3FFFF;
          if(IRQAddr == test_addr || IRQAddr == (test_addr & 0x3FFF8))
          {
             //SPUIRQ_DBG("SPU IRQ: 0x%06x", addr);
@@ -362,9 +377,9 @@ void PS_SPU::RunDecoder(SPU_Voice *voice)
          }
       }
 
-      if((voice->CurAddr & 0x7) == 0)
+      if((CurAddr & 0x7) == 0)
       {
-         const uint16 CV = SPURAM[voice->CurAddr];
+         const uint16 CV = SPURAM[CurAddr];
          voice->DecodeShift = CV & 0xF;
          voice->DecodeWeight = (CV >> 4) & 0xF;
          voice->DecodeFlags = (CV >> 8) & 0xFF;
@@ -373,17 +388,17 @@ void PS_SPU::RunDecoder(SPU_Voice *voice)
          {
             if(!voice->IgnoreSampLA)
             {
-               voice->LoopAddr = voice->CurAddr;
+               LoopAddr = CurAddr;
             }
             else
             {
-               if(voice->LoopAddr != voice->CurAddr)
+               if(LoopAddr != CurAddr)
                {
-                  PSX_DBG(PSX_DBG_FLOOD, "[SPU] Ignore: LoopAddr=0x%08x, SampLA=0x%08x\n", voice->LoopAddr, voice->CurAddr);
+                  PSX_DBG(PSX_DBG_FLOOD, "[SPU] Ignore: LoopAddr=0x%08x, SampLA=0x%08x\n", LoopAddr, CurAddr);
                }
             }
          }
-         voice->CurAddr = (voice->CurAddr + 1) & 0x3FFFF;
+         CurAddr = (CurAddr + 1) & 0x3FFFF;
       }
 
       //
@@ -398,12 +413,12 @@ void PS_SPU::RunDecoder(SPU_Voice *voice)
          uint32 coded;
          int16 *tb = &voice->DecodeBuffer[voice->DecodeWritePos];
 
-         CV = SPURAM[voice->CurAddr];
+         CV = SPURAM[CurAddr];
          shift = voice->DecodeShift;
 
          if(MDFN_UNLIKELY(shift > 12))
          {
-            //PSX_DBG(PSX_DBG_FLOOD, "[SPU] Buggy/Illegal ADPCM block shift value on voice %u: %u\n", (unsigned)(voice - Voices), shift);
+            //PSX_DBG(PSX_DBG_FLOOD, "[SPU] Buggy/Illegal ADPCM block shift value on voice %u: %u\n", (unsigned)voice_num, shift);
 
             shift = 8;
             CV &= 0x8888;
@@ -428,7 +443,7 @@ void PS_SPU::RunDecoder(SPU_Voice *voice)
          }
          voice->DecodeWritePos = (voice->DecodeWritePos + 4) & 0x1F;
          voice->DecodeAvail += 4;
-         voice->CurAddr = (voice->CurAddr + 1) & 0x3FFFF;
+         CurAddr = (CurAddr + 1) & 0x3FFFF;
       }
    }
 }
@@ -461,7 +476,7 @@ void PS_SPU::ResetEnvelope(SPU_Voice *voice)
 {
    SPU_ADSR *ADSR = &voice->ADSR;
 
-   ADSR->EnvLevel = 0;
+   VoiceEnvLevel[voice - Voices] = 0;
    ADSR->Divider = 0;
    ADSR->Phase = ADSR_ATTACK;
 }
@@ -478,11 +493,12 @@ void PS_SPU::ReleaseEnvelope(SPU_Voice *voice)
 void PS_SPU::RunEnvelope(SPU_Voice *voice)
 {
    SPU_ADSR *ADSR = &voice->ADSR;
+   uint16 &EnvLevel = VoiceEnvLevel[voice - Voices];
    int increment;
    int divinco;
    int16 uoflow_reset;
 
-   if(ADSR->Phase == ADSR_ATTACK && ADSR->EnvLevel == 0x7FFF)
+   if(ADSR->Phase == ADSR_ATTACK && EnvLevel == 0x7FFF)
       ADSR->Phase++;
 
    //static INLINE void CalcVCDelta(const uint8 zs, uint8 speed, bool log_mode, bool decrement, bool inv_increment, int16 Current, int &increment, int &divinco)
@@ -492,22 +508,22 @@ void PS_SPU::RunEnvelope(SPU_Voice *voice)
                break;
 
       case ADSR_ATTACK:
-               CalcVCDelta(0x7F, ADSR->AttackRate, ADSR->AttackExp, false, false, (int16)ADSR->EnvLevel, increment, divinco);
+               CalcVCDelta(0x7F, ADSR->AttackRate, ADSR->AttackExp, false, false, (int16)EnvLevel, increment, divinco);
                uoflow_reset = 0x7FFF;
                break;
 
       case ADSR_DECAY:
-               CalcVCDelta(0x1F << 2, ADSR->DecayRate, true, true, true, (int16)ADSR->EnvLevel, increment, divinco);
+               CalcVCDelta(0x1F << 2, ADSR->DecayRate, true, true, true, (int16)EnvLevel, increment, divinco);
                uoflow_reset = 0;
                break;
 
       case ADSR_SUSTAIN:
-               CalcVCDelta(0x7F, ADSR->SustainRate, ADSR->SustainExp, ADSR->SustainDec, ADSR->SustainDec, (int16)ADSR->EnvLevel, increment, divinco);
+               CalcVCDelta(0x7F, ADSR->SustainRate, ADSR->SustainExp, ADSR->SustainDec, ADSR->SustainDec, (int16)EnvLevel, increment, divinco);
                uoflow_reset = ADSR->SustainDec ? 0 : 0x7FFF;
                break;
 
       case ADSR_RELEASE:
-               CalcVCDelta(0x1F << 2, ADSR->ReleaseRate, ADSR->ReleaseExp, true, true, (int16)ADSR->EnvLevel, increment, divinco);
+               CalcVCDelta(0x1F << 2, ADSR->ReleaseRate, ADSR->ReleaseExp, true, true, (int16)EnvLevel, increment, divinco);
                uoflow_reset = 0;
                break;
    }
@@ -515,23 +531,23 @@ void PS_SPU::RunEnvelope(SPU_Voice *voice)
    ADSR->Divider += divinco;
    if(ADSR->Divider & 0x8000)
    {
-      const uint16 prev_level = ADSR->EnvLevel;
+      const uint16 prev_level = EnvLevel;
 
       ADSR->Divider = 0;
-      ADSR->EnvLevel += increment;
+      EnvLevel += increment;
 
       if(ADSR->Phase == ADSR_ATTACK)
       {
          // If previous the upper bit was 0, but now it's 1, handle overflow.
-         if(((prev_level ^ ADSR->EnvLevel) & ADSR->EnvLevel) & 0x8000)
-            ADSR->EnvLevel = uoflow_reset;
+         if(((prev_level ^ EnvLevel) & EnvLevel) & 0x8000)
+            EnvLevel = uoflow_reset;
       }
       else
       {
-         if(ADSR->EnvLevel & 0x8000)
-            ADSR->EnvLevel = uoflow_reset;
+         if(EnvLevel & 0x8000)
+            EnvLevel = uoflow_reset;
       }
-      if(ADSR->Phase == ADSR_DECAY && (uint16)ADSR->EnvLevel < ADSR->SustainLevel)
+      if(ADSR->Phase == ADSR_DECAY && (uint16)EnvLevel < ADSR->SustainLevel)
          ADSR->Phase++;
    }
 }
@@ -553,6 +569,7 @@ INLINE void PS_SPU::WriteSPURAM(uint32 addr, uint16 value)
 {
    CheckIRQAddr(addr);
 
+   StateDirty_Mark(&SPURAM_Dirty, addr << 1);
    SPURAM[addr] = value;
 }
 
@@ -562,18 +579,6 @@ INLINE uint16 PS_SPU::ReadSPURAM(uint32 addr)
    return(SPURAM[addr]);
 }
 
-static INLINE int16 ReverbSat(int32 samp)
-{
- if(samp > 32767)
-  samp = 32767;
-
- if(samp < -32768)
-  samp = -32768;
-
- return(samp);
-}
-
-
 INLINE uint32 PS_SPU::Get_Reverb_Offset(uint32 in_offset)
 {
  uint32 offset = ReverbCur + (in_offset & 0x3FFFF);
@@ -589,67 +594,16 @@ INLINE uint32 PS_SPU::Get_Reverb_Offset(uint32 in_offset)
  return(offset);
 }
 
-int16 NO_INLINE PS_SPU::RD_RVB(uint16 raw_offs, int32 extra_offs)
+INLINE int16 PS_SPU::RD_RVB(uint16 raw_offs, int32 extra_offs)
 {
  return ReadSPURAM(Get_Reverb_Offset((raw_offs << 2) + extra_offs));
 }
 
-void NO_INLINE PS_SPU::WR_RVB(uint16 raw_offs, int16 sample)
+INLINE void PS_SPU::WR_RVB(uint16 raw_offs, int16 sample)
 {
    WriteSPURAM(Get_Reverb_Offset(raw_offs << 2), sample);
 }
 
-//
-// Zeroes optimized out; middle removed too(it's 16384)
-static const int16 ResampTable[20] =
-{
- -1, 2, -10, 35, -103, 266, -616, 1332, -2960, 10246, 10246, -2960, 1332, -616, 266, -103, 35, -10, 2, -1,
-};
-
-static INLINE int32 Reverb4422(const int16 *src)
-{
- int32 out = 0;	// 32-bits is adequate(it won't overflow)
-
- for(unsigned i = 0; i < 20; i++)
-  out += ResampTable[i] * src[i * 2];
-
- // Middle non-zero
- out += 0x4000 * src[19];
-
- out >>= 15;
-
- clamp(&out, -32768, 32767);
-
- return(out);
-}
-
-static INLINE int32 Reverb2244(const int16 *src)
-{
-   unsigned i;
-   int32_t out = 0; /* 32bits is adequate (it won't overflow) */
-
-   for(i = 0; i < 20; i++)
-   out += ResampTable[i] * src[i];
-
-   out >>= 14;
-
-   clamp(&out, -32768, 32767);
-
-   return out;
-}
-
-static int32 IIASM(const int16 IIR_ALPHA, const int16 insamp)
-{
-   if(MDFN_UNLIKELY(IIR_ALPHA == -32768))
-   {
-      if(insamp == -32768)
-         return 0;
-      return insamp * -65536;
-   }
-
-   return insamp * (32768 - IIR_ALPHA);
-}
-
 //
 // Take care to thoroughly test the reverb resampling code when modifying anything that uses RvbResPos.
 //
@@ -668,41 +622,54 @@ void PS_SPU::RunReverb(const int32* in, int32* out)
 
  if(RvbResPos & 1)
  {
-  int32 downsampled[2];
-
-  for(unsigned lr = 0; lr < 2; lr++)
-   downsampled[lr] = Reverb4422(&RDSB[lr][(RvbResPos - 39) & 0x3F]);
-
   /* Run algorithm */
   if(SPUControl & 0x80)
   {
-   int16 ACC0, ACC1;
+   int32 downsampled[2];
+
+   for(unsigned lr = 0; lr < 2; lr++)
+    downsampled[lr] = Reverb4422(&RDSB[lr][(RvbResPos - 39) & 0x3F]);
+
+   int16 iir_src[4], iir_prev[4], iir_in[4], iir_in_coef[4], iir[4];
+   int16 acc_src[8], acc[2];
    int16 FB_A0, FB_A1, FB_B0, FB_B1;
 
-   int16 IIR_INPUT_A0 = ReverbSat(((RD_RVB(IIR_SRC_A0) * IIR_COEF) >> 15) + ((downsampled[0] * IN_COEF_L) >> 15));
-   int16 IIR_INPUT_A1 = ReverbSat(((RD_RVB(IIR_SRC_A1) * IIR_COEF) >> 15) + ((downsampled[1] * IN_COEF_R) >> 15));
-   int16 IIR_INPUT_B0 = ReverbSat(((RD_RVB(IIR_SRC_B0) * IIR_COEF) >> 15) + ((downsampled[0] * IN_COEF_L) >> 15));
-   int16 IIR_INPUT_B1 = ReverbSat(((RD_RVB(IIR_SRC_B1) * IIR_COEF) >> 15) + ((downsampled[1] * IN_COEF_R) >> 15));
+   iir_src[0] = RD_RVB(IIR_SRC_A0);
+   iir_src[1] = RD_RVB(IIR_SRC_A1);
+   iir_src[2] = RD_RVB(IIR_SRC_B0);
+   iir_src[3] = RD_RVB(IIR_SRC_B1);
 
-   int16 IIR_A0 = ReverbSat((((IIR_INPUT_A0 * IIR_ALPHA) >> 14) + (IIASM(IIR_ALPHA, RD_RVB(IIR_DEST_A0, -1)) >> 14)) >> 1);
-   int16 IIR_A1 = ReverbSat((((IIR_INPUT_A1 * IIR_ALPHA) >> 14) + (IIASM(IIR_ALPHA, RD_RVB(IIR_DEST_A1, -1)) >> 14)) >> 1);
-   int16 IIR_B0 = ReverbSat((((IIR_INPUT_B0 * IIR_ALPHA) >> 14) + (IIASM(IIR_ALPHA, RD_RVB(IIR_DEST_B0, -1)) >> 14)) >> 1);
-   int16 IIR_B1 = ReverbSat((((IIR_INPUT_B1 * IIR_ALPHA) >> 14) + (IIASM(IIR_ALPHA, RD_RVB(IIR_DEST_B1, -1)) >> 14)) >> 1);
+   iir_prev[0] = RD_RVB(IIR_DEST_A0, -1);
+   iir_prev[1] = RD_RVB(IIR_DEST_A1, -1);
+   iir_prev[2] = RD_RVB(IIR_DEST_B0, -1);
+   iir_prev[3] = RD_RVB(IIR_DEST_B1, -1);
 
-   WR_RVB(IIR_DEST_A0, IIR_A0);
-   WR_RVB(IIR_DEST_A1, IIR_A1);
-   WR_RVB(IIR_DEST_B0, IIR_B0);
-   WR_RVB(IIR_DEST_B1, IIR_B1);
+   for(unsigned i = 0; i < 4; i++)
+   {
+    iir_in[i] = downsampled[i & 1];
+    iir_in_coef[i] = (i & 1) ? IN_COEF_R : IN_COEF_L;
+   }
+
+   ReverbIIR(iir_src, iir_prev, iir_in, iir_in_coef, IIR_COEF, IIR_ALPHA, iir);
+
+   WR_RVB(IIR_DEST_A0, iir[0]);
+   WR_RVB(IIR_DEST_A1, iir[1]);
+   WR_RVB(IIR_DEST_B0, iir[2]);
+   WR_RVB(IIR_DEST_B1, iir[3]);
 
-   ACC0 = ReverbSat((((RD_RVB(ACC_SRC_A0) * ACC_COEF_A) >> 14) +
-	   	     ((RD_RVB(ACC_SRC_B0) * ACC_COEF_B) >> 14) +
-	   	     ((RD_RVB(ACC_SRC_C0) * ACC_COEF_C) >> 14) +
-	   	     ((RD_RVB(ACC_SRC_D0) * ACC_COEF_D) >> 14)) >> 1);
+   acc_src[0] = RD_RVB(ACC_SRC_A0);
+   acc_src[1] = RD_RVB(ACC_SRC_B0);
+   acc_src[2] = RD_RVB(ACC_SRC_C0);
+   acc_src[3] = RD_RVB(ACC_SRC_D0);
+   acc_src[4] = RD_RVB(ACC_SRC_A1);
+   acc_src[5] = RD_RVB(ACC_SRC_B1);
+   acc_src[6] = RD_RVB(ACC_SRC_C1);
+   acc_src[7] = RD_RVB(ACC_SRC_D1);
 
-   ACC1 = ReverbSat((((RD_RVB(ACC_SRC_A1) * ACC_COEF_A) >> 14) +
-	   	     ((RD_RVB(ACC_SRC_B1) * ACC_COEF_B) >> 14) +
-	   	     ((RD_RVB(ACC_SRC_C1) * ACC_COEF_C) >> 14) +
-	   	     ((RD_RVB(ACC_SRC_D1) * ACC_COEF_D) >> 14)) >> 1);
+   ReverbACC(acc_src, &ACC_COEF_A, acc);
+
+   const int16 ACC0 = acc[0];
+   const int16 ACC1 = acc[1];
 
    FB_A0 = RD_RVB(MIX_DEST_A0 - FB_SRC_A);
    FB_A1 = RD_RVB(MIX_DEST_A1 - FB_SRC_A);
@@ -730,7 +697,7 @@ void PS_SPU::RunReverb(const int32* in, int32* out)
      upsampled[lr] = src[9]; /* Reverb 2244 (Middle non-zero */
   }
  }
- else
+ else if(ReverbVol[0] | ReverbVol[1])	// Nothing to hear otherwise, and upsampling keeps no state of its own.
  {
   for(unsigned lr = 0; lr < 2; lr++)
   {
@@ -776,126 +743,207 @@ INLINE void PS_SPU::RunNoise(void)
 
 int32 PS_SPU::UpdateFromCDC(int32 clocks)
 {
-   //int32 clocks = timestamp - lastts;
-   int32 sample_clocks = 0;
-   //lastts = timestamp;
-
    clock_divider -= clocks;
 
    while(clock_divider <= 0)
    {
       clock_divider += 768;
-      sample_clocks++;
+      PendingSamples++;
    }
 
-   while(sample_clocks > 0)
+   // Samples are rendered a block at a time, except when an SPU IRQ could be raised, which has to happen at the right
+   // time.
+   if(PendingSamples >= SPU_BLOCK_SIZE || ((SPUControl & 0x40) && !IRQAsserted))
+      FlushSamples();
+
+   //assert(clock_divider < 768);
+
+   return clock_divider;
+}
+
+void PS_SPU::FlushSamples(void)
+{
+   while(PendingSamples > 0)
    {
-      // xxx[0] = left, xxx[1] = right
+      unsigned count = (PendingSamples > SPU_BLOCK_SIZE) ? SPU_BLOCK_SIZE : PendingSamples;
 
-      // Accumulated sound output.
-      int32 accum[2];
+      if(count > 1 && !CanRenderBlock())
+         count = 1;
 
-      // Accumulated sound output for reverb input
-      int32 accum_fv[2];
+      RenderSamples(count);
+      PendingSamples -= count;
+   }
+}
 
-      // Output of reverb processing.
-      int32 reverb[2];
+//
+// Whether the next SPU_BLOCK_SIZE samples can be rendered voice by voice instead of sample by sample, with the same
+// results.  That holds so long as no SPU IRQ can be raised, and no voice can read SPU RAM that's written while the
+// block is rendered: the CD audio and voice 1/3 capture areas, and the reverb work area if reverb writes are enabled.
+// A voice doesn't get through more than ~80 words of SPU RAM in a block, so checking where it starts and loops to is
+// enough.
+//
+bool PS_SPU::CanRenderBlock(void)
+{
+   const uint32 lower = 0x800;
+   const uint32 upper = ((SPUControl & 0x80) ? ReverbWA : 0x40000) - 0x100;
 
-      // Final output.
-      int32 output[2];
+   if((SPUControl & 0x40) && !IRQAsserted)
+      return false;
 
-      accum[0]    = accum[1]    = 0;
-      accum_fv[0] = accum_fv[1] = 0;
-      reverb[0]   = reverb[1]   = 0;
-      output[0]   = output[1]   = 0;
+   if(upper < lower || upper > 0x40000)
+      return false;
 
-      const uint32 PhaseModCache = FM_Mode & ~ 1;
-      /*
-       **
-       ** 0x1F801DAE Notes and Conjecture:
-       **   -------------------------------------------------------------------------------------
-       **   |   15   14 | 13 | 12 | 11 | 10  | 9  | 8 |  7 |  6  | 5    4    3    2    1    0   |
-       **   |      ?    | *13| ?  | ba | *10 | wrr|rdr| df |  is |      c                       |
-       **   -------------------------------------------------------------------------------------
-       **
-       **	c - Appears to be delayed copy of lower 6 bits from 0x1F801DAA.
-       **
-       **     is - Interrupt asserted out status. (apparently not instantaneous status though...)
-       **
-       **     df - Related to (c & 0x30) == 0x20 or (c & 0x30) == 0x30, at least.
-       **          0 = DMA busy(FIFO not empty when in DMA write mode?)?
-       **	    1 = DMA ready?  Something to do with the FIFO?
-       **
-       **     rdr - Read(DMA read?) Ready?
-       **
-       **     wrr - Write(DMA write?) Ready?
-       **
-       **     *10 - Unknown.  Some sort of (FIFO?) busy status?(BIOS tests for this bit in places)
-       **
-       **     ba - Alternates between 0 and 1, even when SPUControl bit15 is 0; might be related to CD audio and voice 1 and 3 writing to SPU RAM.
-       **
-       **     *13 - Unknown, was set to 1 when testing with an SPU delay system reg value of 0x200921E1(test result might not be reliable, re-run).
-       */
-      SPUStatus = SPUControl & 0x3F;
-      SPUStatus |= IRQAsserted ? 0x40 : 0x00;
+   for(unsigned voice_num = 0; voice_num < 24; voice_num++)
+   {
+      const SPU_Voice *voice = &Voices[voice_num];
 
-      if(Regs[0xD6] == 0x4)	// TODO: Investigate more(case 0x2C in global regs r/w handler)
-         SPUStatus |= (CWA & 0x100) ? 0x800 : 0x000;
+      // Stopped(pitch of 0) with its decode buffer full, so it won't read anything.
+      if(!VoicePitch[voice_num] && voice->DecodeAvail >= 11 && !(VoiceOn & (1U << voice_num)))
+         continue;
 
-      for(int voice_num = 0; voice_num < 24; voice_num++)
-      {
-         SPU_Voice *voice = &Voices[voice_num];
-         int32 voice_pvs;
+      if(VoiceCurAddr[voice_num] < lower || VoiceCurAddr[voice_num] >= upper)
+         return false;
 
-         voice->PreLRSample = 0;
+      if(VoiceLoopAddr[voice_num] < lower || VoiceLoopAddr[voice_num] >= upper)
+         return false;
 
-         //PSX_WARNING("[SPU] Voice %d CurPhase=%08x, pitch=%04x, CurAddr=%08x", voice_num, voice->CurPhase, voice->Pitch, voice->CurAddr);
+      if((VoiceOn & (1U << voice_num)) && ((VoiceStartAddr[voice_num] & ~0x7) < lower || (VoiceStartAddr[voice_num] & ~0x7) >= upper))
+         return false;
+   }
 
-         //
-         // Decode new samples if necessary.
-         //
-         RunDecoder(voice);
+   return true;
+}
 
+//
+// Renders "count" samples, each voice through all of them before the next voice, then the CD audio, reverb and
+// output for each.  With count > 1, CanRenderBlock() has to be true.
+//
+void PS_SPU::RenderSamples(const unsigned count)
+{
+   // xxx[s][0] = left, xxx[s][1] = right
+
+   // Accumulated sound output.
+   int32 accum[SPU_BLOCK_SIZE][2];
+
+   // Accumulated sound output for reverb input
+   int32 accum_fv[SPU_BLOCK_SIZE][2];
+
+   // Voice 1 and 3 output, for writing to SPU RAM.
+   int16 capture[2][SPU_BLOCK_SIZE];
+
+   // Output of the voice before the one being rendered(for FM), and of that one.
+   int32 pvs_buf[2][SPU_BLOCK_SIZE];
+   int32 *prev_pvs = pvs_buf[0];
+   int32 *cur_pvs = pvs_buf[1];
+
+   // Noise generator output.
+   int16 noise[SPU_BLOCK_SIZE];
+
+   const uint32 PhaseModCache = FM_Mode & ~ 1;
+   const bool irq_asserted = IRQAsserted;
+   uint32 silent_mask = 0;
+
+   memset(accum, 0, sizeof(accum[0]) * count);
+   memset(accum_fv, 0, sizeof(accum_fv[0]) * count);
+
+   //
+   // A voice released all the way down to zero, and not being keyed on, outputs nothing for the rest of the block;
+   // its envelope can't leave zero without a key on or a register write, and either of those ends the block.  Its
+   // decoder, sweeps, envelope divider and phase are still run, for the IRQ, ENDX and register side effects.
+   //
+   for(int voice_num = 0; voice_num < 24; voice_num++)
+   {
+      if(!VoiceEnvLevel[voice_num] && Voices[voice_num].ADSR.Phase == ADSR_RELEASE && !(VoiceOn & (1U << voice_num)))
+         silent_mask |= 1U << voice_num;
+   }
+
+   if(Noise_Mode & ~silent_mask)
+   {
+      const uint32 saved_divider = NoiseDivider;
+      const uint32 saved_counter = NoiseCounter;
+      const uint16 saved_lfsr = LFSR;
+
+      for(unsigned s = 0; s < count; s++)
+      {
+         noise[s] = LFSR;
+         RunNoise();
+      }
+
+      NoiseDivider = saved_divider;
+      NoiseCounter = saved_counter;
+      LFSR = saved_lfsr;
+   }
+
+   for(int voice_num = 0; voice_num < 24; voice_num++)
+   {
+      SPU_Voice *voice = &Voices[voice_num];
+      const bool silent = (silent_mask >> voice_num) & 1;
+      const bool noise_on = (Noise_Mode >> voice_num) & 1;
+      const bool fm_on = (PhaseModCache >> voice_num) & 1;
+      const bool reverb_on = (Reverb_Mode >> voice_num) & 1;
+      // With the SPU muted, only a voice's capture to SPU RAM and its modulation of the next voice are left to
+      // hear; for any other voice, just the last sample is worked out, for PreLRSample.
+      const bool unheard = silent || (!(SPUControl & 0x4000) && voice_num != 1 && voice_num != 3 && !((PhaseModCache >> (voice_num + 1)) & 1));
+      int silent_increment, silent_divinco;
+
+      if(silent)
+         CalcVCDelta(0x1F << 2, voice->ADSR.ReleaseRate, voice->ADSR.ReleaseExp, true, true, 0, silent_increment, silent_divinco);
+
+      //PSX_WARNING("[SPU] Voice %d CurPhase=%08x, pitch=%04x, CurAddr=%08x", voice_num, VoiceCurPhase[voice_num], VoicePitch[voice_num], VoiceCurAddr[voice_num]);
+
+      for(unsigned s = 0; s < count; s++)
+      {
+         int32 voice_pvs;
+         int l, r;
+
+         voice->PreLRSample = 0;
 
          //
+         // Decode new samples if necessary.  With the decode buffer full, all RunDecoder() would do is check for an
+         // SPU IRQ, which can't happen in a block.
          //
-         //
-         int l, r;
+         if(count == 1 || voice->DecodeAvail < 11)
+            RunDecoder(voice);
 
-         if(Noise_Mode & (1 << voice_num))
-            voice_pvs = (int16)LFSR;
+         if(silent || (unheard && s != (count - 1)))
+            voice_pvs = 0;
          else
          {
-            const int si = voice->DecodeReadPos;
-            const int pi = ((voice->CurPhase & 0xFFF) >> 4);
+            if(noise_on)
+               voice_pvs = noise[s];
+            else
+               voice_pvs = InterpolateVoice(voice->DecodeBuffer, voice->DecodeReadPos, VoiceCurPhase[voice_num]);
 
-            voice_pvs = ((voice->DecodeBuffer[(si + 0) & 0x1F] * FIR_Table[pi][0]) +
-                  (voice->DecodeBuffer[(si + 1) & 0x1F] * FIR_Table[pi][1]) +
-                  (voice->DecodeBuffer[(si + 2) & 0x1F] * FIR_Table[pi][2]) +   
-                  (voice->DecodeBuffer[(si + 3) & 0x1F] * FIR_Table[pi][3])) >> 15;
+            voice_pvs = (voice_pvs * (int16)VoiceEnvLevel[voice_num]) >> 15;
          }
-
-         voice_pvs = (voice_pvs * (int16)voice->ADSR.EnvLevel) >> 15;
          voice->PreLRSample = voice_pvs;
+         cur_pvs[s] = voice_pvs;
 
+         // Written to SPU RAM along with the CD audio below, except for a lone sample, where a voice after this one
+         // could be reading it back right away.
          if(voice_num == 1 || voice_num == 3)
          {
             int index = voice_num >> 1;
 
-            WriteSPURAM(0x400 | (index * 0x200) | CWA, voice_pvs);
+            if(count == 1)
+               WriteSPURAM(0x400 | (index * 0x200) | CWA, voice_pvs);
+            else
+               capture[index][s] = voice_pvs;
          }
 
+         if(!unheard)
+         {
+            l = (voice_pvs * voice->Sweep[0].ReadVolume()) >> 15;
+            r = (voice_pvs * voice->Sweep[1].ReadVolume()) >> 15;
 
-         l = (voice_pvs * voice->Sweep[0].ReadVolume()) >> 15;
-         r = (voice_pvs * voice->Sweep[1].ReadVolume()) >> 15;
-
-         accum[0] += l;
-         accum[1] += r;
+            accum[s][0] += l;
+            accum[s][1] += r;
 
-         if(Reverb_Mode & (1 << voice_num))
-         {
-            accum_fv[0] += l;
-            accum_fv[1] += r;
+            if(reverb_on)
+            {
+               accum_fv[s][0] += l;
+               accum_fv[s][1] += r;
+            }
          }
 
          // Run sweep
@@ -912,26 +960,34 @@ int32 PS_SPU::UpdateFromCDC(int32 clocks)
          {
             unsigned phase_inc;
 
-            // Run enveloping
-            RunEnvelope(voice);
+            // Run enveloping; for a silent voice, an increment would only take the level below zero and back to
+            // it, so just the divider moves.
+            if(silent)
+            {
+               voice->ADSR.Divider += silent_divinco;
+               if(voice->ADSR.Divider & 0x8000)
+                  voice->ADSR.Divider = 0;
+            }
+            else
+               RunEnvelope(voice);
 
-            if(PhaseModCache & (1 << voice_num))
+            if(fm_on)
             {
                // This old formula: phase_inc = (voice->Pitch * ((voice - 1)->PreLRSample + 0x8000)) >> 15;
                // is incorrect, as it does not handle carrier pitches >= 0x8000 properly.
-               phase_inc = voice->Pitch + (((int16)voice->Pitch * ((voice - 1)->PreLRSample)) >> 15);
+               phase_inc = VoicePitch[voice_num] + (((int16)VoicePitch[voice_num] * prev_pvs[s]) >> 15);
             }
             else
-               phase_inc = voice->Pitch;
+               phase_inc = VoicePitch[voice_num];
 
             if(phase_inc > 0x3FFF)
                phase_inc = 0x3FFF;
 
             {
-               const uint32 tmp_phase = voice->CurPhase + phase_inc;
+               const uint32 tmp_phase = VoiceCurPhase[voice_num] + phase_inc;
                const unsigned used = tmp_phase >> 12;
 
-               voice->CurPhase = tmp_phase & 0xFFF;
+               VoiceCurPhase[voice_num] = tmp_phase & 0xFFF;
                voice->DecodeAvail -= used;
                voice->DecodeReadPos = (voice->DecodeReadPos + used) & 0x1F;
             }
@@ -939,57 +995,113 @@ int32 PS_SPU::UpdateFromCDC(int32 clocks)
          else
             voice->DecodePlayDelay--;
 
-         if(VoiceOff & (1U << voice_num))
+         // Key on/off take effect after the first sample.
+         if(!s)
          {
-            if(voice->ADSR.Phase != ADSR_RELEASE)
+            if(VoiceOff & (1U << voice_num))
             {
-               ReleaseEnvelope(voice);
+               if(voice->ADSR.Phase != ADSR_RELEASE)
+               {
+                  ReleaseEnvelope(voice);
+               }
             }
-         }
 
-         if(VoiceOn & (1U << voice_num))
-         {
-            //printf("Voice On: %u\n", voice_num);
+            if(VoiceOn & (1U << voice_num))
+            {
+               //printf("Voice On: %u\n", voice_num);
 
-            ResetEnvelope(voice);
+               ResetEnvelope(voice);
 
-            voice->DecodeFlags = 0;
-            voice->DecodeWritePos = 0;
-            voice->DecodeReadPos = 0;
-            voice->DecodeAvail = 0;
-            voice->DecodePlayDelay = 4;
+               voice->DecodeFlags = 0;
+               voice->DecodeWritePos = 0;
+               voice->DecodeReadPos = 0;
+               voice->DecodeAvail = 0;
+               voice->DecodePlayDelay = 4;
 
-            BlockEnd &= ~(1 << voice_num);
+               BlockEnd &= ~(1 << voice_num);
 
-            //
-            // Weight/filter previous value initialization:
-            //
-            voice->DecodeM2 = 0;
-            voice->DecodeM1 = 0;
+               //
+               // Weight/filter previous value initialization:
+               //
+               voice->DecodeM2 = 0;
+               voice->DecodeM1 = 0;
 
-            voice->CurPhase = 0;
-            voice->CurAddr = voice->StartAddr & ~0x7;
-            voice->IgnoreSampLA = false;
+               VoiceCurPhase[voice_num] = 0;
+               VoiceCurAddr[voice_num] = VoiceStartAddr[voice_num] & ~0x7;
+               voice->IgnoreSampLA = false;
+            }
          }
 
          if(!(SPUControl & 0x8000))
          {
             voice->ADSR.Phase = ADSR_RELEASE;
-            voice->ADSR.EnvLevel = 0;
+            VoiceEnvLevel[voice_num] = 0;
          }
       }
 
-      VoiceOff = 0;
-      VoiceOn = 0; 
+      std::swap(prev_pvs, cur_pvs);
+   }
+
+   VoiceOff = 0;
+   VoiceOn = 0; 
+
+   for(unsigned s = 0; s < count; s++)
+   {
+      // Output of reverb processing.
+      int32 reverb[2];
+
+      // Final output.
+      int32 output[2];
+
+      reverb[0]   = reverb[1]   = 0;
+      output[0]   = output[1]   = 0;
+
+      /*
+       **
+       ** 0x1F801DAE Notes and Conjecture:
+       **   -------------------------------------------------------------------------------------
+       **   |   15   14 | 13 | 12 | 11 | 10  | 9  | 8 |  7 |  6  | 5    4    3    2    1    0   |
+       **   |      ?    | *13| ?  | ba | *10 | wrr|rdr| df |  is |      c                       |
+       **   -------------------------------------------------------------------------------------
+       **
+       **	c - Appears to be delayed copy of lower 6 bits from 0x1F801DAA.
+       **
+       **     is - Interrupt asserted out status. (apparently not instantaneous status though...)
+       **
+       **     df - Related to (c & 0x30) == 0x20 or (c & 0x30) == 0x30, at least.
+       **          0 = DMA busy(FIFO not empty when in DMA write mode?)?
+       **	    1 = DMA ready?  Something to do with the FIFO?
+       **
+       **     rdr - Read(DMA read?) Ready?
+       **
+       **     wrr - Write(DMA write?) Ready?
+       **
+       **     *10 - Unknown.  Some sort of (FIFO?) busy status?(BIOS tests for this bit in places)
+       **
+       **     ba - Alternates between 0 and 1, even when SPUControl bit15 is 0; might be related to CD audio and voice 1 and 3 writing to SPU RAM.
+       **
+       **     *13 - Unknown, was set to 1 when testing with an SPU delay system reg value of 0x200921E1(test result might not be reliable, re-run).
+       */
+      SPUStatus = SPUControl & 0x3F;
+      SPUStatus |= irq_asserted ? 0x40 : 0x00;
+
+      if(Regs[0xD6] == 0x4)	// TODO: Investigate more(case 0x2C in global regs r/w handler)
+         SPUStatus |= (CWA & 0x100) ? 0x800 : 0x000;
+
+      if(count > 1)
+      {
+         WriteSPURAM(0x400 | CWA, capture[0][s]);
+         WriteSPURAM(0x600 | CWA, capture[1][s]);
+      }
 
       // "Mute" control doesn't seem to affect CD audio(though CD audio reverb wasn't tested...)
       // TODO: If we add sub-sample timing accuracy, see if it's checked for every channel at different times, or just once.
       if(!(SPUControl & 0x4000))
       {
-         accum[0] = 0;
-         accum[1] = 0;
-         accum_fv[0] = 0;
-         accum_fv[1] = 0;
+         accum[s][0] = 0;
+         accum[s][1] = 0;
+         accum_fv[s][0] = 0;
+         accum_fv[s][1] = 0;
       }
 
       // Get CD-DA
@@ -1012,13 +1124,13 @@ int32 PS_SPU::UpdateFromCDC(int32 clocks)
 
          if(SPUControl & 0x0001)
          {
-            accum[0] += cdav[0];
-            accum[1] += cdav[1];
+            accum[s][0] += cdav[0];
+            accum[s][1] += cdav[1];
 
             if(SPUControl & 0x0004)	// TODO: Test this bit(and see if it is really dependent on bit0)
             {
-               accum_fv[0] += cdav[0];
-               accum_fv[1] += cdav[1];
+               accum_fv[s][0] += cdav[0];
+               accum_fv[s][1] += cdav[1];
             }
          }
       }
@@ -1028,15 +1140,15 @@ int32 PS_SPU::UpdateFromCDC(int32 clocks)
       RunNoise();
 
       for (unsigned lr = 0; lr < 2; lr++)
-         clamp(&accum_fv[lr], -32768, 32767);
+         clamp(&accum_fv[s][lr], -32768, 32767);
 
-      RunReverb(accum_fv, reverb);
+      RunReverb(accum_fv[s], reverb);
 
       for(unsigned lr = 0; lr < 2; lr++)
       {
-         accum[lr] += ((reverb[lr] * ReverbVol[lr]) >> 15);
-         clamp(&accum[lr],  -32768, 32767);
-         output[lr] = (accum[lr] * GlobalSweep[lr].ReadVolume()) >> 15;
+         accum[s][lr] += ((reverb[lr] * ReverbVol[lr]) >> 15);
+         clamp(&accum[s][lr],  -32768, 32767);
+         output[lr] = (accum[s][lr] * GlobalSweep[lr].ReadVolume()) >> 15;
          clamp(&output[lr], -32768, 32767);
       }
 
@@ -1049,8 +1161,6 @@ int32 PS_SPU::UpdateFromCDC(int32 clocks)
          IntermediateBufferPos++;
       }
 
-      sample_clocks--;
-
       // Clock global sweep
       for(unsigned lr = 0; lr < 2; lr++)
       {
@@ -1060,14 +1170,12 @@ int32 PS_SPU::UpdateFromCDC(int32 clocks)
             GlobalSweep[lr].Current = (GlobalSweep[lr].Control & 0x7FFF) << 1;
       }
    }
-
-   //assert(clock_divider < 768);
-
-   return clock_divider;
 }
 
 void PS_SPU::WriteDMA(uint32 V)
 {
+   FlushSamples();
+
    //SPUIRQ_DBG("DMA Write, RWAddr after=0x%06x", RWAddr);
    WriteSPURAM(RWAddr, V);
    RWAddr = (RWAddr + 1) & 0x3FFFF;
@@ -1081,6 +1189,8 @@ void PS_SPU::WriteDMA(uint32 V)
 
 uint32 PS_SPU::ReadDMA(void)
 {
+   FlushSamples();
+
    uint32 ret = (uint16)ReadSPURAM(RWAddr);
    RWAddr = (RWAddr + 1) & 0x3FFFF;
 
@@ -1099,6 +1209,8 @@ void PS_SPU::Write(int32_t timestamp, uint32 A, uint16 V)
    //if((A & 0x3FF) < 0x180)
    // PSX_WARNING("[SPU] Write: %08x %04x", A, V);
 
+   FlushSamples();
+
    A &= 0x3FF;
 
    if(A >= 0x200)
@@ -1117,7 +1229,8 @@ void PS_SPU::Write(int32_t timestamp, uint32 A, uint16 V)
 
    if(A < 0x180)
    {
-      SPU_Voice *voice = &Voices[A >> 4];
+      const unsigned voice_num = A >> 4;
+      SPU_Voice *voice = &Voices[voice_num];
 
       switch(A & 0xF)
       {
@@ -1126,10 +1239,10 @@ void PS_SPU::Write(int32_t timestamp, uint32 A, uint16 V)
             voice->Sweep[(A & 2) >> 1].WriteControl(V);
             break;
          case 0x04:
-            voice->Pitch = V;
+            VoicePitch[voice_num] = V;
             break;
          case 0x06:
-            voice->StartAddr = (V << 2) & 0x3FFFF;
+            VoiceStartAddr[voice_num] = (V << 2) & 0x3FFFF;
             break;
          case 0x08:
             voice->ADSRControl &= 0xFFFF0000;
@@ -1142,10 +1255,10 @@ void PS_SPU::Write(int32_t timestamp, uint32 A, uint16 V)
             CacheEnvelope(voice);
             break;
          case 0x0C:
-            voice->ADSR.EnvLevel = V;
+            VoiceEnvLevel[voice_num] = V;
             break;
          case 0x0E:
-            voice->LoopAddr = (V << 2) & 0x3FFFF;
+            VoiceLoopAddr[voice_num] = (V << 2) & 0x3FFFF;
             voice->IgnoreSampLA = true;
 #if 0
             if((voice - Voices) == 22)
@@ -1282,6 +1395,8 @@ void PS_SPU::Write(int32_t timestamp, uint32 A, uint16 V)
 
 uint16 PS_SPU::Read(int32_t timestamp, uint32 A)
 {
+   FlushSamples();
+
    A &= 0x3FF;
 
    PSX_DBGINFO("[SPU] Read: %08x", A);
@@ -1305,14 +1420,14 @@ uint16 PS_SPU::Read(int32_t timestamp, uint32 A)
 
    if(A < 0x180)
    {
-      SPU_Voice *voice = &Voices[A >> 4];
+      const unsigned voice_num = A >> 4;
 
       switch(A & 0xF)
       {
          case 0x0C:
-            return(voice->ADSR.EnvLevel);
+            return(VoiceEnvLevel[voice_num]);
          case 0x0E:
-            return(voice->LoopAddr >> 2);
+            return(VoiceLoopAddr[voice_num] >> 2);
       }
    }
    else
@@ -1355,6 +1470,9 @@ uint16 PS_SPU::Read(int32_t timestamp, uint32 A)
 
 int PS_SPU::StateAction(StateMem *sm, int load, int data_only)
 {
+   if(!load)
+      FlushSamples();
+
    SFORMAT StateRegs[] =
    {
 #define SFSWEEP(r) SFVAR((r).Control),	\
@@ -1376,16 +1494,16 @@ int PS_SPU::StateAction(StateMem *sm, int load, int data_only)
       SFSWEEP(Voices[n].Sweep[0]),											\
       SFSWEEP(Voices[n].Sweep[1]),											\
       \
-      SFVAR(Voices[n].Pitch),											\
-      SFVAR(Voices[n].CurPhase),											\
+      SFVARN(VoicePitch[n], "Voices[" #n "].Pitch"),											\
+      SFVARN(VoiceCurPhase[n], "Voices[" #n "].CurPhase"),											\
       \
-      SFVAR(Voices[n].StartAddr),											\
-      SFVAR(Voices[n].CurAddr),											\
+      SFVARN(VoiceStartAddr[n], "Voices[" #n "].StartAddr"),											\
+      SFVARN(VoiceCurAddr[n], "Voices[" #n "].CurAddr"),											\
       SFVAR(Voices[n].ADSRControl),										\
-      SFVAR(Voices[n].LoopAddr),											\
+      SFVARN(VoiceLoopAddr[n], "Voices[" #n "].LoopAddr"),											\
       SFVAR(Voices[n].PreLRSample),										\
       \
-      SFVAR(Voices[n].ADSR.EnvLevel),										\
+      SFVARN(VoiceEnvLevel[n], "Voices[" #n "].ADSR.EnvLevel"),										\
       SFVAR(Voices[n].ADSR.Divider),										\
       SFVAR(Voices[n].ADSR.Phase),											\
       \
@@ -1471,7 +1589,7 @@ int PS_SPU::StateAction(StateMem *sm, int load, int data_only)
 
       SFVAR(clock_divider),
 
-      SFARRAY16(SPURAM, 524288 / sizeof(uint16)),
+      SFARRAY16DIRTYN(SPURAM, 524288 / sizeof(uint16), "SPURAM", &SPURAM_Dirty),
       SFEND
    };
 #undef SFSWEEP
@@ -1485,14 +1603,16 @@ int PS_SPU::StateAction(StateMem *sm, int load, int data_only)
       {
          Voices[i].DecodeReadPos &= 0x1F;
          Voices[i].DecodeWritePos &= 0x1F;
-         Voices[i].CurAddr &= 0x3FFFF;
-         Voices[i].StartAddr &= 0x3FFFF;
-         Voices[i].LoopAddr &= 0x3FFFF;
+         VoiceCurAddr[i] &= 0x3FFFF;
+         VoiceStartAddr[i] &= 0x3FFFF;
+         VoiceLoopAddr[i] &= 0x3FFFF;
       }
 
       if(clock_divider <= 0 || clock_divider > 768)
          clock_divider = 768;
 
+      PendingSamples = 0;
+
       RWAddr &= 0x3FFFF;
       CWA &= 0x1FF;
 
@@ -1509,16 +1629,23 @@ int PS_SPU::StateAction(StateMem *sm, int load, int data_only)
 
 uint16 PS_SPU::PeekSPURAM(uint32 address)
 {
+   FlushSamples();
+
    return(SPURAM[address & 0x3FFFF]);
 }
 
 void PS_SPU::PokeSPURAM(uint32 address, uint16 value)
 {
+   FlushSamples();
+
+   StateDirty_Mark(&SPURAM_Dirty, (address & 0x3FFFF) << 1);
    SPURAM[address & 0x3FFFF] = value;
 }
 
 uint32 PS_SPU::GetRegister(unsigned int which, char *special, const uint32 special_len)
 {
+   FlushSamples();
+
    if(which >= 0x8000)
    {
       unsigned int v = (which - 0x8000) >> 8;
@@ -1534,17 +1661,17 @@ uint32 PS_SPU::GetRegister(unsigned int which, char *special, const uint32 speci
          case GSREG_V0_VOL_R:
             return Voices[v].Sweep[1].ReadVolume() & 0xFFFF;
          case GSREG_V0_PITCH:
-            return Voices[v].Pitch;
+            return VoicePitch[v];
          case GSREG_V0_STARTADDR:
-            return Voices[v].StartAddr;
+            return VoiceStartAddr[v];
          case GSREG_V0_ADSR_CTRL:
             return Voices[v].ADSRControl;
          case GSREG_V0_ADSR_LEVEL:
-            return Voices[v].ADSR.EnvLevel;
+            return VoiceEnvLevel[v];
          case GSREG_V0_LOOP_ADDR:
-            return Voices[v].LoopAddr;
+            return VoiceLoopAddr[v];
          case GSREG_V0_READ_ADDR:
-            return Voices[v].CurAddr;
+            return VoiceCurAddr[v];
       }
    }
    else if (which >= 18 && which <= 49)
@@ -1594,6 +1721,8 @@ uint32 PS_SPU::GetRegister(unsigned int which, char *special, const uint32 speci
 
 void PS_SPU::SetRegister(unsigned int which, uint32 value)
 {
+   FlushSamples();
+
    if(which >= GSREG_FB_SRC_A && which <= GSREG_IN_COEF_R)
       ReverbRegs[which - GSREG_FB_SRC_A] = value;
    else switch(which)
@@ -17,8 +17,6 @@ enum
 
 struct SPU_ADSR
 {
-   uint16_t EnvLevel;	// We typecast it to (int16) in several places, but keep it here as (uint16) to prevent signed overflow/underflow, which compilers
-   // may not treat consistently.
    uint32_t Divider;
    uint32_t Phase;
 
@@ -77,17 +75,8 @@ struct SPU_Voice
 
    SPU_Sweep Sweep[2];
 
-   uint16_t Pitch;
-   uint32_t CurPhase;
-
-   uint32_t StartAddr;
-
-   uint32_t CurAddr;
-
    uint32_t ADSRControl;
 
-   uint32_t LoopAddr;
-
    int32_t PreLRSample;	// After enveloping, but before L/R volume.  Range of -32768 to 32767
 
    SPU_ADSR ADSR;
@@ -111,8 +100,17 @@ class PS_SPU
 
       int32_t UpdateFromCDC(int32_t clocks);
 
+      // Renders the samples UpdateFromCDC() has let pile up.  Anything that looks at or changes SPU state, or that
+      // the SPU reads from(the CD audio buffer), has to call this first.
+      void FlushSamples(void);
+
    private:
 
+      enum { SPU_BLOCK_SIZE = 64 };	// Most samples rendered in one go.
+
+      bool CanRenderBlock(void);
+      void RenderSamples(const unsigned count);
+
       void CheckIRQAddr(uint32_t addr);
       void WriteSPURAM(uint32_t addr, uint16_t value);
       uint16_t ReadSPURAM(uint32_t addr);
@@ -131,6 +129,16 @@ class PS_SPU
 
       SPU_Voice Voices[24];
 
+      // The per-voice state touched on every sample is kept out of SPU_Voice, one array per field, so that a pass
+      // over all the voices doesn't drag in their decode buffers.  Save states still name them as Voices[n] members.
+      uint16_t VoiceEnvLevel[24];	// We typecast it to (int16) in several places, but keep it here as (uint16) to prevent signed overflow/underflow, which compilers
+      // may not treat consistently.
+      uint32_t VoiceCurPhase[24];
+      uint16_t VoicePitch[24];
+      uint32_t VoiceCurAddr[24];
+      uint32_t VoiceStartAddr[24];
+      uint32_t VoiceLoopAddr[24];
+
       uint32_t NoiseDivider;
       uint32_t NoiseCounter;
       uint16_t LFSR;
@@ -235,6 +243,7 @@ class PS_SPU
       bool IRQAsserted;
 
       int32_t clock_divider;
+      uint32_t PendingSamples;	// Due, but not rendered yet; see FlushSamples().
 
       uint16_t SPURAM[524288 / sizeof(uint16)];
 
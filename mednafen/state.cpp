@@ -15,12 +15,35 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
+#include <stdio.h>
 #include <string.h>
+#include <time.h>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <unordered_map>
 
 #include <boolean.h>
 
 #include <compat/msvc.h>
 
+#ifdef HAVE_THREADS
+#include <rthreads/rthreads.h>
+#endif
+
+#include <zlib.h>
+
 #include "mednafen.h"
 #include "state.h"
 
@@ -32,6 +55,156 @@
 //Only used for internal savestates which will not be written to a file.
 bool FastSaveStates = false;
 
+//Incremental save states copy only the pages of tracked arrays that changed since the state being saved over or loaded
+//from, see StateDirty.  Like FastSaveStates, only used for internal savestates, and only when saving straight into the
+//frontend's buffer.
+bool IncrementalSaveStates = false;
+
+//Compressed save states store the large arrays as independently deflated blocks, see WriteCompressed().  Loading
+//handles them whether or not this is set.
+bool CompressedSaveStates = false;
+
+uint32_t StateDirty_Gen = 1;
+
+static StateDirty *DirtyList[8];
+static unsigned DirtyCount;
+
+static uint32_t StateNonce;         // Identifies the states saved by this session, 0 until the first save
+static uint32_t StateGenFloor = 1;  // Saved states older than this no longer match what the tracked arrays derive from,
+static uint32_t StateGenLoaded;     // except for the one loaded last.
+static uint32_t StateBaseGen;       // Generation of the state being saved over or loaded from, 0 when copying everything
+
+void StateDirty_Init(StateDirty *d, uint32_t size)
+{
+   unsigned i;
+
+   d->page_shift = 0;
+   d->partial    = false;
+
+   while((size >> d->page_shift) > STATE_DIRTY_MAX_PAGES)
+      d->page_shift++;
+
+   StateDirty_MarkAll(d);
+
+   for(i = 0; i < DirtyCount; i++)
+   {
+      if(DirtyList[i] == d)
+         return;
+   }
+
+   assert(DirtyCount < sizeof(DirtyList) / sizeof(DirtyList[0]));
+   DirtyList[DirtyCount++] = d;
+}
+
+void StateDirty_MarkAll(StateDirty *d)
+{
+   for(unsigned page = 0; page < STATE_DIRTY_MAX_PAGES; page++)
+      d->gen[page] = StateDirty_Gen;
+}
+
+bool StateDirty_Loaded(const StateDirty *d, uint32_t page)
+{
+   return !d->partial || d->gen[page] > StateBaseGen;
+}
+
+/* Whether the savestate header belongs to a state that the tracked arrays
+ * can be compared against, and if so its generation. */
+static uint32_t StateDirty_BaseGen(const uint8_t *header, bool same_layout)
+{
+   const uint32_t nonce = MDFN_de32lsb<false>(header + 8);
+   const uint32_t tag   = MDFN_de32lsb<false>(header + 12);
+   const uint32_t gen   = tag & 0x7FFFFFFF;
+
+#ifdef MSB_FIRST
+   // Tracked arrays are byte swapped as a whole when loaded.
+   return 0;
+#endif
+
+   if(!IncrementalSaveStates || !nonce || nonce != StateNonce || !gen)
+      return 0;
+
+   if(same_layout && (bool)(tag >> 31) != FastSaveStates)
+      return 0;
+
+   if(gen != StateGenLoaded && (gen < StateGenFloor || gen >= StateDirty_Gen))
+      return 0;
+
+   return gen;
+}
+
+// MurmurHash3's block mixing step.
+static uint32_t StateNonce_Mix(uint32_t h, uint32_t v)
+{
+   v *= 0xCC9E2D51;
+   v  = (v << 15) | (v >> 17);
+   v *= 0x1B873593;
+   h ^= v;
+   h  = (h << 13) | (h >> 19);
+
+   return h * 5 + 0xE6546B64;
+}
+
+/* A fresh StateNonce.  Other instances of the core, possibly started in the same second and loaded at the same
+ * address, hand their states to the same frontend buffers, so it's drawn from the system's random source where there
+ * is one, and from the high resolution clock and the process ID. */
+static uint32_t StateNonce_New(void)
+{
+   uint32_t seed[4] = { 0, 0, 0, 0 };
+   uint32_t h       = 0;
+   unsigned i;
+#if defined(_WIN32)
+   LARGE_INTEGER count;
+
+   QueryPerformanceCounter(&count);
+   seed[0] = (uint32_t)count.QuadPart;
+   seed[1] = (uint32_t)((uint64_t)count.QuadPart >> 32);
+   seed[2] = (uint32_t)GetCurrentProcessId();
+#elif defined(__unix__) || defined(__APPLE__)
+   struct timeval tv;
+   FILE *fp;
+
+   if((fp = fopen("/dev/urandom", "rb")))
+   {
+      if(fread(seed, 1, sizeof(seed), fp) != sizeof(seed))
+         memset(seed, 0, sizeof(seed));
+
+      fclose(fp);
+   }
+
+   gettimeofday(&tv, NULL);
+   seed[0] ^= (uint32_t)tv.tv_usec;
+   seed[1] ^= (uint32_t)tv.tv_sec;
+   seed[2] ^= (uint32_t)getpid();
+#endif
+   seed[3] ^= (uint32_t)time(NULL) ^ (uint32_t)clock() ^ (uint32_t)(uintptr_t)&DirtyList;
+
+   for(i = 0; i < 4; i++)
+      h = StateNonce_Mix(h, seed[i]);
+
+   // MurmurHash3's finalizer.
+   h ^= h >> 16;
+   h *= 0x85EBCA6B;
+   h ^= h >> 13;
+   h *= 0xC2B2AE35;
+   h ^= h >> 16;
+
+   return h ? h : 1;
+}
+
+static void StateDirty_Reset(void)
+{
+   unsigned i;
+
+   StateNonce = StateNonce_New();
+
+   StateDirty_Gen = 1;
+   StateGenFloor  = 1;
+   StateGenLoaded = 0;
+
+   for(i = 0; i < DirtyCount; i++)
+      memset(DirtyList[i]->gen, 0, sizeof(DirtyList[i]->gen));
+}
+
 int32_t smem_read(StateMem *st, void *buffer, uint32_t len)
 {
    if ((len + st->loc) > st->len)
@@ -43,8 +216,20 @@ int32_t smem_read(StateMem *st, void *buffer, uint32_t len)
    return(len);
 }
 
+// A fixed buffer is never reallocated; writes past its end only advance the position, so that the caller can tell the
+// state didn't fit(or, with no buffer at all, how big it is) from st->len.
 int32_t smem_write(StateMem *st, void *buffer, uint32_t len)
 {
+   if (st->fixed && (len + st->loc) > st->malloced)
+   {
+      st->loc += len;
+
+      if (st->loc > st->len)
+         st->len = st->loc;
+
+      return(len);
+   }
+
    if ((len + st->loc) > st->malloced)
    {
       uint32_t newsize = (st->malloced >= 32768) ? st->malloced : (st->initial_malloc ? st->initial_malloc : 32768);
@@ -117,6 +302,399 @@ int smem_read32le(StateMem *st, uint32_t *b)
    return(4);
 }
 
+// Writes the pages of a tracked array that changed since the state being saved over, skipping the others.
+static void WriteDirtyPages(StateMem *st, const SFORMAT *sf)
+{
+   const StateDirty *d      = sf->dirty;
+   const uint32_t page_size = 1U << d->page_shift;
+
+   for(uint32_t offset = 0; offset < sf->size; offset += page_size)
+   {
+      if(d->gen[offset >> d->page_shift] > StateBaseGen)
+         memcpy(st->data + st->loc + offset, (uint8_t *)sf->v + offset, std::min(page_size, sf->size - offset));
+   }
+
+   st->loc += sf->size;
+
+   if (st->loc > st->len)
+      st->len = st->loc;
+}
+
+// Reads back the pages of a tracked array that changed since the state being loaded, which has the rest already.
+static void ReadDirtyPages(StateMem *st, SFORMAT *sf)
+{
+   StateDirty *d            = sf->dirty;
+   const uint32_t page_size = 1U << d->page_shift;
+
+   for(uint32_t offset = 0; offset < sf->size; offset += page_size)
+   {
+      if(d->gen[offset >> d->page_shift] > StateBaseGen)
+         memcpy((uint8_t *)sf->v + offset, st->data + st->loc + offset, std::min(page_size, sf->size - offset));
+   }
+
+   st->loc += sf->size;
+   d->partial = true;
+}
+
+/* Compressed variables.
+ *
+ * Variables of at least STATE_BLOCK_SIZE bytes(RAM, VRAM, SPU RAM, memory
+ * card data) are recorded with STATE_COMPRESSED set in their size, and are
+ * followed by the length of the packed data and then by one block for each
+ * STATE_BLOCK_SIZE bytes of the variable.  A block is a 32-bit word with its
+ * type in the upper 2 bits and the length of its payload in the rest, then the
+ * payload.  Blocks are packed independently, so they are compressed in
+ * parallel and inflated straight into the variable. */
+#define STATE_COMPRESSED        0x80000000
+#define STATE_BLOCK_SIZE        0x10000
+#define STATE_BLOCK_ZERO        0          // All zero, no payload
+#define STATE_BLOCK_STORED      1
+#define STATE_BLOCK_DEFLATED    2          // Raw deflate stream
+#define STATE_COMPRESS_THREADS  4
+
+struct StateBlock
+{
+   uint32_t type;
+   uint32_t len;
+};
+
+struct StateCompressJob
+{
+   const uint8_t *src;
+   uint32_t size;
+   uint32_t first;   // Blocks first, first + stride, ...
+   uint32_t stride;
+};
+
+struct StateCompressor
+{
+   z_stream zs;
+   bool zs_ok;
+#ifdef HAVE_THREADS
+   sthread_t *thread;
+   uint32_t batch;   // Last batch taken, guarded by StateCompressLock
+#endif
+};
+
+/* Kept from one save to the next, so that saving doesn't allocate once the largest variable has been compressed:
+ * the block list, one STATE_BLOCK_SIZE slot of deflated output for each block, and the deflate streams.  The first
+ * stream is used by the thread saving, the others by worker threads, started on the first compressed save and kept
+ * until MDFNSS_Deinit(). */
+static std::vector<StateBlock> StateBlocks;
+static std::vector<uint8_t> StateBlockData;
+static StateCompressJob StateCompressJobs[STATE_COMPRESS_THREADS];
+static StateCompressor StateCompressors[STATE_COMPRESS_THREADS];
+static unsigned StateCompressorCount;
+
+static bool BlockIsZero(const uint8_t *src, uint32_t len)
+{
+   for(uint32_t i = 0; i < len; i++)
+   {
+      if(src[i])
+         return false;
+   }
+
+   return true;
+}
+
+static void StateCompressor_Init(StateCompressor *c)
+{
+   memset(&c->zs, 0, sizeof(c->zs));
+   c->zs_ok = deflateInit2(&c->zs, Z_BEST_SPEED, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+}
+
+static void CompressBlocks(StateCompressor *c, const StateCompressJob *job)
+{
+   const uint32_t count = (job->size + STATE_BLOCK_SIZE - 1) / STATE_BLOCK_SIZE;
+
+   for(uint32_t i = job->first; i < count; i += job->stride)
+   {
+      StateBlock *b      = &StateBlocks[i];
+      const uint8_t *src = job->src + i * STATE_BLOCK_SIZE;
+      const uint32_t len = std::min<uint32_t>(STATE_BLOCK_SIZE, job->size - i * STATE_BLOCK_SIZE);
+
+      b->type = STATE_BLOCK_STORED;
+      b->len  = len;
+
+      if(BlockIsZero(src, len))
+      {
+         b->type = STATE_BLOCK_ZERO;
+         b->len  = 0;
+         continue;
+      }
+
+      if(!c->zs_ok)
+         continue;
+
+      c->zs.next_in   = (Bytef *)src;
+      c->zs.avail_in  = len;
+      c->zs.next_out  = &StateBlockData[i * STATE_BLOCK_SIZE];
+      c->zs.avail_out = len - 1;
+
+      // Kept stored unless deflating actually saves something, so the output never needs more than the block's slot.
+      if(deflate(&c->zs, Z_FINISH) == Z_STREAM_END)
+      {
+         b->type = STATE_BLOCK_DEFLATED;
+         b->len  = c->zs.total_out;
+      }
+
+      deflateReset(&c->zs);
+   }
+}
+
+#ifdef HAVE_THREADS
+static slock_t *StateCompressLock;
+static scond_t *StateCompressWorkCond;
+static scond_t *StateCompressDoneCond;
+static uint32_t StateCompressBatch;     // Batches handed out, guarded by StateCompressLock
+static unsigned StateCompressPending;   // Workers still busy with the current batch, likewise
+static bool StateCompressQuit;
+
+static void StateCompressor_Main(void *arg)
+{
+   StateCompressor *c   = (StateCompressor *)arg;
+   const StateCompressJob *job = &StateCompressJobs[c - StateCompressors];
+
+   slock_lock(StateCompressLock);
+
+   for(;;)
+   {
+      while(c->batch == StateCompressBatch && !StateCompressQuit)
+         scond_wait(StateCompressWorkCond, StateCompressLock);
+
+      if(StateCompressQuit)
+         break;
+
+      c->batch = StateCompressBatch;
+      slock_unlock(StateCompressLock);
+
+      CompressBlocks(c, job);
+
+      slock_lock(StateCompressLock);
+
+      if(!--StateCompressPending)
+         scond_signal(StateCompressDoneCond);
+   }
+
+   slock_unlock(StateCompressLock);
+}
+
+static void StateCompressors_Start(void)
+{
+   if(!(StateCompressLock = slock_new()) || !(StateCompressWorkCond = scond_new()) || !(StateCompressDoneCond = scond_new()))
+      return;
+
+   StateCompressBatch = 0;
+   StateCompressQuit  = false;
+
+   while(StateCompressorCount < STATE_COMPRESS_THREADS)
+   {
+      StateCompressor *c = &StateCompressors[StateCompressorCount];
+
+      StateCompressor_Init(c);
+      c->batch = 0;
+
+      if(!(c->thread = sthread_create(StateCompressor_Main, c)))
+      {
+         if(c->zs_ok)
+            deflateEnd(&c->zs);
+         break;
+      }
+
+      StateCompressorCount++;
+   }
+}
+#endif
+
+void MDFNSS_Deinit(void)
+{
+#ifdef HAVE_THREADS
+   if(StateCompressLock)
+   {
+      slock_lock(StateCompressLock);
+      StateCompressQuit = true;
+      scond_broadcast(StateCompressWorkCond);
+      slock_unlock(StateCompressLock);
+   }
+
+   for(unsigned i = 1; i < StateCompressorCount; i++)
+   {
+      sthread_join(StateCompressors[i].thread);
+
+      if(StateCompressors[i].zs_ok)
+         deflateEnd(&StateCompressors[i].zs);
+   }
+
+   if(StateCompressDoneCond)
+      scond_free(StateCompressDoneCond);
+   if(StateCompressWorkCond)
+      scond_free(StateCompressWorkCond);
+   if(StateCompressLock)
+      slock_free(StateCompressLock);
+
+   StateCompressDoneCond = NULL;
+   StateCompressWorkCond = NULL;
+   StateCompressLock     = NULL;
+#endif
+
+   if(StateCompressorCount && StateCompressors[0].zs_ok)
+      deflateEnd(&StateCompressors[0].zs);
+
+   StateCompressorCount = 0;
+
+   std::vector<StateBlock>().swap(StateBlocks);
+   std::vector<uint8_t>().swap(StateBlockData);
+}
+
+// Writes the data of a variable as blocks; see STATE_COMPRESSED.
+static void WriteCompressed(StateMem *st, const SFORMAT *sf)
+{
+   const uint8_t *src   = (const uint8_t *)sf->v;
+   const uint32_t count = (sf->size + STATE_BLOCK_SIZE - 1) / STATE_BLOCK_SIZE;
+   unsigned threads     = 1;
+   uint32_t packed_len  = 0;
+
+   // Only measuring(see MDFNSS_SaveSize()), so give the size of the state if nothing compresses.
+   if(!st->data)
+   {
+      st->loc += 4 + count * 4 + sf->size;
+
+      if(st->loc > st->len)
+         st->len = st->loc;
+
+      return;
+   }
+
+   if(StateBlocks.size() < count)
+   {
+      StateBlocks.resize(count);
+      StateBlockData.resize(count * STATE_BLOCK_SIZE);
+   }
+
+   if(!StateCompressorCount)
+   {
+      StateCompressor_Init(&StateCompressors[0]);
+      StateCompressorCount = 1;
+#ifdef HAVE_THREADS
+      StateCompressors_Start();
+#endif
+   }
+
+   // Not worth waking the workers for a few blocks.
+   if(count >= STATE_COMPRESS_THREADS)
+      threads = StateCompressorCount;
+
+   for(unsigned i = 0; i < threads; i++)
+   {
+      StateCompressJobs[i].src    = src;
+      StateCompressJobs[i].size   = sf->size;
+      StateCompressJobs[i].first  = i;
+      StateCompressJobs[i].stride = threads;
+   }
+
+#ifdef HAVE_THREADS
+   if(threads > 1)
+   {
+      slock_lock(StateCompressLock);
+      StateCompressBatch++;
+      StateCompressPending = threads - 1;
+      scond_broadcast(StateCompressWorkCond);
+      slock_unlock(StateCompressLock);
+   }
+#endif
+
+   CompressBlocks(&StateCompressors[0], &StateCompressJobs[0]);
+
+#ifdef HAVE_THREADS
+   if(threads > 1)
+   {
+      slock_lock(StateCompressLock);
+
+      while(StateCompressPending)
+         scond_wait(StateCompressDoneCond, StateCompressLock);
+
+      slock_unlock(StateCompressLock);
+   }
+#endif
+
+   for(uint32_t i = 0; i < count; i++)
+      packed_len += 4 + StateBlocks[i].len;
+
+   smem_write32le(st, packed_len);
+
+   for(uint32_t i = 0; i < count; i++)
+   {
+      const StateBlock *b = &StateBlocks[i];
+
+      smem_write32le(st, (b->type << 30) | b->len);
+
+      if(b->type == STATE_BLOCK_STORED)
+         smem_write(st, (uint8_t *)src + i * STATE_BLOCK_SIZE, b->len);
+      else if(b->type == STATE_BLOCK_DEFLATED)
+         smem_write(st, &StateBlockData[i * STATE_BLOCK_SIZE], b->len);
+   }
+}
+
+// Reads a variable written by WriteCompressed(), inflating each block into place.
+static bool ReadCompressed(StateMem *st, SFORMAT *sf, uint32_t packed_len)
+{
+   uint8_t *dst          = (uint8_t *)sf->v;
+   const uint32_t end    = st->loc + packed_len;
+   const uint32_t count  = (sf->size + STATE_BLOCK_SIZE - 1) / STATE_BLOCK_SIZE;
+   bool ret              = true;
+   z_stream zs;
+
+   if(end < st->loc || end > st->len)
+      return false;
+
+   memset(&zs, 0, sizeof(zs));
+
+   if(inflateInit2(&zs, -15) != Z_OK)
+      return false;
+
+   for(uint32_t i = 0; i < count && ret; i++)
+   {
+      const uint32_t len = std::min<uint32_t>(STATE_BLOCK_SIZE, sf->size - i * STATE_BLOCK_SIZE);
+      uint32_t word;
+
+      if(!smem_read32le(st, &word) || (word & 0x3FFFFFFF) > end - st->loc)
+      {
+         ret = false;
+         break;
+      }
+
+      switch(word >> 30)
+      {
+         case STATE_BLOCK_ZERO:
+            memset(dst + i * STATE_BLOCK_SIZE, 0, len);
+            break;
+
+         case STATE_BLOCK_STORED:
+            ret = (word & 0x3FFFFFFF) == len && smem_read(st, dst + i * STATE_BLOCK_SIZE, len) == (int32_t)len;
+            break;
+
+         case STATE_BLOCK_DEFLATED:
+            zs.next_in   = st->data + st->loc;
+            zs.avail_in  = word & 0x3FFFFFFF;
+            zs.next_out  = dst + i * STATE_BLOCK_SIZE;
+            zs.avail_out = len;
+
+            ret = inflate(&zs, Z_FINISH) == Z_STREAM_END && zs.total_out == len;
+            st->loc += word & 0x3FFFFFFF;
+            inflateReset(&zs);
+            break;
+
+         default:
+            ret = false;
+            break;
+      }
+   }
+
+   inflateEnd(&zs);
+
+   return ret && st->loc == end;
+}
+
 static bool SubWrite(StateMem *st, SFORMAT *sf, const char *name_prefix = NULL)
 {
    while(sf->size || sf->name)	// Size can sometimes be zero, so also check for the text name.  These two should both be zero only at the end of a struct.
@@ -137,6 +715,17 @@ static bool SubWrite(StateMem *st, SFORMAT *sf, const char *name_prefix = NULL)
       }
 
       int32_t bytesize = sf->size;
+      const bool compressed = CompressedSaveStates && !(sf->flags & MDFNSTATE_BOOL) && bytesize >= STATE_BLOCK_SIZE;
+      const uint32_t header_pos = st->loc;
+      uint8_t old_header[1 + 256 + 4];
+      bool partial = false;
+
+      // When saving over a state of ours, the tracked array's old data can be kept if it's where it was in that state.
+      if(sf->dirty && StateBaseGen && (header_pos + sizeof(old_header) + bytesize) <= st->malloced)
+      {
+         memcpy(old_header, st->data + header_pos, sizeof(old_header));
+         partial = true;
+      }
 
       //exclude text labels from fast savestates
       if (!FastSaveStates)
@@ -165,7 +754,10 @@ static bool SubWrite(StateMem *st, SFORMAT *sf, const char *name_prefix = NULL)
 
          smem_write(st, nameo, 1 + nameo[0]);
       }
-      smem_write32le(st, bytesize);
+      smem_write32le(st, bytesize | (compressed ? STATE_COMPRESSED : 0));
+
+      if(partial)
+         partial = !memcmp(old_header, st->data + header_pos, st->loc - header_pos);
 
 #ifdef MSB_FIRST
       /* Flip the byte order... */
@@ -194,6 +786,10 @@ static bool SubWrite(StateMem *st, SFORMAT *sf, const char *name_prefix = NULL)
             smem_write(st, &tmp_bool, 1);
          }
       }
+      else if(compressed)
+         WriteCompressed(st, sf);
+      else if(partial)
+         WriteDirtyPages(st, sf);
       else
          smem_write(st, (uint8_t *)sf->v, bytesize);
 
@@ -249,39 +845,61 @@ static int WriteStateChunk(StateMem *st, const char *sname, SFORMAT *sf)
    return(end_pos - data_start_pos);
 }
 
-static SFORMAT *FindSF(const char *name, SFORMAT *sf)
+/* Variables of a section, flattened out of linked SFORMAT structs.  The
+ * index by name is built once and kept across loads for as long as the
+ * section's table has the same layout; the tables themselves are often on
+ * the stack, so the variables are re-collected on each load. */
+struct SFIndex
+{
+   std::vector<SFORMAT *> vars;
+   std::vector<const char *> names;
+   std::unordered_map<std::string, uint32_t> by_name;
+};
+
+static std::unordered_map<std::string, SFIndex> SFIndexCache;
+
+static void FlattenSF(SFORMAT *sf, std::vector<SFORMAT *> &vars)
 {
    /* Size can sometimes be zero, so also check for the text name.  These two should both be zero only at the end of a struct. */
-   while(sf->size || sf->name) 
+   for(; sf->size || sf->name; sf++)
    {
       if(!sf->size || !sf->v)
-      {
-         sf++;
          continue;
-      }
 
       if (sf->size == (uint32)~0) /* Link to another SFORMAT structure. */
-      {
-         SFORMAT *temp_sf = FindSF(name, (SFORMAT*)sf->v);
-         if (temp_sf)
-            return temp_sf;
-      }
+         FlattenSF((SFORMAT*)sf->v, vars);
       else
+         vars.push_back(sf);
+   }
+}
+
+static SFIndex *GetSFIndex(const char *sname, SFORMAT *sf)
+{
+   SFIndex *index = &SFIndexCache[sname];
+   bool same;
+
+   index->vars.clear();
+   FlattenSF(sf, index->vars);
+
+   same = index->names.size() == index->vars.size();
+
+   for(uint32_t i = 0; same && i < index->vars.size(); i++)
+      same = index->names[i] == index->vars[i]->name;
+
+   if(!same)
+   {
+      index->names.clear();
+      index->by_name.clear();
+
+      for(uint32_t i = 0; i < index->vars.size(); i++)
       {
-         //for fast savestates, we no longer have the text label in the state, and need to assume that it is the correct one.
-         if (FastSaveStates)
-         {
-            return sf;
-         }
-         assert(sf->name);
-         if (!strcmp(sf->name, name))
-            return sf;
+         assert(index->vars[i]->name);
+         index->names.push_back(index->vars[i]->name);
+         index->by_name.insert(std::make_pair(std::string(index->vars[i]->name), i));
       }
-
-      sf++;
    }
 
-   return NULL;
+   return index;
 }
 
 // Fast raw chunk reader
@@ -316,9 +934,11 @@ static void DOReadChunk(StateMem *st, SFORMAT *sf)
    }
 }
 
-static int ReadStateChunk(StateMem *st, SFORMAT *sf, int size)
+static int ReadStateChunk(StateMem *st, const char *sname, SFORMAT *sf, int size)
 {
    int temp = st->loc;
+   SFIndex *index = GetSFIndex(sname, sf);
+   uint32_t next = 0;
 
    uint32_t recorded_size;  // In bytes
    uint8_t toa[1 + 256];    // Don't change to char unless cast toa[0] to unsigned to smem_read() and other places.
@@ -347,11 +967,36 @@ static int ReadStateChunk(StateMem *st, SFORMAT *sf, int size)
 
       smem_read32le(st, &recorded_size);
 
-      SFORMAT *tmp = FindSF((char*)toa + 1, sf);
-      //Fix for unnecessary name checks, when we find it in the first slot, don't recheck that slot again.  Also necessary for fast savestates to work.
-      if (tmp == sf)
+      uint32_t skip_size = recorded_size;  // Of the data following
+      bool compressed    = false;
+
+      if(recorded_size & STATE_COMPRESSED)
       {
-         sf++;
+         recorded_size &= ~STATE_COMPRESSED;
+         compressed     = true;
+
+         if(!smem_read32le(st, &skip_size))
+         {
+            puts("Unexpected EOF");
+            return(0);
+         }
+      }
+
+      //Variables are normally in the same order as in the table, so try the one after the last found first.
+      //Fast savestates have no text labels, and rely on that order.
+      SFORMAT *tmp = NULL;
+
+      if (next < index->vars.size() && (FastSaveStates || !strcmp(index->vars[next]->name, (char*)toa + 1)))
+         tmp = index->vars[next++];
+      else if (!FastSaveStates)
+      {
+         std::unordered_map<std::string, uint32_t>::const_iterator it = index->by_name.find((char*)toa + 1);
+
+         if (it != index->by_name.end())
+         {
+            tmp  = index->vars[it->second];
+            next = it->second + 1;
+         }
       }
 
       if(tmp)
@@ -361,15 +1006,23 @@ static int ReadStateChunk(StateMem *st, SFORMAT *sf, int size)
          if(recorded_size != expected_size)
          {
             printf("Variable in save state wrong size: %s.  Need: %d, got: %d\n", toa + 1, expected_size, recorded_size);
-            if(smem_seek(st, recorded_size, SEEK_CUR) < 0)
+            if(smem_seek(st, skip_size, SEEK_CUR) < 0)
             {
                puts("Seek error");
                return(0);
             }
          }
+         else if(tmp->dirty && StateBaseGen && !compressed && (st->loc + expected_size) <= st->len)
+            ReadDirtyPages(st, tmp);
          else
          {
-            smem_read(st, (uint8_t *)tmp->v, expected_size);
+            if(!compressed)
+               smem_read(st, (uint8_t *)tmp->v, expected_size);
+            else if((tmp->flags & MDFNSTATE_BOOL) || !ReadCompressed(st, tmp, skip_size))
+            {
+               printf("Corrupt compressed variable in save state: %s\n", toa + 1);
+               return(0);
+            }
 
             if(tmp->flags & MDFNSTATE_BOOL)
             {
@@ -394,7 +1047,7 @@ static int ReadStateChunk(StateMem *st, SFORMAT *sf, int size)
       else
       {
          printf("Unknown variable in save state: %s\n", toa + 1);
-         if(smem_seek(st, recorded_size, SEEK_CUR) < 0)
+         if(smem_seek(st, skip_size, SEEK_CUR) < 0)
          {
             puts("Seek error");
             return(0);
@@ -408,6 +1061,69 @@ static int ReadStateChunk(StateMem *st, SFORMAT *sf, int size)
 
 static int CurrentState = 0;
 
+/* Where each section of the state being loaded is, found in one pass over
+ * the section headers instead of a scan from the start for every section. */
+struct StateSection
+{
+   char name[32];
+   uint32_t offset;
+   uint32_t size;
+};
+
+static std::vector<StateSection> Sections;
+static bool SectionsIndexed = false;
+static uint32_t SectionsNext;
+static uint32_t SectionsEnd;  // End of the state, which may be followed by unused space in the buffer
+
+static void IndexSections(StateMem *st)
+{
+   uint32_t loc = st->loc;
+   uint32_t end = (SectionsEnd && SectionsEnd <= st->len) ? SectionsEnd : st->len;
+
+   Sections.clear();
+   SectionsNext = 0;
+
+   while(loc + 32 + 4 <= end)
+   {
+      StateSection chunk;
+
+      memcpy(chunk.name, st->data + loc, 32);
+      chunk.size   = MDFN_de32lsb<false>(st->data + loc + 32);
+      chunk.offset = loc + 32 + 4;
+
+      if(chunk.size > end - chunk.offset)
+      {
+         puts("Chunk seek failure");
+         break;
+      }
+
+      Sections.push_back(chunk);
+      loc = chunk.offset + chunk.size;
+   }
+
+   SectionsIndexed = true;
+}
+
+static const StateSection *FindSection(StateMem *st, const char *name)
+{
+   if(!SectionsIndexed)
+      IndexSections(st);
+
+   // Sections are normally loaded in the order they were saved in.
+   for(uint32_t i = 0; i < Sections.size(); i++)
+   {
+      const uint32_t which = (SectionsNext + i) % Sections.size();
+
+      if(!strncmp(Sections[which].name, name, 32))
+      {
+         SectionsNext = which + 1;
+         return &Sections[which];
+      }
+   }
+
+   return NULL;
+}
+
 /* This function is called by the game driver(NES, GB, GBA) to save a state. */
 static int MDFNSS_StateAction_internal(void *st_p, int load, int data_only, SSDescriptor *section)
 {
@@ -415,49 +1131,29 @@ static int MDFNSS_StateAction_internal(void *st_p, int load, int data_only, SSDe
 
    if(load)
    {
-      char sname[32];
+      const StateSection *chunk = FindSection(st, section->name);
+      uint32_t loc              = st->loc;
 
-      int found = 0;
-      uint32_t tmp_size;
-      uint32_t total = 0;
-
-      while(smem_read(st, (uint8_t *)sname, 32) == 32)
+      if(!chunk)
       {
-         if(smem_read32le(st, &tmp_size) != 4)
-            return(0);
-
-         total += tmp_size + 32 + 4;
-
-         // Yay, we found the section
-         if(!strncmp(sname, section->name, 32))
+         if(!section->optional) // Not found.  We are sad!
          {
-            if(!ReadStateChunk(st, section->sf, tmp_size))
-            {
-               printf("Error reading chunk: %s\n", section->name);
-               return(0);
-            }
-            found = 1;
-            break;
-         } 
-         else
-         {
-            if(smem_seek(st, tmp_size, SEEK_CUR) < 0)
-            {
-               puts("Chunk seek failure");
-               return(0);
-            }
+            printf("Section missing:  %.32s\n", section->name);
+            return(0);
          }
+
+         return(1);
       }
-      if(smem_seek(st, -total, SEEK_CUR) < 0)
-      {
-         puts("Reverse seek error");
-         return(0);
-      }
-      if(!found && !section->optional) // Not found.  We are sad!
+
+      st->loc = chunk->offset;
+
+      if(!ReadStateChunk(st, section->name, section->sf, chunk->size))
       {
-         printf("Section missing:  %.32s\n", section->name);
+         printf("Error reading chunk: %s\n", section->name);
          return(0);
       }
+
+      st->loc = loc;
    }
    else
    {
@@ -489,15 +1185,34 @@ int MDFNSS_SaveSM(void *st_p, int, int, const void*, const void*, const void*)
    static const char *header_magic = "MDFNSVST";
    int neowidth = 0, neoheight = 0;
 
+   if(!StateNonce || StateDirty_Gen >= 0x7FFFFFFF)
+      StateDirty_Reset();
+
+   // Compressed states can't be patched in place.
+   if(st->data && st->malloced >= sizeof(header) && !CompressedSaveStates)
+      StateBaseGen = StateDirty_BaseGen(st->data, true);
+
    memset(header, 0, sizeof(header));
    memcpy(header, header_magic, 8);
 
+   // Tag the state so that it can be recognised as a base for incremental saves and loads.
+   MDFN_en32lsb<false>(header + 8, StateNonce);
+   MDFN_en32lsb<false>(header + 12, StateDirty_Gen | (FastSaveStates ? 0x80000000 : 0));
+
    MDFN_en32lsb<false>(header + 16, MEDNAFEN_VERSION_NUMERIC);
    MDFN_en32lsb<false>(header + 24, neowidth);
    MDFN_en32lsb<false>(header + 28, neoheight);
    smem_write(st, header, 32);
 
-   if(!StateAction(st, 0, 0))
+   bool ret = StateAction(st, 0, 0);
+
+   StateBaseGen = 0;
+   StateDirty_Gen++;
+
+   if(!ret)
+      return(0);
+
+   if(st->fixed && st->len > st->malloced)
       return(0);
 
    uint32_t sizy = st->loc;
@@ -507,6 +1222,26 @@ int MDFNSS_SaveSM(void *st_p, int, int, const void*, const void*, const void*)
    return(1);
 }
 
+uint32_t MDFNSS_SaveSize(void)
+{
+   StateMem st;
+
+   st.data           = NULL;
+   st.loc            = 0;
+   st.len            = 0;
+   st.malloced       = 0;
+   st.initial_malloc = 0;
+   st.fixed          = true;
+
+   // Skip over the header; StateDirty_Gen isn't advanced either, as no state comes of this.
+   st.loc = st.len = 32;
+
+   if(!StateAction(&st, 0, 0))
+      return(0);
+
+   return(st.len);
+}
+
 int MDFNSS_LoadSM(void *st_p, int, int)
 {
    uint8_t header[32];
@@ -520,5 +1255,34 @@ int MDFNSS_LoadSM(void *st_p, int, int)
 
    stateversion = MDFN_de32lsb<false>(header + 16);
 
-   return(StateAction(st, stateversion, 0));
+   StateBaseGen = StateDirty_BaseGen(header, false);
+   SectionsIndexed = false;
+   SectionsEnd     = MDFN_de32lsb<false>(header + 16 + 4);
+
+   for(unsigned i = 0; i < DirtyCount; i++)
+      DirtyList[i]->partial = false;
+
+   int ret = StateAction(st, stateversion, 0);
+
+   SectionsIndexed = false;
+   SectionsEnd     = 0;
+
+   // The tracked arrays now hold the data of the state loaded, which is the only older state they can be compared with.
+   for(unsigned i = 0; i < DirtyCount; i++)
+      memset(DirtyList[i]->gen, 0, sizeof(DirtyList[i]->gen));
+
+   StateGenFloor  = StateDirty_Gen;
+   StateGenLoaded = 0;
+
+   if(ret && StateNonce && MDFN_de32lsb<false>(header + 8) == StateNonce)
+   {
+      const uint32_t gen = MDFN_de32lsb<false>(header + 12) & 0x7FFFFFFF;
+
+      if(gen < StateDirty_Gen)
+         StateGenLoaded = gen;
+   }
+
+   StateBaseGen = 0;
+
+   return(ret);
 }
@@ -11,6 +11,7 @@ typedef struct
    uint32_t len;
    uint32_t malloced;
    uint32_t initial_malloc; /* A setting! */
+   bool fixed;              /* data is not ours to realloc; see smem_write() */
 } StateMem;
 
 /* Eh, we abuse the smem_* in-memory stream code
@@ -22,9 +23,66 @@ int32_t smem_seek(StateMem *st, uint32_t offset, int whence);
 int smem_write32le(StateMem *st, uint32_t b);
 int smem_read32le(StateMem *st, uint32_t *b);
 
+/* Incremental savestates.
+ *
+ * A large array that is only written through a few paths can be paired with a
+ * StateDirty, which records for each of its pages the generation(see
+ * StateDirty_Gen) it was last written in.  Every state the core saves is tagged
+ * with a token naming its generation, so that when a state is saved over, or
+ * loaded from, a recent state of our own only the pages written since that
+ * state have to be copied; the others are known to hold the same data.  The
+ * state written is still a complete one of the usual size, only the copying is
+ * skipped.  Writes that bypass the tracking, like a frontend poking main RAM
+ * through retro_get_memory_data(), require marking the whole array. */
+#define STATE_DIRTY_MAX_PAGES 512
+
+typedef struct
+{
+   uint32_t page_shift;
+   bool partial;                            /* The last load only copied some pages */
+   uint32_t gen[STATE_DIRTY_MAX_PAGES];
+} StateDirty;
+
+/* Generation of the next state to be saved, stored by StateDirty_Mark() */
+extern uint32_t StateDirty_Gen;
+
+void StateDirty_Init(StateDirty *d, uint32_t size);
+void StateDirty_MarkAll(StateDirty *d);
+
+/* Whether page was restored by the state being loaded; for use by StateAction
+ * code that post-processes tracked arrays after they've been read. */
+bool StateDirty_Loaded(const StateDirty *d, uint32_t page);
+
+static INLINE void StateDirty_Mark(StateDirty *d, uint32_t offset)
+{
+   d->gen[offset >> d->page_shift] = StateDirty_Gen;
+}
+
+static INLINE void StateDirty_MarkRange(StateDirty *d, uint32_t offset, uint32_t length)
+{
+   uint32_t page;
+
+   for(page = offset >> d->page_shift; page <= (offset + length - 1) >> d->page_shift; page++)
+      d->gen[page] = StateDirty_Gen;
+}
+
 int MDFNSS_SaveSM(void *st, int, int, const void*, const void*, const void*);
+
+/* Size of the state MDFNSS_SaveSM() would write right now, measured by walking
+ * the state descriptors without copying any data. */
+uint32_t MDFNSS_SaveSize(void);
+
+/* Has the frontend measure the state again with MDFNSS_SaveSize(), for when
+ * something that changes its layout, like a plugged in device, has changed.
+ * Implemented in libretro.cpp. */
+void invalidate_serialize_size(void);
+
 int MDFNSS_LoadSM(void *st, int, int);
 
+/* Stops the threads compressing states and frees the buffers kept for them
+ * between saves. */
+void MDFNSS_Deinit(void);
+
 // Flag for a single, >= 1 byte native-endian variable
 #define MDFNSTATE_RLSB            0x80000000
 
@@ -46,6 +104,7 @@ typedef struct {
    // If 0, the subchunk isn't saved.
    uint32_t flags;	// Flags
    const char *name;	// Name
+   StateDirty *dirty;	// Optional dirty page tracking of the array, for incremental savestates
 } SFORMAT;
 
 /* State-Section Descriptor */
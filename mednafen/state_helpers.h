@@ -29,6 +29,10 @@ INLINE uint32_t SF_FORCE_D(double *) { return(0); }
 #define SFARRAYN(x, l, n) { (x), (uint32_t)(l), 0 | SF_FORCE_A8(x), n }
 #define SFARRAY(x, l) SFARRAYN((x), (l), #x)
 
+/* Arrays with dirty page tracking, see StateDirty */
+#define SFARRAYDIRTYN(x, l, n, d) { (x), (uint32_t)(l), 0 | SF_FORCE_A8(x), n, (d) }
+#define SFARRAY16DIRTYN(x, l, n, d) { (x), (uint32_t)((l) * sizeof(uint16_t)), MDFNSTATE_RLSB16 | SF_FORCE_A16(x), n, (d) }
+
 #define SFARRAYBN(x, l, n) { (x), (uint32_t)(l), MDFNSTATE_BOOL | SF_FORCE_AB(x), n }
 #define SFARRAYB(x, l) SFARRAYBN((x), (l), #x)
 
@@ -0,0 +1,77 @@
+/* Converts a disc image(anything the core can open) into a disc cache file(.dcf), see mednafen/cdrom/CDAccess_DCF.h.
+ *
+ * Usage: dcfconv <image> <output.dcf> [disc number, for multi-disc PBPs]
+ *
+ * Built with "make dcfconv", out of the same objects as the core.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+
+#include <libretro.h>
+
+#include "../mednafen/mednafen.h"
+#include "../mednafen/cdrom/CDAccess.h"
+#include "../mednafen/cdrom/CDAccess_DCF.h"
+#include "../mednafen/cdrom/CDUtility.h"
+
+// What the CD code needs from libretro.cpp.
+static void dcfconv_log(enum retro_log_level level, const char *fmt, ...)
+{
+   va_list ap;
+
+   va_start(ap, fmt);
+   vfprintf(stderr, fmt, ap);
+   va_end(ap);
+}
+
+retro_log_printf_t log_cb = dcfconv_log;
+int CD_SelectedDisc = 0;
+
+bool MDFN_GetSettingB(const char *name)
+{
+   return false;
+}
+
+int main(int argc, char *argv[])
+{
+   bool success = true;
+   CDAccess *src;
+   TOC toc;
+
+   if(argc < 3 || argc > 4)
+   {
+      fprintf(stderr, "Usage: %s <image> <output.dcf> [disc number, for multi-disc PBPs]\n", argv[0]);
+      return 1;
+   }
+
+   if(argc == 4)
+      CD_SelectedDisc = atoi(argv[3]) - 1;
+
+   CDUtility_Init();
+
+   src = cdaccess_open_image(&success, argv[1], false);
+
+   // Switches multi-disc PBPs over to CD_SelectedDisc, as a disc change in the core does.
+   if(success)
+      src->Eject(false);
+
+   if(!success || !src->Read_TOC(&toc))
+   {
+      fprintf(stderr, "Error opening %s\n", argv[1]);
+      delete src;
+      return 1;
+   }
+
+   if(!DCF_Convert(src, &toc, argv[2]))
+   {
+      delete src;
+      return 1;
+   }
+
+   printf("%s: %u sectors\n", argv[2], (unsigned)toc.tracks[100].lba);
+
+   delete src;
+   return 0;
+}
@@ -0,0 +1,720 @@
+/* Checks and times the LZRC decoder used for official PBPs(CDAccess_PBP::decompress()) against the one it replaced.
+ *
+ * Usage: lzrcbench [blocks] [passes]
+ *
+ * Encodes "blocks"(300 by default) random 16-sector blocks with the encoder below, then decodes each of them "passes"
+ * (20 by default) times with both the previous decoder(LZRCReference, kept below as it was) and the current one.
+ * Checks that the previous decoder gives back every block exactly as it was encoded and that the current one gives
+ * the same output, and prints the throughput of both.  Exits with 1 on a mismatch.
+ *
+ * Built with "make lzrcbench", out of the same objects as the core.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <vector>
+
+#include <libretro.h>
+
+#include "../mednafen/mednafen.h"
+#include "../mednafen/cdrom/CDAccess.h"
+#include "../mednafen/cdrom/CDAccess_PBP.h"
+
+// What the CD code needs from libretro.cpp.
+static void lzrcbench_log(enum retro_log_level level, const char *fmt, ...)
+{
+   va_list ap;
+
+   va_start(ap, fmt);
+   vfprintf(stderr, fmt, ap);
+   va_end(ap);
+}
+
+retro_log_printf_t log_cb = lzrcbench_log;
+int CD_SelectedDisc = 0;
+
+bool MDFN_GetSettingB(const char *name)
+{
+   return false;
+}
+
+#define LZRC_BLOCK_SIZE (2352 * 16)
+
+// The LZRC decoder as it was before CDAccess_PBP::decompress() was reworked, for comparison.
+struct LZRCReference
+{
+   int decode_range(unsigned int *range, unsigned int *code, unsigned char **src);
+   int decode_bit(unsigned int *range, unsigned int *code, int *index, unsigned char **src, unsigned char *c);
+   int decode_word(unsigned char *ptr, int index, int *bit_flag, unsigned int *range, unsigned int *code, unsigned char **src);
+   int decode_number(unsigned char *ptr, int index, int *bit_flag, unsigned int *range, unsigned int *code, unsigned char **src);
+   int decompress(unsigned char *out, unsigned char *in, unsigned int size);
+};
+
+int LZRCReference::decode_range(unsigned int *range, unsigned int *code, unsigned char **src)
+{
+   if (!((*range) >> 24))
+   {
+      (*range) <<= 8;
+      *code = ((*code) << 8) + (*src)++[5];
+      return 1;
+   }
+
+   return 0;
+}
+
+int LZRCReference::decode_bit(unsigned int *range, unsigned int *code, 
+      int *index, unsigned char **src, unsigned char *c)
+{
+   unsigned int val = *range;
+
+   if (decode_range(range, code, src))
+      val *= (*c);
+   else
+      val = (val >> 8) * (*c);
+
+   *c -= ((*c) >> 3);
+   if (index)
+      (*index) <<= 1;
+
+   if (*code < val)
+   {
+      *range = val;
+      *c += 31;
+      if (index) (*index)++;
+      return 1;
+   }
+
+   *code -= val;
+   *range -= val;
+   return 0;
+}
+
+int LZRCReference::decode_word(unsigned char *ptr, int index, 
+      int *bit_flag, unsigned int *range, 
+      unsigned int *code, unsigned char **src)
+{
+   int i = 1;
+   index >>= 3;
+
+   if (index >= 3)
+   {
+      decode_bit(range, code, &i, src, ptr);          // Offset 0x8A8
+      if (index >= 4)
+      {
+         decode_bit(range, code, &i, src, ptr);      // Offset 0x8A8
+         if (index >= 5)
+         {
+            decode_range(range, code, src);
+            for (; index >= 5; index--)
+            {
+               i <<= 1;
+               (*range) >>= 1;
+               if (*code < *range)
+                  i++;
+               else
+                  (*code) -= *range;
+            }
+         }
+      }
+   }
+
+   *bit_flag = decode_bit(range, code, &i, src, ptr + 3);   // Offset 0x8A8 + 3
+
+   if (index >= 1)
+   {
+      decode_bit(range, code, &i, src, ptr + 2);           // Offset 0x8A8 + 2
+      if (index >= 2)
+      {
+         decode_bit(range, code, &i, src, ptr + 1);       // Offset 0x8A8 + 1
+      }
+   }
+
+   return i;
+}
+
+int LZRCReference::decode_number(unsigned char *ptr, int index, int *bit_flag, 
+      unsigned int *range, unsigned int *code, unsigned char **src)
+{
+   int i = 1;
+
+   if (index >= 3)
+   {
+      decode_bit(range, code, &i, src, ptr + 0x18);         // Offset 0x978
+      if (index >= 4)
+      {
+         decode_bit(range, code, &i, src, ptr + 0x18);     // Offset 0x978
+         if (index >= 5)
+         {
+            decode_range(range, code, src);
+            for (; index >= 5; index--)
+            {
+               i <<= 1;
+               (*range) >>= 1;
+               if (*code < *range)
+                  i++;
+               else
+                  (*code) -= *range;
+            }
+         }
+      }
+   }
+
+   *bit_flag = decode_bit(range, code, &i, src, ptr);       // Offset 0x960
+
+   if (index >= 1) 
+   {
+      decode_bit(range, code, &i, src, ptr + 0x8);         // Offset 0x968
+      if (index >= 2)
+      {
+         decode_bit(range, code, &i, src, ptr + 0x10);    // Offset 0x970
+      }
+   }
+
+   return i;
+}
+
+int LZRCReference::decompress(unsigned char *out, unsigned char *in, unsigned int size)
+{
+   int result;
+
+   unsigned char tmp[0xA70];
+
+   int offset = 0;
+   int bit_flag = 0;
+   int data_length = 0;
+   int data_offset = 0;
+
+   unsigned char *tmp_sect1, *tmp_sect2, *tmp_sect3;
+   unsigned char *buf_start, *buf_end;
+   unsigned char prev = 0;
+
+   unsigned char *start = out;
+   unsigned char *end = (out + size);
+   unsigned char head = in[0];
+
+   unsigned int range = 0xFFFFFFFF;
+   unsigned int code = (in[1] << 24) | (in[2] << 16) | (in[3] << 8) | in[4];
+
+   if (head < 0) // Check if we have a valid starting byte.
+   {
+      // The dictionary header is invalid, the data is not compressed.
+      result = -1;
+      if (code <= size)
+      {
+         memcpy(out, (const void *)(in + 5), code);
+         result = (start - out);
+      }
+   }
+   else
+   {
+      // Set up a temporary buffer (sliding window).
+      memset(tmp, 0x80, 0xA60);
+      while (1)
+      {
+         // Start reading at 0x920.
+         tmp_sect1 = tmp + offset + 0x920;
+         if (!decode_bit(&range, &code, 0, &in, tmp_sect1))  // Raw char.
+         {
+            // Adjust offset and check for stream end.
+            if (offset > 0) offset--;
+            if (start == end) return (start - out);
+
+            // Locate first section.
+            int sect = (((((((int)(start - out)) & 7) << 8) + prev) >> head) & 7) * 0xFF - 1;
+            tmp_sect1 = tmp + sect;
+            int index = 1;
+
+            // Read, decode and write back.
+            do
+            {
+               decode_bit(&range, &code, &index, &in, tmp_sect1 + index);
+            } while ((index >> 8) == 0);
+
+            // Save index.
+            *start++ = index;
+         }
+         else  // Compressed char stream.
+         {
+            int index = -1;
+
+            // Identify the data length bit field.
+            do {
+               tmp_sect1 += 8;
+               bit_flag = decode_bit(&range, &code, 0, &in, tmp_sect1);
+               index += bit_flag;
+            } while ((bit_flag != 0) && (index < 6));
+
+            // Default block size is 0x40.
+            int b_size = 0x40;
+            tmp_sect2 = tmp + index + 0x7F1;
+
+            // If the data length was found, parse it as a number.
+            if ((index >= 0) || (bit_flag != 0)) 
+            {
+               // Locate next section.
+               int sect = (index << 5) | (((((int)(start - out)) << index) & 3) << 3) | (offset & 7);
+               tmp_sect1 = tmp + 0x960 + sect;
+
+               // Decode the data length (8 bit fields).
+               data_length = decode_number(tmp_sect1, index, &bit_flag, &range, &code, &in);
+
+               // If we got valid parameters, seek to find data offset.
+               if ((data_length != 3) && ((index > 0) || (bit_flag != 0))) {
+                  tmp_sect2 += 0x38;
+                  b_size = 0x80;  // Block size is now 0x80.
+               }
+            } else {
+               // Assume one byte of advance.
+               data_length = 1;
+            }
+
+            int diff = 0;
+            int shift = 1;
+
+            // Identify the data offset bit field.
+            do {
+               diff = (shift << 4) - b_size;
+               bit_flag = decode_bit(&range, &code, &shift, &in, tmp_sect2 + (shift << 3));
+            } while (diff < 0);
+
+            // If the data offset was found, parse it as a number.
+            if ((diff > 0) || (bit_flag != 0))
+            {
+               // Adjust diff if needed.
+               if (bit_flag == 0) diff -= 8;
+
+               // Locate section.
+               tmp_sect3 = tmp + 0x8A8 + diff;
+
+               // Decode the data offset (1 bit fields).
+               data_offset = decode_word(tmp_sect3, diff, &bit_flag, &range, &code, &in);
+            } else {
+               // Assume one byte of advance.
+               data_offset = 1;
+            }
+
+            // Set buffer start/end.
+            buf_start = start - data_offset;
+            buf_end = start + data_length + 1;
+
+            // Underflow.
+            if (buf_start < out)
+               return -1;
+
+            // Overflow.
+            if (buf_end > end)
+               return -1;
+
+            // Update offset.
+            offset = ((((int)(buf_end - out)) + 1) & 1) + 6;
+
+            // Copy data.
+            do {
+               *start++ = *buf_start++;
+            } while (start < buf_end);
+
+         }
+         prev = *(start - 1);
+      }
+      result = (start - out);
+   }
+
+   return result;
+}
+
+
+/* Range encoder that walks the same model as CDAccess_PBP::decompress(), one decision at a time.  Literals come from
+ * the data passed to Encode(); match lengths and offsets are picked at random(falling back to a literal when a match
+ * would reach outside of what has been written so far), so the output exercises every path of the decoder.  "dec"
+ * gets what the stream decodes to. */
+class LZRCEncoder
+{
+   public:
+
+      std::vector<uint8_t> dec;
+
+      std::vector<uint8_t> Encode(int head, const uint8_t *data, int size)
+      {
+         low = 0;
+         range = 0xFFFFFFFF;
+         cache = 0;
+         cache_size = 1;
+         out.clear();
+         dec.clear();
+
+         memset(tmp, 0x80, 0xA60);
+         memset(tmp + 0xA60, 0, 0x10);
+         offset = 0;
+         pos = 0;
+         prev = 0;
+
+         while (pos < size)
+         {
+            if (pos > 0 && (rand() % 3))
+            {
+               LZRCEncoder save = *this;
+
+               if (Match(size))
+                  continue;
+
+               *this = save;
+            }
+
+            Literal(head, data[pos], false);
+         }
+
+         Literal(head, 0, true);
+
+         for (int i = 0; i < 5; i++)
+            ShiftLow();
+
+         out[0] = head;
+
+         return out;
+      }
+
+   private:
+
+      uint64_t low;
+      uint32_t range;
+      uint8_t cache;
+      uint64_t cache_size;
+      std::vector<uint8_t> out;
+
+      uint8_t tmp[0xA70];
+      int offset;
+      int pos;
+      uint8_t prev;
+
+      void ShiftLow(void)
+      {
+         if ((uint32_t)low < 0xFF000000 || (low >> 32) != 0)
+         {
+            uint8_t temp = cache;
+
+            do
+            {
+               out.push_back(temp + (uint8_t)(low >> 32));
+               temp = 0xFF;
+            } while (--cache_size != 0);
+
+            cache = (uint8_t)((uint32_t)low >> 24);
+         }
+
+         cache_size++;
+         low = (uint32_t)low << 8;
+      }
+
+      void Normalize(void)
+      {
+         if (!(range >> 24))
+         {
+            range <<= 8;
+            ShiftLow();
+         }
+      }
+
+      int Bit(uint8_t *c, int b)
+      {
+         uint32_t bound;
+
+         Normalize();
+         bound = (range >> 8) * (*c);
+         *c -= (*c) >> 3;
+
+         if (b)
+         {
+            range = bound;
+            *c += 31;
+         }
+         else
+         {
+            low += bound;
+            range -= bound;
+         }
+
+         return b;
+      }
+
+      int Bit(uint8_t *c, int *index, int b)
+      {
+         Bit(c, b);
+         *index = (*index << 1) | b;
+
+         return b;
+      }
+
+      int Direct(int i, int count)
+      {
+         Normalize();
+
+         for (; count > 0; count--)
+         {
+            int b = rand() & 1;
+
+            i = (i << 1) | b;
+            range >>= 1;
+
+            if (!b)
+               low += range;
+         }
+
+         return i;
+      }
+
+      // Mirrors lzrc_decode_number().
+      int Number(uint8_t *ptr, int index, int *bit_flag)
+      {
+         int i = 1;
+
+         if (index >= 3)
+         {
+            Bit(ptr + 0x18, &i, rand() & 1);
+
+            if (index >= 4)
+            {
+               Bit(ptr + 0x18, &i, rand() & 1);
+
+               if (index >= 5)
+                  i = Direct(i, index - 4);
+            }
+         }
+
+         *bit_flag = Bit(ptr, &i, rand() & 1);
+
+         if (index >= 1)
+         {
+            Bit(ptr + 0x8, &i, rand() & 1);
+
+            if (index >= 2)
+               Bit(ptr + 0x10, &i, rand() & 1);
+         }
+
+         return i;
+      }
+
+      // Mirrors lzrc_decode_word().
+      int Word(uint8_t *ptr, int index, int *bit_flag)
+      {
+         int i = 1;
+
+         index >>= 3;
+
+         if (index >= 3)
+         {
+            Bit(ptr, &i, rand() & 1);
+
+            if (index >= 4)
+            {
+               Bit(ptr, &i, rand() & 1);
+
+               if (index >= 5)
+                  i = Direct(i, index - 4);
+            }
+         }
+
+         *bit_flag = Bit(ptr + 3, &i, rand() & 1);
+
+         if (index >= 1)
+         {
+            Bit(ptr + 2, &i, rand() & 1);
+
+            if (index >= 2)
+               Bit(ptr + 1, &i, rand() & 1);
+         }
+
+         return i;
+      }
+
+      // A raw byte, or the end of the stream.
+      void Literal(int head, uint8_t x, bool end)
+      {
+         int sect, index = 1;
+
+         Bit(tmp + offset + 0x920, 0);
+
+         if (offset > 0)
+            offset--;
+
+         if (end)
+            return;
+
+         sect = (((((pos & 7) << 8) + prev) >> head) & 7) * 0xFF - 1;
+
+         for (int k = 7; k >= 0; k--)
+            Bit(tmp + sect + index, &index, (x >> k) & 1);
+
+         dec.push_back(index & 0xFF);
+         pos++;
+         prev = index & 0xFF;
+      }
+
+      // A copy of earlier output, of random length and distance; false if it doesn't fit.
+      bool Match(int size)
+      {
+         uint8_t *tmp_sect1 = tmp + offset + 0x920;
+         uint8_t *tmp_sect2;
+         int bit_flag, index = -1;
+         int data_length, data_offset;
+         int b_size = 0x40;
+         int diff = 0, shift = 1;
+         int buf_start, buf_end;
+
+         Bit(tmp_sect1, 1);
+
+         do
+         {
+            tmp_sect1 += 8;
+            bit_flag = Bit(tmp_sect1, (rand() % 3) != 0);
+            index += bit_flag;
+         } while (bit_flag && index < 6);
+
+         tmp_sect2 = tmp + index + 0x7F1;
+
+         if (index >= 0 || bit_flag)
+         {
+            int sect = (index << 5) | (((pos << index) & 3) << 3) | (offset & 7);
+
+            data_length = Number(tmp + 0x960 + sect, index, &bit_flag);
+
+            if (data_length != 3 && (index > 0 || bit_flag))
+            {
+               tmp_sect2 += 0x38;
+               b_size = 0x80;
+            }
+         }
+         else
+            data_length = 1;
+
+         do
+         {
+            diff = (shift << 4) - b_size;
+            bit_flag = Bit(tmp_sect2 + (shift << 3), &shift, rand() & 1);
+         } while (diff < 0);
+
+         if (diff > 0 || bit_flag)
+         {
+            if (bit_flag == 0)
+               diff -= 8;
+
+            data_offset = Word(tmp + 0x8A8 + diff, diff, &bit_flag);
+         }
+         else
+            data_offset = 1;
+
+         if (data_offset > pos || pos + data_length + 1 > size)
+            return false;
+
+         buf_start = pos - data_offset;
+         buf_end = pos + data_length + 1;
+         offset = ((buf_end + 1) & 1) + 6;
+
+         while (pos < buf_end)
+         {
+            dec.push_back(dec[buf_start++]);
+            pos++;
+         }
+
+         prev = dec[pos - 1];
+
+         return true;
+      }
+};
+
+static double MBps(int blocks, int passes, double secs)
+{
+   return (double)blocks * passes * LZRC_BLOCK_SIZE / (secs > 0 ? secs : 1e-9) / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+   static uint8_t data[LZRC_BLOCK_SIZE];
+   static uint8_t decoded[LZRC_BLOCK_SIZE];
+   std::vector< std::vector<uint8_t> > streams;
+   std::vector< std::vector<uint8_t> > expected;
+   std::vector< std::vector<uint8_t> > reference;
+   std::vector<int> reference_len;
+   LZRCEncoder enc;
+   LZRCReference ref;
+   int blocks = (argc > 1) ? atoi(argv[1]) : 300;
+   int passes = (argc > 2) ? atoi(argv[2]) : 20;
+   uint64_t compressed = 0;
+   int ref_bad = 0, bad = 0;
+   clock_t start;
+   double ref_secs, secs;
+
+   if (blocks <= 0 || passes <= 0)
+   {
+      fprintf(stderr, "Usage: %s [blocks] [passes]\n", argv[0]);
+      return 1;
+   }
+
+   srand(1);
+
+   // Mostly text, so that literals see a skewed distribution, with some noise.
+   for (int b = 0; b < blocks; b++)
+   {
+      std::vector<uint8_t> s;
+
+      for (int i = 0; i < LZRC_BLOCK_SIZE; i++)
+         data[i] = (rand() % 4) ? "PLAYSTATION "[rand() % 12] : rand();
+
+      s = enc.Encode(rand() % 8, data, LZRC_BLOCK_SIZE);
+
+      // decompress() may look a few bytes past the end of the stream.
+      s.resize(s.size() + 16);
+      compressed += s.size() - 16;
+
+      streams.push_back(s);
+      expected.push_back(enc.dec);
+   }
+
+   reference.resize(blocks, std::vector<uint8_t>(LZRC_BLOCK_SIZE));
+   reference_len.resize(blocks);
+
+   for (int b = 0; b < blocks; b++)
+   {
+      reference_len[b] = ref.decompress(&reference[b][0], &streams[b][0], LZRC_BLOCK_SIZE);
+
+      if (reference_len[b] != LZRC_BLOCK_SIZE || memcmp(&reference[b][0], &expected[b][0], LZRC_BLOCK_SIZE))
+         ref_bad++;
+   }
+
+   // Both decoders are timed writing to the same buffer.
+   start = clock();
+
+   for (int p = 0; p < passes; p++)
+   {
+      for (int b = 0; b < blocks; b++)
+         ref.decompress(decoded, &streams[b][0], LZRC_BLOCK_SIZE);
+   }
+
+   ref_secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+   start = clock();
+
+   for (int p = 0; p < passes; p++)
+   {
+      for (int b = 0; b < blocks; b++)
+      {
+         int len = CDAccess_PBP::decompress(decoded, &streams[b][0], LZRC_BLOCK_SIZE);
+
+         if (p == 0 && (len != reference_len[b] || memcmp(decoded, &reference[b][0], LZRC_BLOCK_SIZE)))
+            bad++;
+      }
+   }
+
+   secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+   printf("%d blocks, %.2f compression ratio, %d passes\n", blocks,
+         (double)compressed / ((double)blocks * LZRC_BLOCK_SIZE), passes);
+   printf("reference: %.1f MB/s(%.3fs), %d decoded wrong\n", MBps(blocks, passes, ref_secs), ref_secs, ref_bad);
+   printf("current:   %.1f MB/s(%.3fs), %.2fx, %d differ from the reference\n", MBps(blocks, passes, secs), secs,
+         ref_secs / (secs > 0 ? secs : 1e-9), bad);
+
+   return (ref_bad || bad) ? 1 : 0;
+}
@@ -0,0 +1,318 @@
+/* Checks and times the vector(SSE2 or NEON) versions of the MDEC's IDCT and YCbCr to RGB conversion, see
+ * mednafen/psx/mdec_kernels.inc, against the plain C ones, on generated blocks.
+ *
+ * Usage: mdecbench [passes]
+ *
+ * Runs both versions of the IDCT over MDEC_BENCH_BLOCKS blocks of coefficients, with the IDCT matrix games upload and
+ * with random ones, and both versions of the 15-bit and 24-bit conversion over the same number of macroblocks with
+ * every setting of the signed output and bit 15 flags, checking that they give exactly the same results.  Then times
+ * each of them over "passes"(50 by default) runs, as EncodeImage() uses them.  Exits with 1 on a mismatch.
+ *
+ * Built with "make mdecbench".
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+
+#include "../mednafen/mednafen.h"
+#include "../mednafen/masmem.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(MSB_FIRST)
+#include <arm_neon.h>
+#endif
+
+// Read by both versions of IDCT(), as mdec.cpp's is.
+MDFN_ALIGN(16) static int16 IDCTMatrix[64];
+
+namespace mdec_vector
+{
+#if defined(__SSE2__)
+#define HAVE_MDEC_SSE2 1
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(MSB_FIRST)
+#define HAVE_MDEC_NEON 1
+#endif
+#include "../mednafen/psx/mdec_kernels.inc"
+#undef HAVE_MDEC_SSE2
+#undef HAVE_MDEC_NEON
+}
+
+namespace mdec_plain
+{
+#include "../mednafen/psx/mdec_kernels.inc"
+}
+
+#define MDEC_BENCH_BLOCKS 4096
+
+typedef void (*IDCTFunc)(int16 *in_coeff, int8 *out_coeff);
+typedef void (*RGB888RowFunc)(uint8 *pix_out, const int8 *by, const int8 *cb, const int8 *cr, const uint8 rgb_xor);
+typedef void (*RGB555RowFunc)(uint16 *pix_out, const int8 *by, const int8 *cb, const int8 *cr, const uint16 pixel_xor);
+
+static uint32 rng_state = 0x12345678;
+
+static uint32 Rand32(void)
+{
+   // xorshift32
+   rng_state ^= rng_state << 13;
+   rng_state ^= rng_state >> 17;
+   rng_state ^= rng_state << 5;
+
+   return rng_state;
+}
+
+// What WriteImageData() leaves in Coeff[], for the kinds of blocks in "kind":
+//  0 - mostly zero, a few small AC coefficients, like real video
+//  1 - random over the whole range, weighted towards its ends
+//  2 - every coefficient at -0x4000 or 0x3FFF
+static void MakeCoeffs(int16 *coeff, unsigned kind)
+{
+   for(unsigned i = 0; i < 64; i++)
+   {
+      const uint32 r = Rand32();
+      int32 v;
+
+      switch(kind)
+      {
+         default:
+         case 0:
+            if(i && (r & 7))
+               v = 0;
+            else
+               v = (int32)((r >> 8) % 2048) - 1024;
+            break;
+
+         case 1:
+            if((r & 3) == 0)
+               v = (r & 4) ? 0x3FFF : -0x4000;
+            else
+               v = (int32)((r >> 8) & 0x7FFF) - 0x4000;
+            break;
+
+         case 2:
+            v = (r & 1) ? 0x3FFF : -0x4000;
+            break;
+      }
+
+      coeff[i] = v;
+   }
+}
+
+// The matrix games upload(the 8-point DCT basis scaled by 2^15, stored as the MDEC stores it), or, if "random" is
+// set, one over the whole range a 16-bit upload can give.
+static void MakeIDCTMatrix(bool random)
+{
+   for(unsigned x = 0; x < 8; x++)
+   {
+      for(unsigned u = 0; u < 8; u++)
+      {
+         int32 v;
+
+         if(random)
+            v = (int32)(Rand32() >> 16) - 32768;
+         else
+         {
+            v = (int32)floor(32768.0 * ((u == 0) ? sqrt(0.5) : 1.0) * cos((2 * x + 1) * u * M_PI / 16) + 0.5);
+            if(v > 32767)
+               v = 32767;
+         }
+
+         IDCTMatrix[(x * 8) + u] = (int16)v >> 3;
+      }
+   }
+}
+
+// Runs the IDCT on every block "passes" times, six to a macroblock as DecodeImage() does; returns the seconds taken.
+template<IDCTFunc IDCT>
+static double TimeIDCT(int16 (*coeff)[64], unsigned passes)
+{
+   MDFN_ALIGN(16) static int8 out[6][64];
+   clock_t start = clock();
+
+   for(unsigned p = 0; p < passes; p++)
+   {
+      for(unsigned b = 0; b < MDEC_BENCH_BLOCKS; b++)
+         IDCT(coeff[b], out[b % 6]);
+   }
+
+   return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+// Converts every macroblock "passes" times, as EncodeImage() does for its four luma blocks; returns the seconds taken
+// by the 24-bit and 15-bit conversions in secs_888 and secs_555.
+template<RGB888RowFunc Row888, RGB555RowFunc Row555>
+static void TimeRGB(int8 (*blocks)[6][64], unsigned passes, double *secs_888, double *secs_555)
+{
+   static uint8 out_888[4][8 * 24];
+   static uint16 out_555[4][8 * 8];
+   clock_t start;
+
+   start = clock();
+
+   for(unsigned p = 0; p < passes; p++)
+   {
+      for(unsigned m = 0; m < MDEC_BENCH_BLOCKS; m++)
+      {
+         for(unsigned ybn = 0; ybn < 4; ybn++)
+         {
+            for(unsigned y = 0; y < 8; y++)
+            {
+               const unsigned c = ((((y >> 1) | ((ybn & 2) << 1)) << 3) | ((ybn & 1) << 2));
+
+               Row888(&out_888[ybn][y * 24], &blocks[m][2 + ybn][y * 8], &blocks[m][1][c], &blocks[m][0][c], 0x80);
+            }
+         }
+      }
+   }
+
+   *secs_888 = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+   start = clock();
+
+   for(unsigned p = 0; p < passes; p++)
+   {
+      for(unsigned m = 0; m < MDEC_BENCH_BLOCKS; m++)
+      {
+         for(unsigned ybn = 0; ybn < 4; ybn++)
+         {
+            for(unsigned y = 0; y < 8; y++)
+            {
+               const unsigned c = ((((y >> 1) | ((ybn & 2) << 1)) << 3) | ((ybn & 1) << 2));
+
+               Row555(&out_555[ybn][y * 8], &blocks[m][2 + ybn][y * 8], &blocks[m][1][c], &blocks[m][0][c], 0x8000);
+            }
+         }
+      }
+   }
+
+   *secs_555 = (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char *argv[])
+{
+   // Cr, Cb and the four luma blocks of each macroblock, in the order DecodeImage() fills them.
+   MDFN_ALIGN(16) static int16 coeff[MDEC_BENCH_BLOCKS][64];
+   MDFN_ALIGN(16) static int16 coeff_copy[64];
+   MDFN_ALIGN(16) static int8 blocks[MDEC_BENCH_BLOCKS][6][64];
+   static const uint8 rgb_xors[2] = { 0x00, 0x80 };
+   static const uint16 pixel_xors[4] = { 0x0000, 0x8000, 0x4210, 0xC210 };
+   unsigned passes = (argc > 1) ? strtoul(argv[1], NULL, 0) : 50;
+   unsigned bad_idct = 0, bad_888 = 0, bad_555 = 0;
+   unsigned idct_checks = 0, rgb_checks = 0;
+   double idct_secs[2], secs_888[2], secs_555[2];
+
+   if(argc > 2 || !passes)
+   {
+      fprintf(stderr, "Usage: %s [passes]\n", argv[0]);
+      return 1;
+   }
+
+#if defined(__SSE2__)
+   printf("Checking SSE2 against plain C, %u blocks.\n", MDEC_BENCH_BLOCKS);
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(MSB_FIRST)
+   printf("Checking NEON against plain C, %u blocks.\n", MDEC_BENCH_BLOCKS);
+#else
+   printf("No vector versions in this build, checking plain C against itself, %u blocks.\n", MDEC_BENCH_BLOCKS);
+#endif
+
+   // The IDCT, with every kind of block against the games' matrix and against a few random ones.
+   for(unsigned mat = 0; mat < 5; mat++)
+   {
+      MakeIDCTMatrix(mat != 0);
+
+      for(unsigned b = 0; b < MDEC_BENCH_BLOCKS; b++)
+      {
+         MDFN_ALIGN(16) int8 out_vector[64];
+         MDFN_ALIGN(16) int8 out_plain[64];
+
+         MakeCoeffs(coeff[b], b % 3);
+
+         // IDCT() takes a non-const pointer; make sure neither version writes through it.
+         memcpy(coeff_copy, coeff[b], sizeof(coeff_copy));
+         mdec_vector::IDCT(coeff[b], out_vector);
+         mdec_plain::IDCT(coeff[b], out_plain);
+
+         if(memcmp(out_vector, out_plain, sizeof(out_plain)) || memcmp(coeff_copy, coeff[b], sizeof(coeff_copy)))
+            bad_idct++;
+
+         idct_checks++;
+      }
+   }
+
+   // The conversions, on the games' matrix's output for the video-like blocks and on random samples for the rest, so
+   // that the clamping is covered as well.
+   MakeIDCTMatrix(false);
+
+   for(unsigned m = 0; m < MDEC_BENCH_BLOCKS; m++)
+   {
+      for(unsigned i = 0; i < 6; i++)
+      {
+         if(m & 1)
+         {
+            for(unsigned j = 0; j < 64; j++)
+               blocks[m][i][j] = (int8)Rand32();
+         }
+         else
+         {
+            MakeCoeffs(coeff[0], 0);
+            mdec_plain::IDCT(coeff[0], blocks[m][i]);
+         }
+      }
+
+      for(unsigned ybn = 0; ybn < 4; ybn++)
+      {
+         for(unsigned y = 0; y < 8; y++)
+         {
+            const int8 *by = &blocks[m][2 + ybn][y * 8];
+            const int8 *cb = &blocks[m][1][((((y >> 1) | ((ybn & 2) << 1)) << 3) | ((ybn & 1) << 2))];
+            const int8 *cr = &blocks[m][0][((((y >> 1) | ((ybn & 2) << 1)) << 3) | ((ybn & 1) << 2))];
+
+            for(unsigned i = 0; i < 2; i++)
+            {
+               uint8 out_vector[24], out_plain[24];
+
+               mdec_vector::YCbCr_to_RGB888_Row(out_vector, by, cb, cr, rgb_xors[i]);
+               mdec_plain::YCbCr_to_RGB888_Row(out_plain, by, cb, cr, rgb_xors[i]);
+
+               if(memcmp(out_vector, out_plain, sizeof(out_plain)))
+                  bad_888++;
+            }
+
+            for(unsigned i = 0; i < 4; i++)
+            {
+               uint16 out_vector[8], out_plain[8];
+
+               mdec_vector::YCbCr_to_RGB555_Row(out_vector, by, cb, cr, pixel_xors[i]);
+               mdec_plain::YCbCr_to_RGB555_Row(out_plain, by, cb, cr, pixel_xors[i]);
+
+               if(memcmp(out_vector, out_plain, sizeof(out_plain)))
+                  bad_555++;
+            }
+
+            rgb_checks++;
+         }
+      }
+   }
+
+   printf("IDCT             %u/%u blocks differ\n", bad_idct, idct_checks);
+   printf("RGB888           %u/%u rows differ\n", bad_888, rgb_checks * 2);
+   printf("RGB555           %u/%u rows differ\n", bad_555, rgb_checks * 4);
+
+   idct_secs[0] = TimeIDCT<mdec_plain::IDCT>(coeff, passes);
+   idct_secs[1] = TimeIDCT<mdec_vector::IDCT>(coeff, passes);
+   TimeRGB<mdec_plain::YCbCr_to_RGB888_Row, mdec_plain::YCbCr_to_RGB555_Row>(blocks, passes, &secs_888[0], &secs_555[0]);
+   TimeRGB<mdec_vector::YCbCr_to_RGB888_Row, mdec_vector::YCbCr_to_RGB555_Row>(blocks, passes, &secs_888[1], &secs_555[1]);
+
+   for(unsigned i = 0; i < 2; i++)
+   {
+      printf("%-6s IDCT %.2fns per block, 24-bit %.2fns, 15-bit %.2fns per macroblock\n", i ? "vector" : "plain",
+            idct_secs[i] * 1e9 / ((double)MDEC_BENCH_BLOCKS * passes),
+            secs_888[i] * 1e9 / ((double)MDEC_BENCH_BLOCKS * passes),
+            secs_555[i] * 1e9 / ((double)MDEC_BENCH_BLOCKS * passes));
+   }
+
+   return (bad_idct || bad_888 || bad_555) ? 1 : 0;
+}
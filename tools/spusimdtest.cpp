@@ -0,0 +1,168 @@
+/* Checks the vector(SSE2 or NEON) versions of the SPU's sample kernels, see mednafen/psx/spu_kernels.inc, against
+ * the plain C ones, bit for bit.
+ *
+ * Usage: spusimdtest [iterations]
+ *
+ * Runs each kernel "iterations"(1000000 by default) times on random inputs, weighted towards -32768, 32767, 0 and
+ * their neighbours, and prints how many results differed.  Exits with 1 if any did.
+ *
+ * Built with "make spusimdtest".
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../mednafen/mednafen.h"
+#include "../mednafen/clamp.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(MSB_FIRST)
+#include <arm_neon.h>
+#endif
+
+namespace spu_vector
+{
+#if defined(__SSE2__)
+#define HAVE_SPU_SSE2 1
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(MSB_FIRST)
+#define HAVE_SPU_NEON 1
+#endif
+#include "../mednafen/psx/spu_kernels.inc"
+#undef HAVE_SPU_SSE2
+#undef HAVE_SPU_NEON
+}
+
+namespace spu_plain
+{
+#include "../mednafen/psx/spu_kernels.inc"
+}
+
+static uint32 rng_state = 0x12345678;
+
+static uint32 Rand32(void)
+{
+   // xorshift32
+   rng_state ^= rng_state << 13;
+   rng_state ^= rng_state >> 17;
+   rng_state ^= rng_state << 5;
+
+   return rng_state;
+}
+
+static int16 RandSample(void)
+{
+   static const int16 edges[] = { -32768, -32767, -1, 0, 1, 32766, 32767 };
+   const uint32 r = Rand32();
+
+   if((r & 3) == 0)
+      return edges[(r >> 2) % (sizeof(edges) / sizeof(edges[0]))];
+
+   return (int16)(r >> 16);
+}
+
+static void RandSamples(int16 *out, unsigned count)
+{
+   for(unsigned i = 0; i < count; i++)
+      out[i] = RandSample();
+}
+
+static unsigned Report(const char *name, unsigned mismatches, unsigned iterations)
+{
+   printf("%-16s %u/%u differ\n", name, mismatches, iterations);
+
+   return mismatches;
+}
+
+int main(int argc, char *argv[])
+{
+   unsigned iterations = (argc > 1) ? strtoul(argv[1], NULL, 0) : 1000000;
+   unsigned bad = 0;
+   unsigned m;
+
+   if(argc > 2 || !iterations)
+   {
+      fprintf(stderr, "Usage: %s [iterations]\n", argv[0]);
+      return 1;
+   }
+
+#if defined(__SSE2__)
+   printf("Checking SSE2 against plain C.\n");
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(MSB_FIRST)
+   printf("Checking NEON against plain C.\n");
+#else
+   printf("No vector versions in this build, checking plain C against itself.\n");
+#endif
+
+   // Every read position, so that the taps wrapping around the end of the decode buffer are covered too.
+   m = 0;
+   for(unsigned i = 0; i < iterations; i++)
+   {
+      int16 buf[0x20];
+      const int si = i & 0x1F;
+      const uint32 phase = Rand32();
+
+      RandSamples(buf, 0x20);
+
+      if(spu_vector::InterpolateVoice(buf, si, phase) != spu_plain::InterpolateVoice(buf, si, phase))
+         m++;
+   }
+   bad += Report("InterpolateVoice", m, iterations);
+
+   m = 0;
+   for(unsigned i = 0; i < iterations; i++)
+   {
+      int16 src[40];
+
+      RandSamples(src, 40);
+
+      if(spu_vector::ReverbDot(spu_vector::ResampTable4422, src, 40) != spu_plain::ReverbDot(spu_plain::ResampTable4422, src, 40) ||
+            spu_vector::ReverbDot(spu_vector::ResampTable2244, src, 24) != spu_plain::ReverbDot(spu_plain::ResampTable2244, src, 24) ||
+            spu_vector::Reverb4422(src) != spu_plain::Reverb4422(src) ||
+            spu_vector::Reverb2244(src) != spu_plain::Reverb2244(src))
+         m++;
+   }
+   bad += Report("ReverbDot", m, iterations);
+
+   // IIR_ALPHA is -32768 now and then, for the plain C case the vector versions fall back to.
+   m = 0;
+   for(unsigned i = 0; i < iterations; i++)
+   {
+      int16 src[4], prev[4], in[4], in_coef[4];
+      int16 out_vector[4], out_plain[4];
+      const int16 IIR_COEF = RandSample();
+      const int16 IIR_ALPHA = RandSample();
+
+      RandSamples(src, 4);
+      RandSamples(prev, 4);
+      RandSamples(in, 4);
+      RandSamples(in_coef, 4);
+
+      spu_vector::ReverbIIR(src, prev, in, in_coef, IIR_COEF, IIR_ALPHA, out_vector);
+      spu_plain::ReverbIIR(src, prev, in, in_coef, IIR_COEF, IIR_ALPHA, out_plain);
+
+      if(memcmp(out_vector, out_plain, sizeof(out_plain)))
+         m++;
+   }
+   bad += Report("ReverbIIR", m, iterations);
+
+   m = 0;
+   for(unsigned i = 0; i < iterations; i++)
+   {
+      int16 src[8], coef[4];
+      int16 out_vector[2], out_plain[2];
+
+      RandSamples(src, 8);
+      RandSamples(coef, 4);
+
+      spu_vector::ReverbACC(src, coef, out_vector);
+      spu_plain::ReverbACC(src, coef, out_plain);
+
+      if(memcmp(out_vector, out_plain, sizeof(out_plain)))
+         m++;
+   }
+   bad += Report("ReverbACC", m, iterations);
+
+   return bad ? 1 : 0;
+}
@@ -0,0 +1,273 @@
+/* Checks and times the vector(SSE2 or NEON) versions of the CD-XA ADPCM decoder and the CD audio resampler, see
+ * mednafen/psx/cdc_kernels.inc, against the plain C ones, on the XA audio sectors of a disc image.
+ *
+ * Usage: xabench <image> [passes]
+ *
+ * Decodes the first XA_BENCH_MAX_SECTORS XA audio sectors of the image(anything the core can open) with both versions,
+ * and resamples each decoded sector to 44.1kHz as PS_CDC::GetCDAudio() does, checking that both give exactly the same
+ * samples.  Then times each of them over "passes"(20 by default) runs.  Exits with 1 on a mismatch, or if the image
+ * has no XA audio.
+ *
+ * Built with "make xabench", out of the same objects as the core.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <vector>
+
+#include <libretro.h>
+
+#include "../mednafen/mednafen.h"
+#include "../mednafen/mednafen-endian.h"
+#include "../mednafen/cdrom/CDAccess.h"
+#include "../mednafen/cdrom/CDUtility.h"
+#include "../mednafen/psx/cdc.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(MSB_FIRST)
+#include <arm_neon.h>
+#endif
+
+// The decoder's param != param_copy warning.
+#define PSX_WARNING(format, ...) { }
+
+namespace cdc_vector
+{
+#if defined(__SSE2__)
+#define HAVE_CDC_SSE2 1
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(MSB_FIRST)
+#define HAVE_CDC_NEON 1
+#endif
+#include "../mednafen/psx/cdc_kernels.inc"
+#undef HAVE_CDC_SSE2
+#undef HAVE_CDC_NEON
+}
+
+namespace cdc_plain
+{
+#include "../mednafen/psx/cdc_kernels.inc"
+}
+
+// What the CD code needs from libretro.cpp.
+static void xabench_log(enum retro_log_level level, const char *fmt, ...)
+{
+   va_list ap;
+
+   va_start(ap, fmt);
+   vfprintf(stderr, fmt, ap);
+   va_end(ap);
+}
+
+retro_log_printf_t log_cb = xabench_log;
+int CD_SelectedDisc = 0;
+
+bool MDFN_GetSettingB(const char *name)
+{
+   return false;
+}
+
+#define XA_BENCH_MAX_SECTORS 2000
+
+// 4032 samples at 18.9kHz, the most a sector holds, come to 9408 at 44.1kHz.
+#define XA_BENCH_MAX_OUTPUT 9408
+
+typedef void (*XADecodeFunc)(const uint8 *sdata, CD_Audio_Buffer *ab, int16 xa_previous[2][2]);
+typedef int32 (*ResampleDotFunc)(const int16 *imp, const int16 *wf);
+
+// The resampling half of PS_CDC::GetCDAudio(), for a whole decoded sector; returns the number of output samples.
+//
+// GetCDAudio()'s ring buffer holds the last 32 samples read, so here the sector is laid out once behind 32 zeroes(the
+// ring buffer at the start of playback) and each output's taps are just a pointer into that.  Reading the ring buffer
+// right after storing the newest sample in it would measure a store forwarding stall instead of ResampleDot(), which
+// the core doesn't hit, since it only resamples once per 44.1kHz sample.
+template<ResampleDotFunc Dot>
+static unsigned Resample(const CD_Audio_Buffer *ab, const int16 (*impulse)[32], int16 out[XA_BENCH_MAX_OUTPUT][2])
+{
+   MDFN_ALIGN(16) int16 buf[2][32 + 0x1000 + 32];
+   unsigned phase = 0;
+   unsigned read_pos = 0;
+   unsigned count = 0;
+
+   for(unsigned i = 0; i < 2; i++)
+   {
+      memset(&buf[i][0], 0, 32 * sizeof(int16));
+      memcpy(&buf[i][32], ab->Samples[i], ab->Size * sizeof(int16));
+      memset(&buf[i][32 + ab->Size], 0, 32 * sizeof(int16));   // Read by the padding taps.
+   }
+
+   while(read_pos < ab->Size)
+   {
+      for(unsigned i = 0; i < 2; i++)
+      {
+         int32 sample = Dot(impulse[phase], &buf[i][read_pos + 7]) >> 15;
+
+         clamp(&sample, -32768, 32767);
+         out[count][i] = sample;
+      }
+
+      count++;
+      phase += ab->Freq;
+
+      if(phase >= 7)
+      {
+         phase -= 7;
+         read_pos++;
+      }
+   }
+
+   return count;
+}
+
+static bool SameAudio(const CD_Audio_Buffer *a, const CD_Audio_Buffer *b)
+{
+   return a->Size == b->Size && a->Freq == b->Freq &&
+      !memcmp(a->Samples[0], b->Samples[0], a->Size * sizeof(int16)) &&
+      !memcmp(a->Samples[1], b->Samples[1], a->Size * sizeof(int16));
+}
+
+// Decodes every sector "passes" times, then resamples each decoded sector "passes" times; returns the seconds taken
+// by each in decode_secs and resample_secs, and the number of resampled samples per pass.
+template<XADecodeFunc Decode, ResampleDotFunc Dot>
+static unsigned Time(const std::vector<uint8> &sectors, const int16 (*impulse)[32], unsigned passes, double *decode_secs, double *resample_secs)
+{
+   static int16 out[XA_BENCH_MAX_OUTPUT][2];
+   const unsigned count = sectors.size() / 2352;
+   std::vector<CD_Audio_Buffer> ab(count);
+   unsigned samples = 0;
+   clock_t start;
+
+   start = clock();
+
+   for(unsigned p = 0; p < passes; p++)
+   {
+      int16 xa_previous[2][2];
+
+      memset(xa_previous, 0, sizeof(xa_previous));
+
+      for(unsigned s = 0; s < count; s++)
+         Decode(&sectors[s * 2352], &ab[s], xa_previous);
+   }
+
+   *decode_secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+   start = clock();
+
+   for(unsigned p = 0; p < passes; p++)
+   {
+      samples = 0;
+
+      for(unsigned s = 0; s < count; s++)
+         samples += Resample<Dot>(&ab[s], impulse, out);
+   }
+
+   *resample_secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+   return samples;
+}
+
+int main(int argc, char *argv[])
+{
+   static CD_Audio_Buffer ab_vector, ab_plain;
+   static int16 out_vector[XA_BENCH_MAX_OUTPUT][2];
+   static int16 out_plain[XA_BENCH_MAX_OUTPUT][2];
+   bool success = true;
+   CDAccess *src;
+   TOC toc;
+   std::vector<uint8> sectors;
+   unsigned count, passes;
+   unsigned bad_decode = 0, bad_resample = 0;
+   unsigned samples = 0;
+   int16 prev_vector[2][2], prev_plain[2][2];
+   double decode_secs[2], resample_secs[2];
+
+   if(argc < 2 || argc > 3)
+   {
+      fprintf(stderr, "Usage: %s <image> [passes]\n", argv[0]);
+      return 1;
+   }
+
+   passes = (argc > 2) ? atoi(argv[2]) : 20;
+
+   if(!passes)
+      passes = 1;
+
+   CDUtility_Init();
+
+   src = cdaccess_open_image(&success, argv[1], false);
+
+   if(!success || !src->Read_TOC(&toc))
+   {
+      fprintf(stderr, "Error opening %s\n", argv[1]);
+      delete src;
+      return 1;
+   }
+
+   // The same test for XA audio as PS_CDC::HandlePlayRead(): mode 2, with the real-time, form 2 and audio submode bits.
+   for(int32 lba = 0; lba < toc.tracks[100].lba && sectors.size() < XA_BENCH_MAX_SECTORS * 2352; lba++)
+   {
+      uint8 buf[2352 + 96];
+
+      if(!src->Read_Raw_Sector(buf, lba))
+         continue;
+
+      if(buf[12 + 3] == 0x2 && (buf[12 + 6] & 0x64) == 0x64)
+         sectors.insert(sectors.end(), buf, buf + 2352);
+   }
+
+   delete src;
+
+   count = sectors.size() / 2352;
+
+   if(!count)
+   {
+      fprintf(stderr, "No XA audio sectors in %s\n", argv[1]);
+      return 1;
+   }
+
+#if defined(__SSE2__)
+   printf("Checking SSE2 against plain C, %u XA sectors.\n", count);
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(MSB_FIRST)
+   printf("Checking NEON against plain C, %u XA sectors.\n", count);
+#else
+   printf("No vector versions in this build, checking plain C against itself, %u XA sectors.\n", count);
+#endif
+
+   memset(prev_vector, 0, sizeof(prev_vector));
+   memset(prev_plain, 0, sizeof(prev_plain));
+
+   for(unsigned s = 0; s < count; s++)
+   {
+      unsigned n_vector, n_plain;
+
+      cdc_vector::XA_DecodeSector(&sectors[s * 2352], &ab_vector, prev_vector);
+      cdc_plain::XA_DecodeSector(&sectors[s * 2352], &ab_plain, prev_plain);
+
+      if(!SameAudio(&ab_vector, &ab_plain) || memcmp(prev_vector, prev_plain, sizeof(prev_plain)))
+         bad_decode++;
+
+      n_vector = Resample<cdc_vector::ResampleDot>(&ab_plain, cdc_vector::CDADPCMImpulse, out_vector);
+      n_plain = Resample<cdc_plain::ResampleDot>(&ab_plain, cdc_plain::CDADPCMImpulse, out_plain);
+
+      if(n_vector != n_plain || memcmp(out_vector, out_plain, n_plain * sizeof(out_plain[0])))
+         bad_resample++;
+   }
+
+   printf("XA_DecodeSector  %u/%u sectors differ\n", bad_decode, count);
+   printf("ResampleDot      %u/%u sectors differ\n", bad_resample, count);
+
+   samples = Time<cdc_plain::XA_DecodeSector, cdc_plain::ResampleDot>(sectors, cdc_plain::CDADPCMImpulse, passes, &decode_secs[0], &resample_secs[0]);
+   Time<cdc_vector::XA_DecodeSector, cdc_vector::ResampleDot>(sectors, cdc_vector::CDADPCMImpulse, passes, &decode_secs[1], &resample_secs[1]);
+
+   for(unsigned i = 0; i < 2; i++)
+   {
+      printf("%-6s XA sector %.2fus, resampler %.2fns per output sample pair\n", i ? "vector" : "plain",
+            decode_secs[i] * 1e6 / ((double)count * passes), resample_secs[i] * 1e9 / ((double)samples * passes));
+   }
+
+   return (bad_decode || bad_resample) ? 1 : 0;
+}